@@ -1,9 +1,44 @@
 #include "config.h"
+#include "util.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
 
 namespace sylar {
 
+// 两棵子树内容相同(忽略标签)
+static bool NodeEqual(const YAML::Node &lhs, const YAML::Node &rhs) {
+    if (lhs.Type() != rhs.Type()) {
+        return false;
+    }
+    switch (lhs.Type()) {
+        case YAML::NodeType::Scalar:
+            return lhs.Scalar() == rhs.Scalar();
+        case YAML::NodeType::Sequence:
+        case YAML::NodeType::Map: {
+            if (lhs.size() != rhs.size()) {
+                return false;
+            }
+            // 映射按顺序比较，顺序变化视为不同，只会多一次fromNode
+            for (auto l = lhs.begin(), r = rhs.begin(); l != lhs.end(); ++l, ++r) {
+                if (lhs.IsMap() ? !NodeEqual(l->first, r->first) || !NodeEqual(l->second, r->second)
+                                : !NodeEqual(*l, *r)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default:
+            return true;
+    }
+}
+
+// old不为空时与之比较，内容相同的整棵子树不输出
 static void ListAllMember(const std::string &prefix,
                           const YAML::Node &node,
+                          const YAML::Node *old,
                           std::list<std::pair<std::string, const YAML::Node>> &output)
 {
     if (prefix.find_first_not_of("abcdefghijklmnopqrstuvwxyz._0123456789") 
@@ -11,12 +46,24 @@ static void ListAllMember(const std::string &prefix,
         SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config invalid name: " << prefix << " : " << node;
         return;
     }
+    if (old && NodeEqual(node, *old)) {
+        return;
+    }
 
     output.push_back(std::make_pair(prefix, node));
     if (node.IsMap()) {
+        // 逐个node[key]查找是线性的，先建索引
+        std::unordered_map<std::string, YAML::Node> old_children;
+        if (old && old->IsMap()) {
+            for (auto it = old->begin(); it != old->end(); ++it) {
+                old_children.emplace(it->first.Scalar(), it->second);
+            }
+        }
         for (auto it = node.begin();
              it != node.end(); ++it) {
-            ListAllMember(prefix.empty() ? it->first.Scalar() : prefix + "." + it->first.Scalar(), it->second, output);
+            auto o = old_children.find(it->first.Scalar());
+            ListAllMember(prefix.empty() ? it->first.Scalar() : prefix + "." + it->first.Scalar(), it->second,
+                          o == old_children.end() ? nullptr : &o->second, output);
         }
     }
 
@@ -24,10 +71,8 @@ static void ListAllMember(const std::string &prefix,
     // IsSequence() ? 
 }
 
-void Config::LoadFromYaml(const YAML::Node &root) {
-    std::list<std::pair<std::string, const YAML::Node>> all_nodes;
-    ListAllMember("", root, all_nodes);
-
+static void LoadAllMember(const std::list<std::pair<std::string, const YAML::Node>> &all_nodes) {
+    Config::Transaction txn;
     for (auto& i : all_nodes) {
         // SYLAR_LOG_DEBUG(SYLAR_LOG_ROOT()) << i.first << i.second.IsScalar();
 
@@ -37,18 +82,130 @@ void Config::LoadFromYaml(const YAML::Node &root) {
         }
 
         std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-        ConfigVarBase::ptr var = LookupBase(key);
+        ConfigVarBase::ptr var = Config::LookupBase(key);
 
         if (var) {
-            if (i.second.IsScalar()) {
-                var->fromString(i.second.Scalar());
-            } else {
-                std::stringstream ss;
-                ss << i.second;
-                var->fromString(ss.str());
+            txn.set(var, i.second);
+        }
+    }
+    txn.commit();
+}
+
+void Config::LoadFromYaml(const YAML::Node &root) {
+    std::list<std::pair<std::string, const YAML::Node>> all_nodes;
+    ListAllMember("", root, nullptr, all_nodes);
+    LoadAllMember(all_nodes);
+}
+
+void Config::LoadFromYaml(const YAML::Node &root, const YAML::Node &old) {
+    std::list<std::pair<std::string, const YAML::Node>> all_nodes;
+    ListAllMember("", root, &old, all_nodes);
+    LoadAllMember(all_nodes);
+}
+
+bool Config::LoadFromFile(const std::string &path) {
+    YAML::Node root;
+    try {
+        root = YAML::LoadFile(path);
+    } catch (std::exception& e) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config::LoadFromFile " << path << " failed: " << e.what();
+        return false;
+    }
+
+    YAML::Node old;
+    bool loaded = false;
+    {
+        Mutex::Lock lock(GetFileMutex());
+        auto it = GetFiles().find(path);
+        if (it != GetFiles().end()) {
+            old = it->second;
+            loaded = true;
+        }
+    }
+    // 回调中可能再加载配置，不持锁
+    if (loaded) {
+        LoadFromYaml(root, old);
+    } else {
+        LoadFromYaml(root);
+    }
+    Mutex::Lock lock(GetFileMutex());
+    GetFiles()[path] = root;
+    return true;
+}
+
+bool Config::Transaction::set(const ConfigVarBase::ptr &var, const YAML::Node &node) {
+    auto staged = var->stage(node);
+    if (!staged) {
+        return false;
+    }
+    stage(var, staged);
+    return true;
+}
+
+void Config::Transaction::stage(const ConfigVarBase::ptr& var, ConfigVarBase::Staged::ptr staged) {
+    auto it = m_index.find(var.get());
+    if (it != m_index.end()) {
+        m_staged[it->second].second = staged;
+        return;
+    }
+    m_index[var.get()] = m_staged.size();
+    m_staged.emplace_back(var, staged);
+}
+
+bool Config::Transaction::set(const std::string &name, const YAML::Node &node) {
+    auto var = LookupBase(name);
+    if (!var) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config::Transaction::set " << name << " not found";
+        return false;
+    }
+    return set(var, node);
+}
+
+namespace {
+// 本次提交替换下的旧值，最后一个监听者执行完后整批交给一次Epoch::retire
+struct RetireBatch {
+    ~RetireBatch() {
+        auto staged = std::move(items);
+        Epoch::GetInstance()->retire([staged]() mutable { staged.clear(); });
+    }
+    std::vector<ConfigVarBase::Staged::ptr> items;
+};
+}
+
+size_t Config::Transaction::commit() {
+    std::vector<std::pair<ConfigVarBase::ptr, ConfigVarBase::Staged::ptr> > changed;
+    {
+        Mutex::Lock lock(GetCommitMutex());
+        GetCommitSeq().fetch_add(1, std::memory_order_acq_rel);
+        for (auto& i : m_staged) {
+            if (i.second->install()) {
+                changed.push_back(i);
             }
         }
+        GetCommitSeq().fetch_add(1, std::memory_order_release);
+    }
+    m_staged.clear();
+    m_index.clear();
+    if (changed.empty()) {
+        return 0;
     }
+    ConfigVarBase::BumpGeneration();
+
+    auto batch = std::make_shared<RetireBatch>();
+    batch->items.reserve(changed.size());
+    for (auto& i : changed) {
+        batch->items.push_back(i.second);
+    }
+    for (auto& i : changed) {
+        if (m_executor) {
+            // 任务持有batch，提交前的值在所有监听者执行完后才释放
+            auto item = i.second;
+            m_executor([item, batch]() { item->notify(); });
+        } else {
+            i.second->notify();
+        }
+    }
+    return changed.size();
 }
 
 ConfigVarBase::ptr Config::LookupBase(const std::string &name) {
@@ -65,4 +222,126 @@ void Config::Visit(std::function<void(ConfigVarBase::ptr)> cb) {
     }
 }
 
-}
\ No newline at end of file
+ConfigWatcher::ConfigWatcher(uint64_t delay_ms)
+    : m_delay(delay_ms) {
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_inotifyFd < 0 || m_wakeFd < 0) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigWatcher init failed errno=" << errno
+            << " errstr=" << strerror(errno);
+        return;
+    }
+    m_thread = std::make_shared<Thread>(std::bind(&ConfigWatcher::run, this), "config_watch");
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    stop();
+    if (m_inotifyFd >= 0) {
+        ::close(m_inotifyFd);
+    }
+    if (m_wakeFd >= 0) {
+        ::close(m_wakeFd);
+    }
+}
+
+bool ConfigWatcher::watch(const std::string& path) {
+    if (!m_thread) {
+        return false;
+    }
+    if (!Config::LoadFromFile(path)) {
+        return false;
+    }
+
+    size_t pos = path.rfind('/');
+    std::string dir = pos == std::string::npos ? "." : (pos == 0 ? "/" : path.substr(0, pos));
+    std::string name = pos == std::string::npos ? path : path.substr(pos + 1);
+    int wd = inotify_add_watch(m_inotifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigWatcher watch " << dir << " failed errno=" << errno
+            << " errstr=" << strerror(errno);
+        return false;
+    }
+    Mutex::Lock lock(m_mutex);
+    m_dirs[wd] = dir;
+    m_files[dir + "/" + name] = path;
+    return true;
+}
+
+void ConfigWatcher::stop() {
+    if (!m_thread || m_stopping.exchange(true)) {
+        return;
+    }
+    uint64_t one = 1;
+    if (::write(m_wakeFd, &one, sizeof(one)) != sizeof(one)) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigWatcher wakeup failed errno=" << errno;
+    }
+    m_thread->join();
+}
+
+void ConfigWatcher::reload(const std::set<std::string>& paths) {
+    for (auto& i : paths) {
+        SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "ConfigWatcher reload " << i;
+        if (Config::LoadFromFile(i)) {
+            m_reloads.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void ConfigWatcher::run() {
+    // 待重新加载的文件及其最早的加载时间
+    std::set<std::string> pending;
+    uint64_t deadline = 0;
+    alignas(struct inotify_event) char buf[4096];
+    while (!m_stopping.load()) {
+        int timeout = -1;
+        if (!pending.empty()) {
+            uint64_t now = GetMonotonicMS();
+            timeout = deadline > now ? deadline - now : 0;
+        }
+        struct pollfd fds[2] = {{m_inotifyFd, POLLIN, 0}, {m_wakeFd, POLLIN, 0}};
+        int rt = ::poll(fds, 2, timeout);
+        if (rt < 0 && errno != EINTR) {
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigWatcher poll failed errno=" << errno
+                << " errstr=" << strerror(errno);
+            break;
+        }
+        if (rt > 0 && (fds[0].revents & POLLIN)) {
+            bool hit = false;
+            ssize_t len;
+            while ((len = ::read(m_inotifyFd, buf, sizeof(buf))) > 0) {
+                Mutex::Lock lock(m_mutex);
+                for (char* p = buf; p < buf + len; ) {
+                    auto event = (struct inotify_event*)p;
+                    p += sizeof(struct inotify_event) + event->len;
+                    if (event->mask & IN_Q_OVERFLOW) {
+                        // 丢了事件，全部重新加载
+                        for (auto& i : m_files) {
+                            pending.insert(i.second);
+                        }
+                        hit = true;
+                        continue;
+                    }
+                    auto dir = m_dirs.find(event->wd);
+                    if (dir == m_dirs.end() || !event->len) {
+                        continue;
+                    }
+                    auto file = m_files.find(dir->second + "/" + event->name);
+                    if (file != m_files.end()) {
+                        pending.insert(file->second);
+                        hit = true;
+                    }
+                }
+            }
+            // 同目录下其它文件的事件不推迟加载
+            if (hit) {
+                deadline = GetMonotonicMS() + m_delay;
+            }
+        }
+        if (!pending.empty() && GetMonotonicMS() >= deadline) {
+            reload(pending);
+            pending.clear();
+        }
+    }
+}
+
+}
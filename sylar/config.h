@@ -11,6 +11,7 @@
 #include <list>
 #include <typeinfo>
 #include <functional>
+#include <sched.h>
 
 #include <boost/lexical_cast.hpp>
 #include <yaml-cpp/yaml.h>
@@ -44,8 +45,36 @@ public:
 
     virtual std::string toString() = 0;
     virtual bool fromString(const std::string &val) = 0;
+    // 直接从YAML节点读写，LoadFromYaml不再把子树输出成字符串
+    virtual YAML::Node toNode() = 0;
+    virtual bool fromNode(const YAML::Node& node) = 0;
     virtual std::string getTypeName() const = 0;
 
+    // Config::Transaction中暂存的一个新值
+    // 替换成功的暂存值持有替换前的值，由commit整批交给一次Epoch::retire后析构
+    class Staged {
+    public:
+        using ptr = std::shared_ptr<Staged>;
+        virtual ~Staged() {}
+        // 替换当前值，与当前值相同时不替换并返回false
+        virtual bool install() = 0;
+        // 替换成功后以替换前后的值调用监听者
+        virtual void notify() = 0;
+    };
+    // 把节点转换为暂存值，转换失败返回nullptr
+    virtual Staged::ptr stage(const YAML::Node& node) = 0;
+
+    // 全局配置代数，任一配置值改变(setValue或事务提交)后递增，从1开始
+    static uint64_t GetGeneration() { return Generation().load(std::memory_order_relaxed); }
+    static void BumpGeneration() { Generation().fetch_add(1, std::memory_order_release); }
+
+protected:
+    // 常量初始化，访问时没有初始化检查
+    static std::atomic<uint64_t>& Generation() {
+        static std::atomic<uint64_t> s_generation {1};
+        return s_generation;
+    }
+
 protected:
     std::string m_name;
     std::string m_description;
@@ -61,18 +90,56 @@ public:
     }
 };
 
+// YAML::Node <-> T
+// 默认经由字符串转换，用户只特化了字符串版本的类型也能用；
+// 容器直接遍历子节点，不再对每个元素做一次输出+YAML::Load。需要快速加载的自定义类型可以特化这两个
+template <typename T>
+class LexicalCast<YAML::Node, T> {
+public:
+    T operator()(const YAML::Node& node) {
+        if (node.IsScalar()) {
+            return LexicalCast<std::string, T>()(node.Scalar());
+        }
+        std::stringstream ss;
+        ss << node;
+        return LexicalCast<std::string, T>()(ss.str());
+    }
+};
+
+template <typename T>
+class LexicalCast<T, YAML::Node> {
+public:
+    YAML::Node operator()(const T& v) {
+        return YAML::Load(LexicalCast<T, std::string>()(v));
+    }
+};
+
+template <>
+class LexicalCast<YAML::Node, YAML::Node> {
+public:
+    YAML::Node operator()(const YAML::Node& node) {
+        return node;
+    }
+};
+
+// 字符串值本身就是标量，不当作YAML文本解析
+template <>
+class LexicalCast<std::string, YAML::Node> {
+public:
+    YAML::Node operator()(const std::string& v) {
+        return YAML::Node(v);
+    }
+};
+
 // std::vector
 template <typename T>
-class LexicalCast<std::string, std::vector<T> > {
+class LexicalCast<YAML::Node, std::vector<T> > {
 public:
-    std::vector<T> operator()(const std::string& v) {
-        YAML::Node node = YAML::Load(v);
+    std::vector<T> operator()(const YAML::Node& node) {
         typename std::vector<T> vec;
-        std::stringstream ss;
-        for (size_t i = 0; i < node.size(); ++i) {
-            ss.str("");
-            ss << node[i];
-            vec.push_back(LexicalCast<std::string, T>()(ss.str()));
+        vec.reserve(node.size());
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            vec.push_back(LexicalCast<YAML::Node, T>()(*it));
         }
 
         return vec;
@@ -80,32 +147,44 @@ public:
 };
 
 template <typename T>
-class LexicalCast<std::vector<T>, std::string> {
+class LexicalCast<std::vector<T>, YAML::Node> {
 public:
-    std::string operator()(const std::vector<T>& v) {
+    YAML::Node operator()(const std::vector<T>& v) {
         YAML::Node node;
         for (auto& i : v) {
-            node.push_back(YAML::Load(LexicalCast<T, std::string>()(i)));
+            node.push_back(LexicalCast<T, YAML::Node>()(i));
         }
 
+        return node;
+    }
+};
+
+template <typename T>
+class LexicalCast<std::string, std::vector<T> > {
+public:
+    std::vector<T> operator()(const std::string& v) {
+        return LexicalCast<YAML::Node, std::vector<T> >()(YAML::Load(v));
+    }
+};
+
+template <typename T>
+class LexicalCast<std::vector<T>, std::string> {
+public:
+    std::string operator()(const std::vector<T>& v) {
         std::stringstream ss;
-        ss << node;
+        ss << LexicalCast<std::vector<T>, YAML::Node>()(v);
         return ss.str();
     }
 };
 
 // std::list
 template <typename T>
-class LexicalCast<std::string, std::list<T> > {
+class LexicalCast<YAML::Node, std::list<T> > {
 public:
-    std::list<T> operator()(const std::string& v) {
-        YAML::Node node = YAML::Load(v);
+    std::list<T> operator()(const YAML::Node& node) {
         typename std::list<T> vec;
-        std::stringstream ss;
-        for (size_t i = 0; i < node.size(); ++i) {
-            ss.str("");
-            ss << node[i];
-            vec.push_back(LexicalCast<std::string, T>()(ss.str()));
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            vec.push_back(LexicalCast<YAML::Node, T>()(*it));
         }
 
         return vec;
@@ -113,32 +192,44 @@ public:
 };
 
 template <typename T>
-class LexicalCast<std::list<T>, std::string> {
+class LexicalCast<std::list<T>, YAML::Node> {
 public:
-    std::string operator()(const std::list<T>& v) {
+    YAML::Node operator()(const std::list<T>& v) {
         YAML::Node node;
         for (auto& i : v) {
-            node.push_back(YAML::Load(LexicalCast<T, std::string>()(i)));
+            node.push_back(LexicalCast<T, YAML::Node>()(i));
         }
 
+        return node;
+    }
+};
+
+template <typename T>
+class LexicalCast<std::string, std::list<T> > {
+public:
+    std::list<T> operator()(const std::string& v) {
+        return LexicalCast<YAML::Node, std::list<T> >()(YAML::Load(v));
+    }
+};
+
+template <typename T>
+class LexicalCast<std::list<T>, std::string> {
+public:
+    std::string operator()(const std::list<T>& v) {
         std::stringstream ss;
-        ss << node;
+        ss << LexicalCast<std::list<T>, YAML::Node>()(v);
         return ss.str();
     }
 };
 
 // std::set
 template <typename T>
-class LexicalCast<std::string, std::set<T> > {
+class LexicalCast<YAML::Node, std::set<T> > {
 public:
-    std::set<T> operator()(const std::string& v) {
-        YAML::Node node = YAML::Load(v);
+    std::set<T> operator()(const YAML::Node& node) {
         typename std::set<T> vec;
-        std::stringstream ss;
-        for (size_t i = 0; i < node.size(); ++i) {
-            ss.str("");
-            ss << node[i];
-            vec.insert(LexicalCast<std::string, T>()(ss.str()));
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            vec.insert(LexicalCast<YAML::Node, T>()(*it));
         }
 
         return vec;
@@ -146,32 +237,45 @@ public:
 };
 
 template <typename T>
-class LexicalCast<std::set<T>, std::string> {
+class LexicalCast<std::set<T>, YAML::Node> {
 public:
-    std::string operator()(const std::set<T>& v) {
+    YAML::Node operator()(const std::set<T>& v) {
         YAML::Node node;
         for (auto& i : v) {
-            node.push_back(YAML::Load(LexicalCast<T, std::string>()(i)));
+            node.push_back(LexicalCast<T, YAML::Node>()(i));
         }
 
+        return node;
+    }
+};
+
+template <typename T>
+class LexicalCast<std::string, std::set<T> > {
+public:
+    std::set<T> operator()(const std::string& v) {
+        return LexicalCast<YAML::Node, std::set<T> >()(YAML::Load(v));
+    }
+};
+
+template <typename T>
+class LexicalCast<std::set<T>, std::string> {
+public:
+    std::string operator()(const std::set<T>& v) {
         std::stringstream ss;
-        ss << node;
+        ss << LexicalCast<std::set<T>, YAML::Node>()(v);
         return ss.str();
     }
 };
 
 // std::unordered_set
 template <typename T>
-class LexicalCast<std::string, std::unordered_set<T> > {
+class LexicalCast<YAML::Node, std::unordered_set<T> > {
 public:
-    std::unordered_set<T> operator()(const std::string& v) {
-        YAML::Node node = YAML::Load(v);
+    std::unordered_set<T> operator()(const YAML::Node& node) {
         typename std::unordered_set<T> vec;
-        std::stringstream ss;
-        for (size_t i = 0; i < node.size(); ++i) {
-            ss.str("");
-            ss << node[i];
-            vec.insert(LexicalCast<std::string, T>()(ss.str()));
+        vec.reserve(node.size());
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            vec.insert(LexicalCast<YAML::Node, T>()(*it));
         }
 
         return vec;
@@ -179,32 +283,45 @@ public:
 };
 
 template <typename T>
-class LexicalCast<std::unordered_set<T>, std::string> {
+class LexicalCast<std::unordered_set<T>, YAML::Node> {
 public:
-    std::string operator()(const std::unordered_set<T>& v) {
+    YAML::Node operator()(const std::unordered_set<T>& v) {
         YAML::Node node;
         for (auto& i : v) {
-            node.push_back(YAML::Load(LexicalCast<T, std::string>()(i)));
+            node.push_back(LexicalCast<T, YAML::Node>()(i));
         }
 
+        return node;
+    }
+};
+
+template <typename T>
+class LexicalCast<std::string, std::unordered_set<T> > {
+public:
+    std::unordered_set<T> operator()(const std::string& v) {
+        return LexicalCast<YAML::Node, std::unordered_set<T> >()(YAML::Load(v));
+    }
+};
+
+template <typename T>
+class LexicalCast<std::unordered_set<T>, std::string> {
+public:
+    std::string operator()(const std::unordered_set<T>& v) {
         std::stringstream ss;
-        ss << node;
+        ss << LexicalCast<std::unordered_set<T>, YAML::Node>()(v);
         return ss.str();
     }
 };
 
 // std::map
+// 键唯一，用force_insert追加，避免node[key]逐个线性查找
 template <typename T>
-class LexicalCast<std::string, std::map<std::string, T> > {
+class LexicalCast<YAML::Node, std::map<std::string, T> > {
 public:
-    std::map<std::string, T> operator()(const std::string& v) {
-        YAML::Node node = YAML::Load(v);
+    std::map<std::string, T> operator()(const YAML::Node& node) {
         typename std::map<std::string, T> vec;
-        std::stringstream ss;
         for (auto it = node.begin(); it != node.end(); ++it) {
-            ss.str("");
-            ss << it->second;
-            vec.insert(std::make_pair(it->first.Scalar(), LexicalCast<std::string, T>()(ss.str())));
+            vec.insert(std::make_pair(it->first.Scalar(), LexicalCast<YAML::Node, T>()(it->second)));
         }
 
         return vec;
@@ -212,32 +329,45 @@ public:
 };
 
 template <typename T>
-class LexicalCast<std::map<std::string, T>, std::string> {
+class LexicalCast<std::map<std::string, T>, YAML::Node> {
 public:
-    std::string operator()(const std::map<std::string, T>& v) {
+    YAML::Node operator()(const std::map<std::string, T>& v) {
         YAML::Node node;
         for (auto& i : v) {
-            node[i.first] = YAML::Load(LexicalCast<T, std::string>()(i.second));
+            node.force_insert(i.first, LexicalCast<T, YAML::Node>()(i.second));
         }
 
+        return node;
+    }
+};
+
+template <typename T>
+class LexicalCast<std::string, std::map<std::string, T> > {
+public:
+    std::map<std::string, T> operator()(const std::string& v) {
+        return LexicalCast<YAML::Node, std::map<std::string, T> >()(YAML::Load(v));
+    }
+};
+
+template <typename T>
+class LexicalCast<std::map<std::string, T>, std::string> {
+public:
+    std::string operator()(const std::map<std::string, T>& v) {
         std::stringstream ss;
-        ss << node;
+        ss << LexicalCast<std::map<std::string, T>, YAML::Node>()(v);
         return ss.str();
     }
 };
 
 // std::unordered_map
 template <typename T>
-class LexicalCast<std::string, std::unordered_map<std::string, T> > {
+class LexicalCast<YAML::Node, std::unordered_map<std::string, T> > {
 public:
-    std::unordered_map<std::string, T> operator()(const std::string& v) {
-        YAML::Node node = YAML::Load(v);
+    std::unordered_map<std::string, T> operator()(const YAML::Node& node) {
         typename std::unordered_map<std::string, T> vec;
-        std::stringstream ss;
+        vec.reserve(node.size());
         for (auto it = node.begin(); it != node.end(); ++it) {
-            ss.str("");
-            ss << it->second;
-            vec.insert(std::make_pair(it->first.Scalar(), LexicalCast<std::string, T>()(ss.str())));
+            vec.insert(std::make_pair(it->first.Scalar(), LexicalCast<YAML::Node, T>()(it->second)));
         }
 
         return vec;
@@ -245,24 +375,46 @@ public:
 };
 
 template <typename T>
-class LexicalCast<std::unordered_map<std::string, T>, std::string> {
+class LexicalCast<std::unordered_map<std::string, T>, YAML::Node> {
 public:
-    std::string operator()(const std::unordered_map<std::string, T>& v) {
+    YAML::Node operator()(const std::unordered_map<std::string, T>& v) {
         YAML::Node node;
         for (auto& i : v) {
-            node[i.first] = YAML::Load(LexicalCast<T, std::string>()(i.second));
+            node.force_insert(i.first, LexicalCast<T, YAML::Node>()(i.second));
         }
 
+        return node;
+    }
+};
+
+template <typename T>
+class LexicalCast<std::string, std::unordered_map<std::string, T> > {
+public:
+    std::unordered_map<std::string, T> operator()(const std::string& v) {
+        return LexicalCast<YAML::Node, std::unordered_map<std::string, T> >()(YAML::Load(v));
+    }
+};
+
+template <typename T>
+class LexicalCast<std::unordered_map<std::string, T>, std::string> {
+public:
+    std::string operator()(const std::unordered_map<std::string, T>& v) {
         std::stringstream ss;
-        ss << node;
+        ss << LexicalCast<std::unordered_map<std::string, T>, YAML::Node>()(v);
         return ss.str();
     }
 };
 
 // T FromStr::operator()(const std::string&)
 // std::string ToStr::operator()(const T&)
+// T FromNode::operator()(const YAML::Node&)
+// YAML::Node ToNode::operator()(const T&)
+// 值以不可变快照发布：读者原子地取指针，写者替换指针后把旧值交给Epoch延迟释放
+// 读不加锁；m_mutex只保护监听者并串行化写者
 template <typename T, typename FromStr = LexicalCast<std::string, T>,
-          typename ToStr = LexicalCast<T, std::string>>
+          typename ToStr = LexicalCast<T, std::string>,
+          typename FromNode = LexicalCast<YAML::Node, T>,
+          typename ToNode = LexicalCast<T, YAML::Node>>
 class ConfigVar : public ConfigVarBase
 {
 public:
@@ -271,20 +423,88 @@ public:
     using on_change_cb = std::function<void (const T&old_value, const T& new_value)>;
     using RWMutexType = ConfigRWMutex;
 
+    // getValue()返回的句柄，持有期间所指的值不会被释放，即使其间setValue替换了它
+    // 句柄处于当前线程的Epoch读临界区内，只在局部作用域使用:
+    // 不要跨线程传递，不要在协程切换期间持有；需要长期保存时复制出值
+    // 不提供到const T&的隐式转换，避免引用比句柄活得更久
+    class Snapshot {
+    public:
+        explicit Snapshot(const std::atomic<T*>& val) {
+            Epoch::GetInstance()->enter();
+            m_val = val.load(std::memory_order_acquire);
+        }
+        Snapshot(Snapshot&& rhs) : m_val(rhs.m_val) { rhs.m_val = nullptr; }
+        ~Snapshot() {
+            if (m_val) {
+                Epoch::GetInstance()->leave();
+            }
+        }
+
+        const T& get() const { return *m_val; }
+        const T& operator*() const { return *m_val; }
+        const T* operator->() const { return m_val; }
+
+    private:
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+        Snapshot& operator=(Snapshot&&) = delete;
+
+    private:
+        const T* m_val;
+    };
+
+    // 线程私有的值副本，全局配置代数变化时才重新读取
+    // 稳定状态下get()只有一次relaxed load和比较；刷新时复制整个值，适合小而热的配置项
+    // 非线程安全，每个线程一个，通常声明为thread_local:
+    //   static thread_local ConfigVar<uint32_t>::Cached t_size(g_size);
+    // 构造函数为constexpr，T可平凡析构时thread_local变量没有初始化检查
+    // var须比句柄活得更久；任一线程setValue后，其它线程的下一次get()即可看到新值
+    class Cached {
+    public:
+        constexpr explicit Cached(const ConfigVar::ptr& var) : m_var(&var) {}
+
+        const T& get() {
+            uint64_t gen = ConfigVarBase::GetGeneration();
+            if (gen != m_version) {
+                refresh(gen);
+            }
+            return m_val;
+        }
+        const T& operator*() { return get(); }
+        const T* operator->() { return &get(); }
+
+    private:
+        void refresh(uint64_t gen) {
+            // 与BumpGeneration的release配对，保证读到不早于该代的值
+            std::atomic_thread_fence(std::memory_order_acquire);
+            m_val = *(*m_var)->getValue();
+            m_version = gen;
+        }
+
+    private:
+        const ConfigVar::ptr* m_var;
+        uint64_t m_version = 0;
+        T m_val {};
+    };
+
     ConfigVar(const std::string& name, const T& default_value, const std::string& description = "") 
-        : ConfigVarBase(name, description), m_val(default_value) {
+        : ConfigVarBase(name, description), m_val(new T(default_value)) {
+    }
+
+    // 此时不应再有读者
+    ~ConfigVar() {
+        delete m_val.load(std::memory_order_relaxed);
     }
 
     std::string toString() override {
         try {
-            RWMutexType::ReadLock lock(m_mutex);
             // return boost::lexical_cast<std::string>(m_val);
-            return ToStr()(m_val);
+            return ToStr()(*getValue());
         }
         catch (std::exception& e)
         {
             SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::toString exception " 
-                << e.what() << " convert: " << typeid(m_val).name() << " to string";
+                << e.what() << " convert: " << typeid(T).name() << " to string";
         }
         return "..."; 
     }
@@ -298,29 +518,80 @@ public:
         catch (std::exception &e)
         {
             SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::fromString exception " 
-                << e.what() << " convert: string to " << typeid(m_val).name() << val;
+                << e.what() << " convert: string to " << typeid(T).name() << val;
         }
         return false;
     }
 
-    const T &getValue() const { 
-        RWMutexType::ReadLock lock(m_mutex);
-        return m_val; 
+    YAML::Node toNode() override {
+        try {
+            return ToNode()(*getValue());
+        }
+        catch (std::exception& e)
+        {
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::toNode exception " 
+                << e.what() << " convert: " << typeid(T).name() << " to node";
+        }
+        return YAML::Node();
+    }
+
+    bool fromNode(const YAML::Node& node) override {
+        try {
+            setValue(FromNode()(node));
+            return true;
+        }
+        catch (std::exception &e)
+        {
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::fromNode exception " 
+                << e.what() << " convert: node to " << typeid(T).name() << " " << node;
+        }
+        return false;
+    }
+
+    ConfigVarBase::Staged::ptr stage(const YAML::Node& node) override {
+        try {
+            return stage(FromNode()(node));
+        }
+        catch (std::exception &e)
+        {
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::stage exception " 
+                << e.what() << " convert: node to " << typeid(T).name() << " " << node;
+        }
+        return nullptr;
+    }
+
+    // 暂存v，由Config::Transaction提交
+    ConfigVarBase::Staged::ptr stage(const T& v) {
+        return std::make_shared<StagedValue>(this, v);
+    }
+
+    // 无锁，一次原子load
+    Snapshot getValue() const { 
+        return Snapshot(m_val);
     }
     void setValue(const T &v) { 
         {
             RWMutexType::ReadLock lock(m_mutex);
-            if (v == m_val) {
+            // 持有读锁时值不会被替换
+            const T& cur = *m_val.load(std::memory_order_acquire);
+            if (v == cur) {
                 return;
             }
 
             for (auto& i : m_cbs) {
-                i.second(m_val, v); // 回调，通知观察者配置发生改变
+                i.second(cur, v); // 回调，通知观察者配置发生改变
             }
         }
         
-        RWMutexType::WriteLock lock(m_mutex);
-        m_val = v;
+        T* val = new T(v);
+        T* old = nullptr;
+        {
+            RWMutexType::WriteLock lock(m_mutex);
+            old = m_val.exchange(val, std::memory_order_acq_rel);
+        }
+        BumpGeneration();
+        // 仍持有旧值句柄的读者离开后才释放
+        Epoch::GetInstance()->retire([old](){ delete old; });
     }
     std::string getTypeName() const override { return typeid(T).name(); }
 
@@ -349,7 +620,49 @@ public:
     }
 
 private:
-    T m_val;
+    // 持有提交前的值直到监听者执行完，析构时已过Epoch宽限期，直接释放
+    class StagedValue : public ConfigVarBase::Staged {
+    public:
+        StagedValue(ConfigVar* var, const T& v) : m_var(var), m_value(v) {}
+        ~StagedValue() { delete m_old; }
+        bool install() override { return m_var->install(*this); }
+        void notify() override { m_var->notify(*m_old, m_value); }
+
+    private:
+        friend class ConfigVar;
+        ConfigVar* m_var;
+        T m_value;
+        T* m_old = nullptr;
+    };
+
+    bool install(StagedValue& staged) {
+        T* val = new T(staged.m_value);
+        {
+            RWMutexType::WriteLock lock(m_mutex);
+            if (*val == *m_val.load(std::memory_order_relaxed)) {
+                lock.unlock();
+                delete val;
+                return false;
+            }
+            staged.m_old = m_val.exchange(val, std::memory_order_acq_rel);
+        }
+        return true;
+    }
+
+    // 不持锁调用，监听者中可以再读写配置
+    void notify(const T& old_value, const T& new_value) {
+        std::map<uint64_t, on_change_cb> cbs;
+        {
+            RWMutexType::ReadLock lock(m_mutex);
+            cbs = m_cbs;
+        }
+        for (auto& i : cbs) {
+            i.second(old_value, new_value);
+        }
+    }
+
+private:
+    std::atomic<T*> m_val;
     // 变更回调函数组，uint64_t key，要求唯一，一般可以用hash
     std::map<uint64_t, on_change_cb> m_cbs;
     mutable RWMutexType m_mutex;
@@ -405,7 +718,65 @@ public:
         return ret;
     }
 
+    // 批量更新：先暂存，commit时在一把锁内替换所有值，只递增一次配置代数
+    // 监听者在全部替换完成后才调用，每个配置项只回调一次，旧值为提交前的值
+    // (单独的setValue在替换前回调)。指定executor时每个配置项的监听者作为一个任务交给它执行，例如
+    //   Config::Transaction txn([&](std::function<void()> cb) { scheduler->schedule(cb); });
+    // 未提交就析构的事务被丢弃
+    class Transaction {
+    public:
+        using Executor = std::function<void(std::function<void()>)>;
+
+        Transaction(Executor executor = nullptr) : m_executor(executor) {}
+
+        // 同一配置项多次暂存时以最后一次为准，监听者按首次暂存的顺序调用
+        template<class V>
+        void set(const std::shared_ptr<V>& var, const typename V::type& v) {
+            stage(var, var->stage(v));
+        }
+        // 转换失败时返回false，该项不暂存
+        bool set(const ConfigVarBase::ptr& var, const YAML::Node& node);
+        bool set(const std::string& name, const YAML::Node& node);
+
+        size_t size() const { return m_staged.size(); }
+        // 返回值真正改变的配置项数
+        size_t commit();
+
+    private:
+        void stage(const ConfigVarBase::ptr& var, ConfigVarBase::Staged::ptr staged);
+
+    private:
+        Executor m_executor;
+        std::vector<std::pair<ConfigVarBase::ptr, ConfigVarBase::Staged::ptr> > m_staged;
+        std::unordered_map<ConfigVarBase*, size_t> m_index; // 配置项在m_staged中的下标
+    };
+
+    // 读多个配置项时不会看到提交了一半的事务；f可能被执行多次，只应读取配置
+    //   Config::ReadConsistent([&]() { host = *g_host->getValue(); port = *g_port->getValue(); });
+    template<class F>
+    static void ReadConsistent(F f) {
+        while (true) {
+            uint64_t seq = GetCommitSeq().load(std::memory_order_acquire);
+            if (seq & 1) {
+                sched_yield();
+                continue;
+            }
+            f();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (GetCommitSeq().load(std::memory_order_relaxed) == seq) {
+                return;
+            }
+        }
+    }
+
+    // 通过Transaction一次提交
     static void LoadFromYaml(const YAML::Node &root);
+    // 增量加载：与old中同一位置的子树相同的配置项不再调用fromNode，相同的整棵子树直接跳过
+    // root中已删除的项保持当前值
+    static void LoadFromYaml(const YAML::Node &root, const YAML::Node &old);
+    // 加载YAML文件并记住其内容；再次加载同一文件时与上次的内容比较，只更新有变化的项
+    // 文件读取或解析失败时返回false，配置保持不变
+    static bool LoadFromFile(const std::string &path);
 
     static ConfigVarBase::ptr LookupBase(const std::string &name);
 
@@ -425,5 +796,67 @@ private:
         static RWMutexType s_mutex;
         return s_mutex;
     }
+
+    // LoadFromFile加载过的文件 -> 上次加载的内容
+    static std::map<std::string, YAML::Node>& GetFiles() {
+        static std::map<std::string, YAML::Node> s_files;
+        return s_files;
+    }
+
+    static Mutex& GetFileMutex() {
+        static Mutex s_mutex;
+        return s_mutex;
+    }
+
+    // 串行化事务提交
+    static Mutex& GetCommitMutex() {
+        static Mutex s_mutex;
+        return s_mutex;
+    }
+
+    // 提交事务期间为奇数
+    static std::atomic<uint64_t>& GetCommitSeq() {
+        static std::atomic<uint64_t> s_seq {0};
+        return s_seq;
+    }
+};
+
+// 配置文件热加载
+// 用inotify监视文件所在目录，文件被改写(close_write)或被rename替换后，在后台线程上调用
+// Config::LoadFromFile增量重新加载，未改变的配置项、日志器和监听者都不受影响
+// 监视目录而不是文件，编辑器"写临时文件再rename"的保存方式也能感知
+// 没有可以注册fd的事件循环，使用一个sylar::Thread
+class ConfigWatcher {
+public:
+    using ptr = std::shared_ptr<ConfigWatcher>;
+    static constexpr uint64_t kDefaultDelay = 100;
+
+    // delay_ms: 收到事件后等待的时间，期间同一文件的多次写入只重新加载一次
+    ConfigWatcher(uint64_t delay_ms = kDefaultDelay);
+    ~ConfigWatcher();
+
+    // 先加载文件再开始监视；加载失败或无法监视时返回false
+    bool watch(const std::string& path);
+    void stop();
+
+    // 成功的重新加载次数
+    uint64_t getReloads() const { return m_reloads.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void reload(const std::set<std::string>& paths);
+
+private:
+    uint64_t m_delay;
+    int m_inotifyFd = -1;
+    int m_wakeFd = -1;
+    std::atomic<bool> m_stopping {false};
+    std::atomic<uint64_t> m_reloads {0};
+    Mutex m_mutex;
+    // inotify wd -> 目录
+    std::map<int, std::string> m_dirs;
+    // 目录/文件名 -> 传给watch的路径
+    std::map<std::string, std::string> m_files;
+    Thread::ptr m_thread;
 };
 }
@@ -19,6 +19,8 @@ static thread_local std::shared_ptr<Fiber> t_threadFiber = nullptr;
 
 static ConfigVar<uint32_t>::ptr g_fiber_stack_size 
 	= Config::Lookup<uint32_t>("fiber.stack_size", 1024 * 1024, "fiber stack size");
+// 每次构造Fiber都要读，用线程私有的副本
+static thread_local ConfigVar<uint32_t>::Cached t_fiber_stack_size(g_fiber_stack_size);
 
 class MallocStackAllocator {
 public:
@@ -63,7 +65,7 @@ Fiber::Fiber(std::function<void ()> cb, size_t stactsize)
     SYLAR_ASSERT2(t_fiber == t_threadFiber.get(), "child fiber should be constructed in main fiber");
 
 	++s_fiber_count;
-    m_stacksize = stactsize ? stactsize : g_fiber_stack_size->getValue();
+    m_stacksize = stactsize ? stactsize : t_fiber_stack_size.get();
 
     m_stack = StackAllocator::Alloc(m_stacksize);
     if (getcontext(&m_ctx)) {
@@ -1,16 +1,29 @@
 #include "log.h"
 
 #include <map>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <functional>
 
 #include <cassert>
+#include <charconv>
+#include <cmath>
 #include <ctime>
 #include <cstring>
 
+#include <sched.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <boost/filesystem.hpp>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "unistd.h"
 
 
@@ -54,183 +67,328 @@ LogLevel::Level LogLevel::FromString(const std::string& str) {
     return LogLevel::UNKNOW;
 }
 
-class MessageFormatItem : public LogFormatter::FormatItem {
-public:
-    MessageFormatItem([[maybe_unused]] const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-#ifdef TEST_LOG_MUTEX_USLEEP
-        // sleep here to test mutex
-        ::usleep(1000);
-#endif // TEST_LOG_MUTEX_USLEEP
-        os << event->getContent();
-    }
+static const char* s_stdout_colors[] = {
+    "",                     // UNKNOW
+    "\033[32m\033[1m",      // DEBUG
+    "\033[0m\033[1m ",      // INFO
+    "\033[33m\033[1m ",     // WARN
+    "\033[31m\033[1m",      // ERROR
+    "\033[35m\033[1m"       // FATAL
 };
 
-class LevelFormatItem : public LogFormatter::FormatItem {
-public:
-    LevelFormatItem([[maybe_unused]] const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << LogLevel::ToString(event->getLevel());
-    }
-};
+static const char *stdout_clearfmt = "\033[0m";
 
-class ElapseFormatItem : public LogFormatter::FormatItem {
-public:
-    ElapseFormatItem([[maybe_unused]] const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << event->getElapse();
+// 整数转十进制直接追加，不经过iostream
+static void AppendUInt(std::string& out, uint64_t v) {
+    char buf[24];
+    char* p = buf + sizeof(buf);
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    out.append(p, buf + sizeof(buf) - p);
+}
+
+static void AppendInt(std::string& out, int64_t v) {
+    if (v < 0) {
+        out.push_back('-');
+        AppendUInt(out, 0 - (uint64_t)v);
+    } else {
+        AppendUInt(out, v);
     }
-};
+}
 
-class NameFormatItem : public LogFormatter::FormatItem {
-public:
-    NameFormatItem([[maybe_unused]] const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << event->getLogger()->getName();
+// 最短的可还原表示；json下nan/inf没有合法写法，输出null
+static void AppendDouble(std::string& out, double v, bool json) {
+    if (json && !std::isfinite(v)) {
+        out.append("null");
+        return;
     }
-};
+    char buf[32];
+    auto r = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, r.ptr - buf);
+}
 
-class ThreadIDFormatItem : public LogFormatter::FormatItem {
-public:
-    ThreadIDFormatItem([[maybe_unused]] const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << event->getThreadId();
+// 字段值转文本，json为true时字符串加引号并转义
+static void AppendFieldValue(std::string& out, const LogEvent& event,
+        const LogField& field, bool json) {
+    switch (field.type) {
+        case LogField::INT:
+            AppendInt(out, field.i);
+            break;
+        case LogField::UINT:
+            AppendUInt(out, field.u);
+            break;
+        case LogField::DOUBLE:
+            AppendDouble(out, field.d, json);
+            break;
+        case LogField::BOOL:
+            out.append(field.b ? "true" : "false");
+            break;
+        case LogField::STRING: {
+            std::string_view str = event.getFieldString(field);
+            if (json) {
+                out.push_back('"');
+                JsonLogFormatter::AppendEscaped(out, str.data(), str.size());
+                out.push_back('"');
+            } else {
+                out.append(str.data(), str.size());
+            }
+            break;
+        }
     }
-};
+}
 
-class FiberIDFormatItem : public LogFormatter::FormatItem {
-public:
-    FiberIDFormatItem([[maybe_unused]] const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << event->getFiberId();
+LogCallSite::LogCallSite(const char* file, int32_t line, const char* func, LogLevel::Level level,
+        const char* format)
+    : m_file(file)
+    , m_shortFile(ShortFilename(file))
+    , m_relativeFile(RelativeFilename(file))
+    , m_line(line)
+    , m_func(func)
+    , m_level(level)
+    , m_format(format) {
+}
+
+bool LogSiteRule::match(const char* path, int32_t line_no, const char* func_name) const {
+    if (!func.empty()) {
+        return func_name && func == func_name;
     }
-};
+    size_t n = strlen(path);
+    size_t m = file.size();
+    if (n < m || file.compare(0, m, path + n - m) != 0
+            || (n > m && path[n - m - 1] != '/')) {
+        return false;
+    }
+    return line_no >= begin && line_no <= end;
+}
 
-class ThreadNameFormatItem : public LogFormatter::FormatItem {
-public:
-    ThreadNameFormatItem([[maybe_unused]] const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << event->getThreadName();
+std::string LogSiteRule::toString() const {
+    if (!func.empty()) {
+        return func + "()";
     }
-};
+    std::string str = file;
+    if (begin != 0 || end != INT32_MAX) {
+        str += ":" + std::to_string(begin);
+        if (end != begin) {
+            str += "-" + std::to_string(end);
+        }
+    }
+    return str;
+}
 
-class DateTimeFormatItem : public LogFormatter::FormatItem {
-public:
-    DateTimeFormatItem(const std::string& format = "%Y-%m-%d %H:%M:%S")
-        : m_format(format) {
-        if (m_format.empty()) {
-            m_format = "%Y-%m-%d %H:%M:%S";
+bool LogSiteRule::Parse(const std::string& str, LogSiteRule& rule) {
+    rule = LogSiteRule();
+    if (str.size() >= 2 && str.compare(str.size() - 2, 2, "()") == 0) {
+        rule.func = str.substr(0, str.size() - 2);
+        size_t pos = rule.func.rfind("::");
+        if (pos != std::string::npos) {
+            rule.func = rule.func.substr(pos + 2);
         }
+        return !rule.func.empty();
     }
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        struct tm tm;
-        time_t time = event->getTime();
-        localtime_r(&time, &tm);
-        char buf[64];
-        strftime(buf, sizeof(buf), m_format.c_str(), &tm);
-        os << buf;
+
+    size_t pos = str.rfind(':');
+    rule.file = str.substr(0, pos);
+    if (pos != std::string::npos) {
+        const char* p = str.c_str() + pos + 1;
+        char* end = nullptr;
+        long begin = strtol(p, &end, 10);
+        if (end == p || begin < 0 || begin > INT32_MAX) {
+            return false;
+        }
+        long last = begin;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < begin || last > INT32_MAX) {
+                return false;
+            }
+        }
+        if (*end) {
+            return false;
+        }
+        rule.begin = begin;
+        rule.end = last;
     }
-private:
-    std::string m_format;
-};
+    return !rule.file.empty();
+}
 
-class FilenameFormatItem : public LogFormatter::FormatItem {
-public:
-    FilenameFormatItem([[maybe_unused]] const std::string& str = "") : m_str(str) {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        if (m_str == "s") {
-            // 简化目录层级输出
-            boost::filesystem::path p(std::string(event->getFile()));
-            std::string filename = p.filename().string();
-            std::stringstream ss;
-            p.remove_filename();
-            for (auto& s : p) {
-                ss << s.string()[0];
-                if (s.string() != "/") {
-                    ss << "/";
+// 已登记的调用点开关和各logger的规则
+// 开关属于函数内static，登记后不会释放，注册表也不析构
+struct LogSiteRegistry {
+    LogMutex mutex;
+    LogSiteSwitch* head = nullptr;
+    std::map<const Logger*, std::vector<LogSiteRule> > rules;
+
+    bool match(const char* file, int32_t line, const char* func) const {
+        for (auto& i : rules) {
+            for (auto& r : i.second) {
+                if (r.match(file, line, func)) {
+                    return true;
                 }
             }
-            ss << filename;
-
-            os << ss.str();
-        } else if (m_str == "r") {
-            os << boost::filesystem::relative(std::string(event->getFile())).string();
-        } else {
-            os << event->getFile();
         }
+        return false;
     }
-private:
-    std::string m_str;
 };
 
-class LineFormatItem : public LogFormatter::FormatItem {
-public:
-    LineFormatItem([[maybe_unused]] const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << event->getLine();
+static LogSiteRegistry* GetLogSiteRegistry() {
+    static LogSiteRegistry* s_registry = new LogSiteRegistry;
+    return s_registry;
+}
+
+bool LogSiteSwitch::resolve(const char* file, int32_t line, const char* func) {
+    LogSiteRegistry* reg = GetLogSiteRegistry();
+    LogMutex::Lock lock(reg->mutex);
+    if (m_state.load(std::memory_order_relaxed) == UNKNOWN) {
+        m_file = file;
+        m_line = line;
+        m_func = func;
+        m_next = reg->head;
+        reg->head = this;
+        m_state.store(reg->match(file, line, func) ? ENABLED : DISABLED, std::memory_order_relaxed);
     }
-};
+    return m_state.load(std::memory_order_relaxed) == ENABLED;
+}
 
-class NewLineFormatItem : public LogFormatter::FormatItem {
-public:
-    NewLineFormatItem([[maybe_unused]] const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << std::endl;
+void LogSiteSwitch::SetRules(const Logger* logger, const std::vector<LogSiteRule>& rules) {
+    LogSiteRegistry* reg = GetLogSiteRegistry();
+    LogMutex::Lock lock(reg->mutex);
+    if (rules.empty()) {
+        reg->rules.erase(logger);
+    } else {
+        reg->rules[logger] = rules;
     }
-};
+    for (LogSiteSwitch* i = reg->head; i; i = i->m_next) {
+        i->m_state.store(reg->match(i->m_file, i->m_line, i->m_func) ? ENABLED : DISABLED,
+                std::memory_order_relaxed);
+    }
+}
 
-class StringFormatItem : public LogFormatter::FormatItem {
-public:
-    StringFormatItem(const std::string& str) 
-        : m_string(str) {
+size_t LogSiteSwitch::EnabledCount() {
+    LogSiteRegistry* reg = GetLogSiteRegistry();
+    LogMutex::Lock lock(reg->mutex);
+    size_t n = 0;
+    for (LogSiteSwitch* i = reg->head; i; i = i->m_next) {
+        if (i->m_state.load(std::memory_order_relaxed) == ENABLED) {
+            ++n;
+        }
+    }
+    return n;
+}
 
+bool LogCallSite::everyMs(uint64_t ms) const {
+    uint64_t now = GetMonotonicMS();
+    uint64_t last = m_lastMs.load(std::memory_order_relaxed);
+    if ((last == 0 || now - last >= ms)
+            && m_lastMs.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+        return true;
     }
-    void format(std::ostream& os, LogEvent::ptr event) override {
-#ifdef TEST_LOG_MUTEX_USLEEP
-        // sleep here to test mutex
-        ::usleep(10000);
-#endif // TEST_LOG_MUTEX_USLEEP
-        os << m_string;
+    m_suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+// 简化目录层级输出
+std::string LogCallSite::ShortFilename(const char* file) {
+    std::string out;
+    boost::filesystem::path p(file);
+    std::string filename = p.filename().string();
+    p.remove_filename();
+    for (auto& s : p) {
+        out.push_back(s.string()[0]);
+        if (s.string() != "/") {
+            out.push_back('/');
+        }
     }
-private:
-    std::string m_string;
-};
+    out.append(filename);
+    return out;
+}
 
-class TabFormatItem : public LogFormatter::FormatItem {
-public:
-    TabFormatItem([[maybe_unused]] const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << '\t';
+std::string LogCallSite::RelativeFilename(const char* file) {
+    try {
+        return boost::filesystem::relative(std::string(file)).string();
+    } catch (std::exception& e) {
+        // 例如当前目录已被删除
+        return file;
     }
-};
+}
 
-static std::unordered_map<LogLevel::Level, const char*> stdout_colors = {
-    {LogLevel::DEBUG, "\033[32m\033[1m"},
-    {LogLevel::INFO,  "\033[0m\033[1m "},
-    {LogLevel::WARN,  "\033[33m\033[1m "},
-    {LogLevel::ERROR, "\033[31m\033[1m"},
-    {LogLevel::FATAL, "\033[35m\033[1m"}
-};
+LogStreamBuf::LogStreamBuf() {
+    setp(m_inline, m_inline + kInlineSize);
+}
 
-static const char *stdout_clearfmt = "\033[0m";
+void LogStreamBuf::clear() {
+    if (m_heapSize > kMaxRetainSize) {
+        m_heap.reset();
+        m_heapSize = 0;
+    }
+    if (m_heap) {
+        setp(m_heap.get(), m_heap.get() + m_heapSize);
+    } else {
+        setp(m_inline, m_inline + kInlineSize);
+    }
+}
 
-// 带颜色的Level输出, 终端输出时用%P代替%p输出level颜色，给StdoutAppender设置
-class ColorLevelFormatItem : public LogFormatter::FormatItem {
-public:
-    ColorLevelFormatItem([[maybe_unused]] const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        auto level = event->getLevel();
-        os << stdout_colors[level] << LogLevel::ToString(level) << stdout_clearfmt;
+void LogStreamBuf::grow(size_t n) {
+    size_t used = size();
+    size_t cap = epptr() - pbase();
+    size_t new_cap = cap * 2;
+    while (new_cap < used + n) {
+        new_cap *= 2;
     }
-};
 
-LogEvent::LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level, 
+    std::unique_ptr<char[]> heap(new char[new_cap]);
+    memcpy(heap.get(), pbase(), used);
+    m_heap.swap(heap);
+    m_heapSize = new_cap;
+    setp(m_heap.get(), m_heap.get() + new_cap);
+    pbump((int)used);
+}
+
+char* LogStreamBuf::reserve(size_t n) {
+    if ((size_t)(epptr() - pptr()) < n) {
+        grow(n);
+    }
+    return pptr();
+}
+
+void LogStreamBuf::append(const char* s, size_t n) {
+    memcpy(reserve(n), s, n);
+    pbump((int)n);
+}
+
+LogStreamBuf::int_type LogStreamBuf::overflow(int_type ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof())) {
+        return traits_type::not_eof(ch);
+    }
+    char c = traits_type::to_char_type(ch);
+    append(&c, 1);
+    return ch;
+}
+
+std::streamsize LogStreamBuf::xsputn(const char* s, std::streamsize n) {
+    append(s, n);
+    return n;
+}
+
+void LogStream::reset() {
+    m_buf.clear();
+    std::ostream::clear();
+    flags(std::ios_base::dec | std::ios_base::skipws);
+    precision(6);
+    width(0);
+    fill(' ');
+}
+
+LogEvent::LogEvent(Logger* logger, LogLevel::Level level, 
         const char* file, int32_t line, uint32_t elapse,
         uint32_t thread_id, uint32_t fiber_id, uint64_t time,
         const std::string& thread_name) 
     : m_file(file), m_line(line), m_elapse(elapse)
-    , m_threadId(thread_id), m_fiberId(fiber_id), m_time(time)
-    , m_logger(logger), m_level(level), m_threadName(thread_name) {
+    , m_threadId(thread_id), m_fiberId(fiber_id), m_time(time * 1000000000ull)
+    , m_logger(logger), m_level(level), m_threadName(thread_name)
+    , m_ss(this) {
 
 }
 
@@ -238,6 +396,106 @@ LogEvent::~LogEvent() {
 
 }
 
+void LogEvent::reset(Logger* logger, LogLevel::Level level, 
+        const char* file, int32_t line, uint32_t elapse,
+        uint32_t thread_id, uint32_t fiber_id, uint64_t time_ns,
+        const std::string& thread_name) {
+    m_file = file;
+    m_line = line;
+    m_elapse = elapse;
+    m_threadId = thread_id;
+    m_fiberId = fiber_id;
+    m_time = time_ns;
+    m_site = nullptr;
+    m_forced = false;
+    m_logger = logger;
+    m_level = level;
+    m_threadName.assign(thread_name); // 容量足够时不重新分配
+    m_ss.reset();
+
+    m_fieldCount = 0;
+    m_moreFields.clear();
+    if (m_fieldData.capacity() > LogStreamBuf::kMaxRetainSize) {
+        std::string().swap(m_fieldData);
+    } else {
+        m_fieldData.clear();
+    }
+
+    for (auto& c : m_cache) {
+        c.formatter = 0;
+        if (c.text.capacity() > LogStreamBuf::kMaxRetainSize) {
+            std::string().swap(c.text);
+        }
+    }
+    m_shared = false;
+}
+
+const std::string& LogEvent::getFormatted(const LogFormatter& fmt, std::string& scratch) {
+    uint64_t id = fmt.getId();
+    for (auto& c : m_cache) {
+        if (c.formatter == id) {
+            return c.text;
+        }
+    }
+
+    if (m_shared) {
+        scratch.clear();
+        fmt.format(*this, scratch);
+        return scratch;
+    }
+
+    FormatCache& c = m_cache[m_cacheNext];
+    m_cacheNext = (m_cacheNext + 1) % kFormatCacheSize;
+    c.text.clear();
+    fmt.format(*this, c.text);
+    c.formatter = id;
+    return c.text;
+}
+
+LogField& LogEvent::newField(const char* key, LogField::Type type) {
+    LogField* field;
+    if (m_fieldCount < kInlineFields) {
+        field = &m_fields[m_fieldCount];
+    } else {
+        m_moreFields.emplace_back();
+        field = &m_moreFields.back();
+    }
+    ++m_fieldCount;
+    field->key = key;
+    field->type = type;
+    return *field;
+}
+
+void LogEvent::addStringField(const char* key, const char* data, size_t size) {
+    LogField& field = newField(key, LogField::STRING);
+    field.str.offset = m_fieldData.size();
+    field.str.size = size;
+    m_fieldData.append(data, size);
+}
+
+static thread_local LogEvent::ptr t_event;
+
+LogEvent::ptr LogEvent::Create(Logger* logger, LogLevel::Level level,
+        const char* file, int32_t line) {
+    LogEvent::ptr& ev = t_event;
+    if (!ev || ev.use_count() != 1) {
+        ev = std::make_shared<LogEvent>(logger, level, file, line, 0,
+                0, 0, 0, sylar::Thread::GetName());
+    }
+    ev->reset(logger, level, file, line, 0, sylar::GetThreadId(),
+            sylar::GetFiberId(), sylar::GetCurrentNS(), sylar::Thread::GetName());
+    return ev;
+}
+
+LogEvent::ptr LogEvent::Create(Logger* logger, LogLevel::Level level,
+        const LogCallSite& site) {
+    LogEvent::ptr ev = Create(logger, level, site.getFile(), site.getLine());
+    ev->m_site = &site;
+    // 宏只在级别通过或调用点开关打开时才构造事件
+    ev->m_forced = level < logger->getEffectiveLevel();
+    return ev;
+}
+
 void LogEvent::format(const char* fmt, ...) {
     va_list al;
     va_start(al, fmt);
@@ -246,11 +504,162 @@ void LogEvent::format(const char* fmt, ...) {
 }
 
 void LogEvent::format(const char* fmt, va_list al) {
-    char* buf = nullptr;
-    int len = vasprintf(&buf, fmt, al);
-    if (len != -1) {
-        m_ss << std::string(buf, len);
-        free(buf);
+    // 直接格式化到消息缓冲，放不下时按所需长度扩容后重来
+    LogStreamBuf& buf = m_ss.buf();
+    size_t avail = 128;
+    while (true) {
+        char* p = buf.reserve(avail);
+        va_list ap;
+        va_copy(ap, al);
+        int len = vsnprintf(p, avail, fmt, ap);
+        va_end(ap);
+        if (len < 0) {
+            return;
+        }
+        if ((size_t)len < avail) {
+            buf.commit(len);
+            return;
+        }
+        avail = len + 1;
+    }
+}
+
+const char* LogFormat::NextArg(LogStreamBuf& buf, const char* p, Spec& spec) {
+    const char* lit = p;
+    while (*p) {
+        if (*p == '{' || *p == '}') {
+            buf.append(lit, p - lit);
+            if (p[0] == p[1]) {
+                // {{ }}
+                lit = p + 1;
+                p += 2;
+                continue;
+            }
+            spec = Spec();
+            if (p[1] == ':') {
+                p = ParseSpec(p + 2, spec);
+            } else {
+                ++p;
+            }
+            return p + 1;
+        }
+        ++p;
+    }
+    buf.append(lit, p - lit);
+    return p;
+}
+
+// 追加n个填充字符
+static void AppendPadding(LogStreamBuf& buf, char fill, size_t n) {
+    if (n) {
+        memset(buf.reserve(n), fill, n);
+        buf.commit(n);
+    }
+}
+
+void LogFormat::WriteInt(LogStreamBuf& buf, const Spec& spec, uint64_t v, bool neg) {
+    int base = 10;
+    const char* prefix = neg ? "-" : "";
+    switch (spec.type) {
+        case 'x':
+        case 'X':
+            base = 16;
+            break;
+        case 'o':
+            base = 8;
+            break;
+        case 'b':
+            base = 2;
+            break;
+        case 'p':
+            base = 16;
+            prefix = "0x";
+            break;
+    }
+    char digits[64];
+    char* end = std::to_chars(digits, digits + sizeof(digits), v, base).ptr;
+    if (spec.type == 'X') {
+        for (char* i = digits; i < end; ++i) {
+            *i = toupper(*i);
+        }
+    }
+
+    size_t plen = strlen(prefix);
+    size_t len = plen + (end - digits);
+    size_t pad = spec.width > len ? spec.width - len : 0;
+    if (spec.fill == '0' && spec.align == 0) {
+        // 0填充在符号之后
+        buf.append(prefix, plen);
+        AppendPadding(buf, '0', pad);
+        buf.append(digits, end - digits);
+        return;
+    }
+    if (spec.align != '<') {
+        AppendPadding(buf, spec.fill, pad);
+    }
+    buf.append(prefix, plen);
+    buf.append(digits, end - digits);
+    if (spec.align == '<') {
+        AppendPadding(buf, spec.fill, pad);
+    }
+}
+
+void LogFormat::WriteFloat(LogStreamBuf& buf, const Spec& spec, double v) {
+    // kMaxPrecision位小数加上最大的double整数部分
+    char str[kMaxPrecision + 330];
+    std::to_chars_result r;
+    int precision = spec.precision < 0 ? 6 : spec.precision;
+    switch (spec.type) {
+        case 'f':
+            r = std::to_chars(str, str + sizeof(str), v, std::chars_format::fixed, precision);
+            break;
+        case 'e':
+            r = std::to_chars(str, str + sizeof(str), v, std::chars_format::scientific, precision);
+            break;
+        case 'g':
+            r = std::to_chars(str, str + sizeof(str), v, std::chars_format::general, precision);
+            break;
+        default:
+            if (spec.precision < 0) {
+                r = std::to_chars(str, str + sizeof(str), v);
+            } else {
+                r = std::to_chars(str, str + sizeof(str), v, std::chars_format::general, precision);
+            }
+            break;
+    }
+    if (r.ec != std::errc()) {
+        return;
+    }
+
+    size_t len = r.ptr - str;
+    size_t pad = spec.width > len ? spec.width - len : 0;
+    if (spec.fill == '0' && spec.align == 0 && std::isfinite(v)) {
+        size_t sign = str[0] == '-' ? 1 : 0;
+        buf.append(str, sign);
+        AppendPadding(buf, '0', pad);
+        buf.append(str + sign, len - sign);
+        return;
+    }
+    if (spec.align != '<') {
+        AppendPadding(buf, spec.fill == '0' ? ' ' : spec.fill, pad);
+    }
+    buf.append(str, len);
+    if (spec.align == '<') {
+        AppendPadding(buf, spec.fill == '0' ? ' ' : spec.fill, pad);
+    }
+}
+
+void LogFormat::WriteString(LogStreamBuf& buf, const Spec& spec, const char* data, size_t size) {
+    if (spec.precision >= 0 && (size_t)spec.precision < size) {
+        size = spec.precision;
+    }
+    size_t pad = spec.width > size ? spec.width - size : 0;
+    if (spec.align == '>') {
+        AppendPadding(buf, spec.fill, pad);
+    }
+    buf.append(data, size);
+    if (spec.align != '>') {
+        AppendPadding(buf, spec.fill, pad);
     }
 }
 
@@ -260,13 +669,32 @@ LogEventWrap::LogEventWrap(LogEvent::ptr event)
 }
 
 LogEventWrap::~LogEventWrap() {
-    m_event->getLogger()->log(m_event);
+    Logger* logger = m_event->getLogger();
+    uint64_t suppressed = logger->takeSuppressed();
+    if (m_event->getCallSite()) {
+        suppressed += m_event->getCallSite()->takeSuppressed();
+    }
+    if (suppressed) {
+        m_event->getSS() << " [suppressed " << suppressed << "]";
+    }
+    logger->log(m_event);
+    if (m_event->getLevel() >= LogLevel::FATAL) {
+        RingBufferLogAppender::DumpAll("fatal log");
+    }
 }
 
-std::stringstream& LogEventWrap::getSS() {
+LogStream& LogEventWrap::getSS() {
     return m_event->getSS();
 }
 
+void LogAppender::setLevel(LogLevel::Level level) {
+    m_level.store(level, std::memory_order_relaxed);
+    MutexType::Lock lock(m_mutex);
+    for (auto i : m_loggers) {
+        i->updateEffectiveLevel();
+    }
+}
+
 void LogAppender::setFormatter(LogFormatter::ptr val) {
     MutexType::Lock lock(m_mutex);
     m_formatter = val; 
@@ -280,35 +708,165 @@ LogFormatter::ptr LogAppender::getFormatter() const {
 
 Logger::Logger(const std::string& name) 
     : m_name(name) 
-    , m_level(LogLevel::DEBUG){
+    , m_level(LogLevel::DEBUG)
+    , m_effectiveLevel(LogLevel::DEBUG)
+    , m_ownLevel(LogLevel::DEBUG)
+    , m_appenders(new AppenderList) {
     m_formatter.reset(new LogFormatter("%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n"));
+    updateEffectiveLevel();
 
     // if (name == "root") {
     //     m_appenders.push_back(std::make_shared<StdoutLogAppender>());
     // }
 }
 
+Logger::~Logger() {
+    // 事件只保存Logger裸指针，析构前把异步队列中引用本logger的事件写完
+    flush();
+    if (!m_debugSites.empty()) {
+        LogSiteSwitch::SetRules(this, {});
+    }
+    // 已没有其它引用，不会再有读者
+    const AppenderList* list = m_appenders.load(std::memory_order_relaxed);
+    for (auto& i : *list) {
+        LogAppender::MutexType::Lock lock(i->m_mutex);
+        i->m_loggers.erase(std::find(i->m_loggers.begin(), i->m_loggers.end(), this));
+    }
+    delete list;
+}
+
+// 保护logger之间的父子关系和m_ownLevel
+static LogMutex& HierarchyMutex() {
+    static LogMutex s_mutex;
+    return s_mutex;
+}
+
+// 串行化生效级别的计算，持有期间不再获取其它logger或appender的锁
+static LogMutex& EffectiveMutex() {
+    static LogMutex s_mutex;
+    return s_mutex;
+}
+
+void Logger::updateEffectiveLevel() {
+    LogMutex::Lock lock(EffectiveMutex());
+    updateEffectiveLevelNoLock();
+}
+
+void Logger::updateEffectiveLevelNoLock() {
+    LogLevel::Level level = getLevel();
+    if (!isBinary()) {
+        Epoch::ReadGuard guard;
+        const AppenderList* list = m_appenders.load(std::memory_order_acquire);
+        if (!list->empty()) {
+            LogLevel::Level min = list->front()->getLevel();
+            for (auto& i : *list) {
+                min = std::min(min, i->getLevel());
+            }
+            level = std::max(level, min);
+        } else if (m_root) {
+            level = std::max(level, m_root->getEffectiveLevel());
+        } else {
+            // 没有任何输出
+            level = static_cast<LogLevel::Level>(100);
+        }
+    }
+    m_effectiveLevel.store(level, std::memory_order_relaxed);
+    for (auto i : m_fallbacks) {
+        i->updateEffectiveLevelNoLock();
+    }
+}
+
+void Logger::setLevel(LogLevel::Level level) {
+    LogMutex::Lock lock(HierarchyMutex());
+    m_ownLevel = level;
+    updateLevelNoLock();
+}
+
+void Logger::updateLevelNoLock() {
+    LogLevel::Level level = m_ownLevel;
+    if (level == LogLevel::UNKNOW && m_parent) {
+        level = m_parent->getLevel();
+    }
+    m_level.store(level, std::memory_order_relaxed);
+    updateEffectiveLevel();
+    for (auto i : m_children) {
+        if (i->m_ownLevel == LogLevel::UNKNOW) {
+            i->updateLevelNoLock();
+        }
+    }
+}
+
+const Logger::AppenderList* Logger::setAppendersNoLock(const AppenderList* list) {
+    const AppenderList* old = m_appenders.exchange(list, std::memory_order_acq_rel);
+    for (auto& i : *old) {
+        LogAppender::MutexType::Lock lock(i->m_mutex);
+        i->m_loggers.erase(std::find(i->m_loggers.begin(), i->m_loggers.end(), this));
+    }
+    for (auto& i : *list) {
+        LogAppender::MutexType::Lock lock(i->m_mutex);
+        i->m_loggers.push_back(this);
+    }
+    updateEffectiveLevel();
+    return old;
+}
+
+static void RetireAppenders(const Logger::AppenderList* old) {
+    Epoch::GetInstance()->retire([old](){ delete old; });
+}
+
 void Logger::addAppender(LogAppender::ptr appender) {
-    MutexType::Lock lock(m_mutex);
-    if (!appender->getFormatter()) {
-        appender->setFormatter(m_formatter);
+    const AppenderList* old = nullptr;
+    {
+        MutexType::Lock lock(m_mutex);
+        if (!appender->getFormatter()) {
+            appender->setFormatter(m_formatter);
+        }
+        AppenderList* list = new AppenderList(*m_appenders.load(std::memory_order_relaxed));
+        list->push_back(appender);
+        old = setAppendersNoLock(list);
     }
-    m_appenders.push_back(appender);
+    RetireAppenders(old);
 }
 
+// 事件只保存Logger裸指针，被移除的appender(如异步appender)队列中可能还有本logger的事件，
+// 移除后在锁外写完，之后本logger析构不会留下悬空指针
 void Logger::delAppender(LogAppender::ptr appender) {
-    MutexType::Lock lock(m_mutex);
-    for (auto it = m_appenders.begin();
-            it != m_appenders.end(); ++it) {
-        if (*it == appender) {
-            m_appenders.erase(it);
-            break;
+    const AppenderList* old = nullptr;
+    {
+        MutexType::Lock lock(m_mutex);
+        const AppenderList* cur = m_appenders.load(std::memory_order_relaxed);
+        for (auto it = cur->begin(); it != cur->end(); ++it) {
+            if (*it == appender) {
+                AppenderList* list = new AppenderList(*cur);
+                list->erase(list->begin() + (it - cur->begin()));
+                old = setAppendersNoLock(list);
+                break;
+            }
         }
     }
+    if (old) {
+        appender->flush();
+        RetireAppenders(old);
+    }
 }
 
 void Logger::clearAppenders() {
-    m_appenders.clear();
+    const AppenderList* old = nullptr;
+    {
+        MutexType::Lock lock(m_mutex);
+        old = setAppendersNoLock(new AppenderList);
+    }
+    // 旧表只由本线程交给retire，锁外仍可遍历
+    for (auto& i : *old) {
+        i->flush();
+    }
+    RetireAppenders(old);
+}
+
+std::list<LogAppender::ptr> Logger::getAppenders() const {
+    Epoch::ReadGuard guard;
+    const AppenderList* list = m_appenders.load(std::memory_order_acquire);
+    return std::list<LogAppender::ptr>(list->begin(), list->end());
 }
 
 void Logger::setFormatter(LogFormatter::ptr val) {
@@ -318,7 +876,7 @@ void Logger::setFormatter(LogFormatter::ptr val) {
     
     m_formatter = val;
 
-    for (auto& i : m_appenders) {
+    for (auto& i : *m_appenders.load(std::memory_order_relaxed)) {
         if (!i->hasFormatter()) {
             i->setFormatter(m_formatter);
         }
@@ -326,7 +884,7 @@ void Logger::setFormatter(LogFormatter::ptr val) {
 }
 
 void Logger::setFormatter(const std::string& val) {
-    auto new_val = std::make_shared<LogFormatter>(val);
+    auto new_val = LogFormatter::Create(val);
     if (new_val->isError()) {
         std::cout << "Logger::setFormatter name=" << m_name
                   << " value=" << val << " invalid formatter"
@@ -347,12 +905,22 @@ std::string Logger::toYamlString() const {
     MutexType::Lock lock(m_mutex);
     YAML::Node node;
     node["name"] = m_name;
-    node["level"] = LogLevel::ToString(m_level);
+    node["level"] = LogLevel::ToString(getLevel());
     if (m_formatter) {
         node["formatter"] = m_formatter->getPattern();
     }
+    if (isBinary()) {
+        node["binary"] = BinaryLog::GetInstance()->getFilename();
+    }
+    if (getRateLimit()) {
+        node["rate_limit"] = getRateLimit();
+        node["burst"] = getBurst();
+    }
+    for (auto& i : m_debugSites) {
+        node["debug"].push_back(i.toString());
+    }
 
-    for (auto& i : m_appenders) {
+    for (auto& i : *m_appenders.load(std::memory_order_relaxed)) {
         node["appenders"].push_back(YAML::Load(i->toYamlString()));
     }
 
@@ -361,30 +929,111 @@ std::string Logger::toYamlString() const {
     return ss.str();
 }
 
-void Logger::log(LogEvent::ptr event) {
-    if (event->getLevel() >= m_level) {
+void Logger::setDebugSites(const std::vector<LogSiteRule>& rules) {
+    {
         MutexType::Lock lock(m_mutex);
-        if (!m_appenders.empty()) {
-            for (auto& i : m_appenders) {
-                i->log(event);
-            }
-        } else if (m_root) {
-            m_root->log(event);
-        }
+        m_debugSites = rules;
     }
+    LogSiteSwitch::SetRules(this, rules);
 }
 
-/*
-void Logger::log(LogLevel::Level level, LogEvent::ptr event) {
-    if (level >= m_level) {
-        // auto self = shared_from_this();
-        for (auto& i : m_appenders) {
-            i->log(event);
-        }
-    }
+std::vector<LogSiteRule> Logger::getDebugSites() const {
+    MutexType::Lock lock(m_mutex);
+    return m_debugSites;
 }
 
-void Logger::debug(LogEvent::ptr event) {
+bool Logger::matchDebugSite(const LogEvent& event) const {
+    const LogCallSite* site = event.getCallSite();
+    if (!site) {
+        return false;
+    }
+    MutexType::Lock lock(m_mutex);
+    for (auto& i : m_debugSites) {
+        if (i.match(site->getFile(), site->getLine(), site->getFunction())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Logger::setBinary(bool v) {
+    m_binaryId.store(v ? BinaryLog::GetInstance()->registerLogger(m_name) : 0,
+            std::memory_order_relaxed);
+    updateEffectiveLevel();
+}
+
+void Logger::setRateLimit(uint32_t rate, uint32_t burst) {
+    if (rate && !burst) {
+        burst = rate;
+    }
+    uint64_t interval = rate ? 1000000000ull / rate : 0;
+    m_rate.store(rate, std::memory_order_relaxed);
+    m_burst.store(rate ? burst : 0, std::memory_order_relaxed);
+    m_rateTolerance.store(interval * (burst ? burst - 1 : 0), std::memory_order_relaxed);
+    m_tat.store(0, std::memory_order_relaxed);
+    m_rateInterval.store(interval, std::memory_order_relaxed);
+}
+
+bool Logger::acquireToken() {
+    uint64_t interval = m_rateInterval.load(std::memory_order_relaxed);
+    uint64_t tolerance = m_rateTolerance.load(std::memory_order_relaxed);
+    uint64_t now = GetMonotonicNS();
+    uint64_t tat = m_tat.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t base = tat > now ? tat : now;
+        if (base - now > tolerance) {
+            m_suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (m_tat.compare_exchange_weak(tat, base + interval, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+void Logger::flush() {
+    if (isBinary()) {
+        BinaryLog::GetInstance()->flush();
+    }
+    Epoch::ReadGuard guard;
+    const AppenderList* list = m_appenders.load(std::memory_order_acquire);
+    if (!list->empty()) {
+        for (auto& i : *list) {
+            i->flush();
+        }
+    } else if (m_root) {
+        m_root->flush();
+    }
+}
+
+void Logger::log(LogEvent::ptr event) {
+    // 调用点开关放行的事件须匹配本logger的规则，从其它logger转发到root的已判断过
+    if (event->isForced()
+            ? event->getLogger() != this || matchDebugSite(*event)
+            : event->getLevel() >= getLevel()) {
+        Epoch::ReadGuard guard;
+        const AppenderList* list = m_appenders.load(std::memory_order_acquire);
+        if (!list->empty()) {
+            for (auto& i : *list) {
+                i->log(event);
+            }
+        } else if (m_root) {
+            m_root->log(event);
+        }
+    }
+}
+
+/*
+void Logger::log(LogLevel::Level level, LogEvent::ptr event) {
+    if (level >= m_level) {
+        // auto self = shared_from_this();
+        for (auto& i : m_appenders) {
+            i->log(event);
+        }
+    }
+}
+
+void Logger::debug(LogEvent::ptr event) {
     log(LogLevel::DEBUG, event);
 }
 
@@ -406,9 +1055,10 @@ void Logger::fatal(LogEvent::ptr event) {
 */
 
 void StdoutLogAppender::log(LogEvent::ptr event)  {
-    if (event->getLevel() >= m_level) {
+    if (accept(*event)) {
         MutexType::Lock lock(m_mutex);
-        std::cout << m_formatter->format(event);
+        const std::string& str = event->getFormatted(*m_formatter, m_buffer);
+        std::cout.write(str.data(), str.size());
     }
 }
 
@@ -426,18 +1076,115 @@ std::string StdoutLogAppender::toYamlString() const {
     return ss.str();
 }
 
+// 日志定时器，一个后台线程约每100ms回调已注册appender的onTimer
+// 故意不析构：退出时全局对象析构顺序不确定，appender可能在它之后注销
+class LogTimer {
+public:
+    static LogTimer* GetInstance() {
+        static LogTimer* s_timer = new LogTimer;
+        return s_timer;
+    }
+
+    void add(LogAppender* appender) {
+        Mutex::Lock lock(m_mutex);
+        m_appenders.insert(appender);
+        if (!m_thread) {
+            m_thread.reset(new Thread(std::bind(&LogTimer::run, this), "log_timer"));
+        }
+    }
+
+    void del(LogAppender* appender) {
+        // 持有m_mutex时定时线程不会正在回调该appender
+        Mutex::Lock lock(m_mutex);
+        m_appenders.erase(appender);
+    }
+
+private:
+    void run() {
+        while (true) {
+            ::usleep(100 * 1000);
+            uint64_t now = GetMonotonicMS();
+            Mutex::Lock lock(m_mutex);
+            for (auto& i : m_appenders) {
+                i->onTimer(now);
+            }
+        }
+    }
+
+private:
+    Mutex m_mutex;
+    std::set<LogAppender*> m_appenders;
+    Thread::ptr m_thread;
+};
+
+void LogAppender::AddTimer(LogAppender* appender) {
+    LogTimer::GetInstance()->add(appender);
+}
+
+void LogAppender::DelTimer(LogAppender* appender) {
+    LogTimer::GetInstance()->del(appender);
+}
+
+static bool WriteAll(int fd, const char* data, size_t len) {
+    while (len) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// SIGHUP计数，FileLogAppender发现与自己记录的不同就重新打开文件
+static std::atomic<uint64_t> s_reopen_gen {0};
+static struct sigaction s_old_sighup;
+
+static void SighupHandler(int sig, siginfo_t* info, void* ctx) {
+    s_reopen_gen.fetch_add(1, std::memory_order_relaxed);
+    if (s_old_sighup.sa_flags & SA_SIGINFO) {
+        if (s_old_sighup.sa_sigaction) {
+            s_old_sighup.sa_sigaction(sig, info, ctx);
+        }
+    } else if (s_old_sighup.sa_handler != SIG_DFL && s_old_sighup.sa_handler != SIG_IGN) {
+        s_old_sighup.sa_handler(sig);
+    }
+}
+
+void FileLogAppender::InstallSighupHandler() {
+    static bool s_installed = [](){
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = &SighupHandler;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        return sigaction(SIGHUP, &sa, &s_old_sighup) == 0;
+    }();
+    if (!s_installed) {
+        std::cout << "FileLogAppender install SIGHUP handler failed" << std::endl;
+    }
+}
+
 FileLogAppender::FileLogAppender(const std::string& filename) 
-    :m_filename(filename), m_lastTime(time(0)) {
+    :m_filename(filename) {
+    m_writeBuf.reserve(m_bufferSize);
+    m_reopenGen = s_reopen_gen.load(std::memory_order_relaxed);
+    m_lastFlush = GetMonotonicMS();
 
     if (
 #ifdef SYLAR_LOG_FILE_APPEND
-        !reopen(std::ios::app)
+        !reopen(true)
 #else
-        !reopen(std::ios::out)
+        !reopen(false)
 #endif // SYLAR_LOG_FILE_APPEND
         ) {
         std::cout << "open log file failed:" << filename << std::endl;
     }
+    AddTimer(this);
 }
 
 std::string FileLogAppender::toYamlString() const {
@@ -450,52 +1197,958 @@ std::string FileLogAppender::toYamlString() const {
     if (m_formatter) {
         node["formatter"] = m_formatter->getPattern();
     }
+    if (m_bufferSize != kDefaultBufferSize)
+        node["buffer_size"] = m_bufferSize;
+    if (m_flushInterval != kDefaultFlushInterval)
+        node["flush_interval"] = m_flushInterval;
+    if (m_maxSize)
+        node["max_size"] = m_maxSize;
+    if (m_rotateType != RotateType::NONE)
+        node["rotate"] = RotateTypeToString(m_rotateType);
+    if (m_maxFiles)
+        node["max_files"] = m_maxFiles;
+    if (m_indexInterval)
+        node["index_interval"] = m_indexInterval;
     std::stringstream ss;
     ss << node;
     return ss.str();
 }
 
-FileLogAppender::~FileLogAppender() {
-    m_filestream.close();
+FileLogAppender::~FileLogAppender() {
+    DelTimer(this);
+    MutexType::Lock lock(m_mutex);
+    flushNoLock();
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    closeIndexNoLock();
+}
+
+bool FileLogAppender::reopen(bool append) {
+    MutexType::Lock lock(m_mutex);
+    flushNoLock();
+    return reopenNoLock(append);
+}
+
+bool FileLogAppender::reopenNoLock(bool append) {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+
+    int flags = O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC;
+    if (!append) {
+        flags |= O_TRUNC;
+    }
+    m_fd = ::open(m_filename.c_str(), flags, 0644);
+    if (m_fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    m_fileSize = (fstat(m_fd, &st) == 0 ? st.st_size : 0) + m_writeBuf.size();
+    if (m_indexInterval && !openIndexNoLock(!append)) {
+        std::cout << "open log index failed:" << FileLogIndex::IndexFile(m_filename) << std::endl;
+    }
+    return true;
+}
+
+bool FileLogAppender::openIndexNoLock(bool truncate) {
+    closeIndexNoLock();
+    int flags = O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC;
+    if (truncate) {
+        flags |= O_TRUNC;
+    }
+    int fd = ::open(FileLogIndex::IndexFile(m_filename).c_str(), flags, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    uint64_t data_size = m_fileSize - m_writeBuf.size();
+    struct stat st;
+    uint64_t size = fstat(fd, &st) == 0 ? st.st_size : 0;
+    uint64_t head[2] = {0, 0};
+    FileLogIndex::Entry last = {0, 0};
+    bool has_last = false;
+    bool ok = true;
+    if (size >= sizeof(head) && ::pread(fd, head, sizeof(head), 0) == (ssize_t)sizeof(head)
+            && head[0] == FileLogIndex::kMagic) {
+        // 截掉崩溃时写了一半的条目
+        uint64_t n = (size - sizeof(head)) / FileLogIndex::kEntrySize;
+        uint64_t valid = sizeof(head) + n * FileLogIndex::kEntrySize;
+        if (n && ::pread(fd, &last, sizeof(last), valid - FileLogIndex::kEntrySize) == (ssize_t)sizeof(last)) {
+            has_last = true;
+        }
+        // 日志文件被截断、重建或被外部替换过，旧条目都已失效
+        if (has_last && (last.offset > data_size || !data_size)) {
+            has_last = false;
+            valid = sizeof(head);
+        }
+        if (valid != size) {
+            ok = ftruncate(fd, valid) == 0;
+        }
+    } else {
+        head[0] = FileLogIndex::kMagic;
+        head[1] = m_indexInterval;
+        ok = ftruncate(fd, 0) == 0 && WriteAll(fd, (const char*)head, sizeof(head));
+    }
+    if (!ok) {
+        ::close(fd);
+        return false;
+    }
+
+    m_indexFd = fd;
+    m_nextIndex = has_last ? last.offset + m_indexInterval : data_size;
+    m_lastIndexTime = has_last ? last.time_ms : 0;
+    return true;
+}
+
+void FileLogAppender::closeIndexNoLock() {
+    if (m_indexFd >= 0) {
+        ::close(m_indexFd);
+        m_indexFd = -1;
+    }
+    m_indexBuf.clear();
+}
+
+void FileLogAppender::setIndexInterval(uint64_t v) {
+    MutexType::Lock lock(m_mutex);
+    flushNoLock();
+    m_indexInterval = v;
+    if (!v) {
+        closeIndexNoLock();
+    } else if (m_indexFd < 0 && m_fd >= 0) {
+        if (!openIndexNoLock(false)) {
+            std::cout << "open log index failed:" << FileLogIndex::IndexFile(m_filename) << std::endl;
+        }
+    }
+}
+
+bool FileLogIndex::Load(const std::string& filename, std::vector<Entry>& entries, uint64_t max_size) {
+    entries.clear();
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        return false;
+    }
+    uint64_t size = std::min((uint64_t)st.st_size, max_size);
+    int fd = ::open(IndexFile(filename).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    std::string buf;
+    char tmp[64 * 1024];
+    ssize_t n = 0;
+    while ((n = ::read(fd, tmp, sizeof(tmp))) > 0) {
+        buf.append(tmp, n);
+    }
+    ::close(fd);
+    uint64_t magic = 0;
+    if (n < 0 || buf.size() < 2 * sizeof(uint64_t)) {
+        return false;
+    }
+    memcpy(&magic, buf.data(), sizeof(magic));
+    if (magic != kMagic) {
+        return false;
+    }
+
+    for (size_t pos = 2 * sizeof(uint64_t); pos + kEntrySize <= buf.size(); pos += kEntrySize) {
+        Entry e;
+        memcpy(&e, buf.data() + pos, sizeof(e));
+        if (e.offset > size || (!entries.empty()
+                    && (e.offset < entries.back().offset || e.time_ms < entries.back().time_ms))) {
+            break;
+        }
+        entries.push_back(e);
+    }
+    return true;
+}
+
+void FileLogAppender::setBufferSize(size_t v) {
+    MutexType::Lock lock(m_mutex);
+    flushNoLock();
+    m_bufferSize = v;
+    std::string buf;
+    buf.reserve(v);
+    m_writeBuf.swap(buf);
+}
+
+void FileLogAppender::setFlushInterval(uint64_t ms) {
+    MutexType::Lock lock(m_mutex);
+    m_flushInterval = ms;
+}
+
+void FileLogAppender::setMaxSize(uint64_t v) {
+    MutexType::Lock lock(m_mutex);
+    m_maxSize = v;
+}
+
+void FileLogAppender::setMaxFiles(uint32_t v) {
+    MutexType::Lock lock(m_mutex);
+    m_maxFiles = v;
+}
+
+void FileLogAppender::setRotateType(RotateType v) {
+    MutexType::Lock lock(m_mutex);
+    m_rotateType = v;
+    if (v == RotateType::NONE) {
+        m_nextRotate = 0;
+        return;
+    }
+
+    // 以文件最后修改时间为起点，重启时上个周期留下的文件会在下次写入时轮转
+    uint64_t start = time(0);
+    struct stat st;
+    if (m_fileSize && stat(m_filename.c_str(), &st) == 0) {
+        start = st.st_mtime;
+    }
+    m_nextRotate = nextRotateTime(start);
+}
+
+uint64_t FileLogAppender::nextRotateTime(uint64_t now_sec) const {
+    struct tm tm;
+    time_t t = now_sec;
+    localtime_r(&t, &tm);
+    tm.tm_sec = 0;
+    tm.tm_min = 0;
+    if (m_rotateType == RotateType::HOURLY) {
+        tm.tm_hour += 1;
+    } else {
+        tm.tm_hour = 0;
+        tm.tm_mday += 1;
+    }
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+void FileLogAppender::flush() {
+    MutexType::Lock lock(m_mutex);
+    flushNoLock();
+}
+
+void FileLogAppender::flushNoLock() {
+    if (!m_writeBuf.empty()) {
+        if (m_fd >= 0) {
+            WriteAll(m_fd, m_writeBuf.data(), m_writeBuf.size());
+        }
+        m_writeBuf.clear();
+    }
+    // 索引条目在数据之后写出
+    if (!m_indexBuf.empty()) {
+        if (m_indexFd >= 0) {
+            WriteAll(m_indexFd, m_indexBuf.data(), m_indexBuf.size());
+        }
+        m_indexBuf.clear();
+    }
+    m_lastFlush = GetMonotonicMS();
+}
+
+void FileLogAppender::writeNoLock(const char* data, size_t len) {
+    m_fileSize += len;
+    if (m_writeBuf.size() + len > m_bufferSize) {
+        flushNoLock();
+    }
+
+    if (len >= m_bufferSize) {
+        if (m_fd >= 0) {
+            WriteAll(m_fd, data, len);
+        }
+    } else {
+        m_writeBuf.append(data, len);
+    }
+}
+
+void FileLogAppender::rotateNoLock(uint64_t now_sec) {
+    flushNoLock();
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+
+    closeIndexNoLock();
+
+    auto name = [this](uint32_t n) {
+        return m_filename + "." + std::to_string(n);
+    };
+    auto index = [&name](uint32_t n) {
+        return FileLogIndex::IndexFile(name(n));
+    };
+
+    uint32_t last = m_maxFiles;
+    if (last) {
+        ::unlink(name(last).c_str());
+        ::unlink(index(last).c_str());
+    } else {
+        // 全部保留，找到第一个不存在的序号
+        last = 1;
+        while (::access(name(last).c_str(), F_OK) == 0) {
+            ++last;
+        }
+    }
+
+    for (uint32_t i = last; i > 1; --i) {
+        ::rename(name(i - 1).c_str(), name(i).c_str());
+        ::rename(index(i - 1).c_str(), index(i).c_str());
+    }
+    ::rename(m_filename.c_str(), name(1).c_str());
+    ::rename(FileLogIndex::IndexFile(m_filename).c_str(), index(1).c_str());
+
+    reopenNoLock(true);
+    if (m_rotateType != RotateType::NONE) {
+        m_nextRotate = nextRotateTime(now_sec);
+    }
+}
+
+void FileLogAppender::checkReopenNoLock() {
+    uint64_t gen = s_reopen_gen.load(std::memory_order_relaxed);
+    if (gen != m_reopenGen) {
+        m_reopenGen = gen;
+        flushNoLock();
+        reopenNoLock(true);
+    }
+}
+
+void FileLogAppender::log(LogEvent::ptr event)  {
+    if (accept(*event)) {
+        MutexType::Lock lock(m_mutex);
+        checkReopenNoLock();
+
+        const std::string& str = event->getFormatted(*m_formatter, m_buffer);
+        uint64_t sec = event->getTime();
+        if (m_nextRotate && sec >= m_nextRotate) {
+            rotateNoLock(sec);
+        } else if (m_maxSize && m_fileSize && m_fileSize + str.size() > m_maxSize) {
+            rotateNoLock(sec);
+        }
+
+        // 条目在记录进入缓冲(或已写出)后才加入，writeNoLock中的flush不会先于数据写出它
+        uint64_t offset = m_fileSize;
+        writeNoLock(str.data(), str.size());
+        if (m_indexFd >= 0 && offset >= m_nextIndex) {
+            FileLogIndex::Entry e;
+            e.time_ms = std::max(event->getTimeNs() / 1000000, m_lastIndexTime);
+            e.offset = offset;
+            m_indexBuf.append((const char*)&e, sizeof(e));
+            m_nextIndex = offset + m_indexInterval;
+            m_lastIndexTime = e.time_ms;
+        }
+
+        // ERROR及以上立即写出，避免随后崩溃丢失
+        if (event->getLevel() >= LogLevel::ERROR 
+                || GetMonotonicMS() >= m_lastFlush + m_flushInterval) {
+            flushNoLock();
+        }
+    }
+}
+
+void FileLogAppender::onTimer(uint64_t now_ms) {
+    MutexType::Lock lock(m_mutex);
+    checkReopenNoLock();
+    if (!m_writeBuf.empty() && now_ms >= m_lastFlush + m_flushInterval) {
+        flushNoLock();
+    }
+}
+
+FileLogAppender::RotateType FileLogAppender::StringToRotateType(const std::string& str) {
+    std::string ucstr = str;
+    std::transform(ucstr.begin(), ucstr.end(), ucstr.begin(), ::toupper);
+    if (ucstr == "HOURLY") {
+        return RotateType::HOURLY;
+    } else if (ucstr == "DAILY") {
+        return RotateType::DAILY;
+    }
+    return RotateType::NONE;
+}
+
+const char* FileLogAppender::RotateTypeToString(RotateType type) {
+    switch (type) {
+        case RotateType::HOURLY:
+            return "hourly";
+        case RotateType::DAILY:
+            return "daily";
+        case RotateType::NONE:
+        default:
+            return "none";
+    }
+}
+
+// 读取末尾trailer并截断到已提交长度；没有trailer的视为普通文本文件，原样保留
+static int64_t RecoverMmapFile(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return -1;
+    }
+    uint64_t size = st.st_size;
+    if (size < MmapFileLogAppender::kTrailerSize) {
+        return size;
+    }
+
+    uint64_t trailer[2];
+    if (::pread(fd, trailer, sizeof(trailer), size - sizeof(trailer)) != (ssize_t)sizeof(trailer)) {
+        return -1;
+    }
+    if (trailer[0] != MmapFileLogAppender::kTrailerMagic
+            || trailer[1] > size - sizeof(trailer)) {
+        return size;
+    }
+    if (ftruncate(fd, trailer[1]) != 0) {
+        return -1;
+    }
+    return trailer[1];
+}
+
+int64_t MmapFileLogAppender::Recover(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    int64_t rt = RecoverMmapFile(fd);
+    ::close(fd);
+    return rt;
+}
+
+MmapFileLogAppender::MmapFileLogAppender(const std::string& filename, size_t segment_size)
+    :m_filename(filename)
+    ,m_segmentSize(segment_size) {
+    long page = sysconf(_SC_PAGESIZE);
+    // 段大小取页的整数倍
+    if (m_segmentSize < (size_t)page) {
+        m_segmentSize = page;
+    }
+    m_segmentSize = (m_segmentSize + page - 1) & ~(page - 1);
+
+    if (!openNoLock()) {
+        std::cout << "open log file failed:" << filename << std::endl;
+        closeNoLock();
+    }
+}
+
+MmapFileLogAppender::~MmapFileLogAppender() {
+    MutexType::Lock lock(m_mutex);
+    closeNoLock();
+}
+
+bool MmapFileLogAppender::openNoLock() {
+    m_fd = ::open(m_filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        return false;
+    }
+
+    int64_t len = RecoverMmapFile(m_fd);
+    if (len < 0) {
+        return false;
+    }
+#ifndef SYLAR_LOG_FILE_APPEND
+    if (ftruncate(m_fd, 0) != 0) {
+        return false;
+    }
+    len = 0;
+#endif // SYLAR_LOG_FILE_APPEND
+
+    m_committed = len;
+    m_fileSize = len;
+    return growNoLock(0);
+}
+
+void MmapFileLogAppender::closeNoLock() {
+    if (m_map) {
+        munmap(m_map, m_mapSize);
+        m_map = nullptr;
+    }
+    if (m_fd >= 0) {
+        // 去掉预分配部分和trailer
+        if (ftruncate(m_fd, m_committed) != 0) {
+            std::cout << "truncate log file failed:" << m_filename << std::endl;
+        }
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool MmapFileLogAppender::growNoLock(size_t len) {
+    uint64_t need = m_committed + len + kTrailerSize;
+    if (m_map && need <= m_fileSize) {
+        return true;
+    }
+    if (m_fd < 0) {
+        return false;
+    }
+
+    uint64_t size = m_fileSize + m_segmentSize;
+    if (size < need) {
+        size = (need + m_segmentSize - 1) / m_segmentSize * m_segmentSize;
+    }
+
+    // 先用pwrite在新的末尾写trailer(同时把文件扩展到新大小)，再预分配中间部分；
+    // 写入失败或预分配失败时截回原大小，原末尾的trailer还没有清除，
+    // 因此崩溃或出错后文件末尾总是一个有效的trailer
+    uint64_t trailer[2] = {kTrailerMagic, m_committed};
+    if (::pwrite(m_fd, trailer, sizeof(trailer), size - sizeof(trailer)) != (ssize_t)sizeof(trailer)) {
+        if (ftruncate(m_fd, m_fileSize) != 0) {
+            std::cout << "truncate log file failed:" << m_filename << std::endl;
+        }
+        return false;
+    }
+    // 不支持fallocate时保留稀疏文件
+    int rt = ::fallocate(m_fd, 0, m_fileSize, size - kTrailerSize - m_fileSize);
+    if (rt != 0 && errno != EOPNOTSUPP && errno != ENOSYS) {
+        if (ftruncate(m_fd, m_fileSize) != 0) {
+            std::cout << "truncate log file failed:" << m_filename << std::endl;
+        }
+        return false;
+    }
+    if (m_map) {
+        memset(m_map + (m_fileSize - kTrailerSize - m_mapOffset), 0, kTrailerSize);
+        munmap(m_map, m_mapSize);
+        m_map = nullptr;
+    }
+
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    m_fileSize = size;
+    m_mapOffset = m_committed & ~(page - 1);
+    m_mapSize = size - m_mapOffset;
+    void* addr = mmap(nullptr, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, m_mapOffset);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    m_map = (char*)addr;
+    return true;
+}
+
+void MmapFileLogAppender::writeTrailerNoLock() {
+    uint64_t trailer[2] = {kTrailerMagic, m_committed};
+    memcpy(m_map + (m_fileSize - kTrailerSize - m_mapOffset), trailer, sizeof(trailer));
+}
+
+void MmapFileLogAppender::log(LogEvent::ptr event) {
+    if (accept(*event)) {
+        MutexType::Lock lock(m_mutex);
+        const std::string& str = event->getFormatted(*m_formatter, m_buffer);
+        if (!growNoLock(str.size())) {
+            return;
+        }
+        memcpy(m_map + (m_committed - m_mapOffset), str.data(), str.size());
+        m_committed += str.size();
+        writeTrailerNoLock();
+    }
+}
+
+void MmapFileLogAppender::flush() {
+    MutexType::Lock lock(m_mutex);
+    if (m_map) {
+        msync(m_map, m_mapSize, MS_ASYNC);
+    }
+}
+
+std::string MmapFileLogAppender::toYamlString() const {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "MmapFileLogAppender";
+    if (m_level != LogLevel::Level::UNKNOW)
+        node["level"] = LogLevel::ToString(m_level);
+    node["file"] = m_filename;
+    if (m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    if (m_segmentSize != kDefaultSegmentSize)
+        node["segment_size"] = m_segmentSize;
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+struct AsyncLogAppender::Context {
+    Context(size_t capacity, LogAppender::ptr s)
+        : queue(capacity), sink(s) {}
+
+    BoundedQueue<LogEvent::ptr> queue;
+    LogAppender::ptr sink;
+    std::atomic<uint64_t> done {0};     // 已出队并处理完的事件数(含drop_oldest丢弃的)
+    std::atomic<uint64_t> dropped {0};
+    std::atomic<bool> waiting {false};  // 后台线程是否准备睡眠
+    std::atomic<bool> stopping {false};
+    Semaphore sem;
+};
+
+AsyncLogAppender::AsyncLogAppender(LogAppender::ptr sink, size_t capacity, OverflowPolicy policy) 
+    : m_sink(sink), m_policy(policy) {
+    if (!capacity) {
+        capacity = 8192;
+    }
+    m_ctx = std::make_shared<Context>(capacity, sink);
+    m_thread = std::make_shared<Thread>(std::bind(&AsyncLogAppender::Run, m_ctx), "async_log");
+}
+
+AsyncLogAppender::~AsyncLogAppender() {
+    m_ctx->stopping.store(true);
+    wakeup();
+    // 最后一个引用可能在后台线程上释放，此时不能join自己
+    if (Thread::GetThis() != m_thread.get()) {
+        m_thread->join();
+    }
+}
+
+void AsyncLogAppender::Run(std::shared_ptr<Context> ctx) {
+    LogEvent::ptr event;
+    while (true) {
+        while (ctx->queue.tryPop(event)) {
+            ctx->sink->log(event);
+            event.reset();
+            ctx->done.fetch_add(1, std::memory_order_release);
+        }
+
+        if (ctx->stopping.load() && ctx->queue.empty()) {
+            break;
+        }
+
+        // 先声明要睡眠，再检查一次队列，避免和生产者的wakeup错过
+        ctx->waiting.store(true);
+        if (!ctx->queue.empty() || ctx->stopping.load()) {
+            if (ctx->waiting.exchange(false)) {
+                continue;
+            }
+            // 生产者已经抢先清除了waiting，必然会notify，需要消耗掉这次notify
+        }
+        ctx->sem.wait();
+    }
+    ctx->sink->flush();
+}
+
+void AsyncLogAppender::wakeup() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_ctx->waiting.load(std::memory_order_relaxed)
+            && m_ctx->waiting.exchange(false)) {
+        m_ctx->sem.notify();
+    }
+}
+
+void AsyncLogAppender::log(LogEvent::ptr event) {
+    if (!accept(*event)) {
+        return;
+    }
+
+    // 入队后由后台线程读取，此后不能再写事件的格式化缓存
+    event->setShared();
+    Context& ctx = *m_ctx;
+    while (!ctx.queue.tryPush(event)) {
+        switch (m_policy) {
+            case OverflowPolicy::DROP_NEWEST:
+                ctx.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            case OverflowPolicy::DROP_OLDEST: {
+                LogEvent::ptr old;
+                if (ctx.queue.tryPop(old)) {
+                    ctx.dropped.fetch_add(1, std::memory_order_relaxed);
+                    ctx.done.fetch_add(1, std::memory_order_release);
+                }
+                break;
+            }
+            case OverflowPolicy::BLOCK:
+            default:
+                wakeup();
+                sched_yield();
+                break;
+        }
+    }
+    wakeup();
+}
+
+void AsyncLogAppender::flush() {
+    uint64_t target = m_ctx->queue.enqueued();
+    while (m_ctx->done.load(std::memory_order_acquire) < target) {
+        wakeup();
+        ::usleep(100);
+    }
+    m_sink->flush();
+}
+
+void AsyncLogAppender::setFormatter(LogFormatter::ptr val) {
+    LogAppender::setFormatter(val);
+    m_sink->setFormatter(val);
+}
+
+size_t AsyncLogAppender::getCapacity() const {
+    return m_ctx->queue.capacity();
+}
+
+uint64_t AsyncLogAppender::getDropped() const {
+    return m_ctx->dropped.load(std::memory_order_relaxed);
+}
+
+std::string AsyncLogAppender::toYamlString() const {
+    YAML::Node sink = YAML::Load(m_sink->toYamlString());
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "AsyncLogAppender";
+    node["sink"] = sink["type"];
+    if (sink["file"].IsDefined()) {
+        node["file"] = sink["file"];
+    }
+    node["capacity"] = getCapacity();
+    node["overflow"] = PolicyToString(m_policy);
+    if (m_level != LogLevel::Level::UNKNOW)
+        node["level"] = LogLevel::ToString(m_level);
+    if (m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+AsyncLogAppender::OverflowPolicy AsyncLogAppender::StringToPolicy(const std::string& str) {
+    std::string ucstr = str;
+    std::transform(ucstr.begin(), ucstr.end(), ucstr.begin(), ::toupper);
+    if (ucstr == "DROP_NEWEST") {
+        return OverflowPolicy::DROP_NEWEST;
+    } else if (ucstr == "DROP_OLDEST") {
+        return OverflowPolicy::DROP_OLDEST;
+    }
+    return OverflowPolicy::BLOCK;
+}
+
+const char* AsyncLogAppender::PolicyToString(OverflowPolicy policy) {
+    switch (policy) {
+        case OverflowPolicy::DROP_NEWEST:
+            return "drop_newest";
+        case OverflowPolicy::DROP_OLDEST:
+            return "drop_oldest";
+        case OverflowPolicy::BLOCK:
+        default:
+            return "block";
+    }
+}
+
+static std::atomic<uint64_t> s_formatter_id {0};
+
+LogFormatter::LogFormatter(const std::string& pattern) 
+    : m_pattern(pattern), m_id(++s_formatter_id) {
+    init();
+}
+
+LogFormatter::ptr LogFormatter::Create(const std::string& pattern) {
+    if (pattern == "json") {
+        return std::make_shared<JsonLogFormatter>();
+    }
+    return std::make_shared<LogFormatter>(pattern);
 }
 
-bool FileLogAppender::reopen(std::ios::openmode openmode/*=std::ios::out*/) {
-    MutexType::Lock lock(m_mutex);
-    if (m_filestream) {
-        m_filestream.close();
+// 每线程的日期缓存，秒数不变时直接复用上次strftime的结果
+struct DateTimeCache {
+    uint64_t key = 0;   // formatter id和op下标
+    int64_t sec = -1;
+    size_t len = 0;
+    char buf[64];
+};
+
+static const size_t s_date_cache_size = 8;
+static thread_local DateTimeCache t_date_cache[s_date_cache_size];
+
+void LogFormatter::appendDateTime(std::string& out, const Op& op, size_t index, uint64_t ns) const {
+    uint64_t key = (m_id << 8) | (index & 0xff);
+    int64_t sec = ns / 1000000000ull;
+    DateTimeCache& c = t_date_cache[(m_id * 7 + index) % s_date_cache_size];
+    if (c.key != key || c.sec != sec) {
+        struct tm tm;
+        time_t t = sec;
+        localtime_r(&t, &tm);
+        c.len = strftime(c.buf, sizeof(c.buf), op.arg.c_str(), &tm);
+        c.key = key;
+        c.sec = sec;
     }
+    out.append(c.buf, c.len);
 
-    m_filestream.open(m_filename, openmode);
-    // m_filestream.open(m_filename);
-    return !!m_filestream;
+    if (op.num) {
+        // 秒以下部分，按位数截断并补零
+        uint32_t frac = ns % 1000000000ull;
+        for (uint32_t i = op.num; i < 9; ++i) {
+            frac /= 10;
+        }
+        char buf[10];
+        buf[0] = '.';
+        for (uint32_t i = op.num; i > 0; --i) {
+            buf[i] = '0' + frac % 10;
+            frac /= 10;
+        }
+        out.append(buf, op.num + 1);
+    }
 }
 
-void FileLogAppender::log(LogEvent::ptr event)  {
-    if (event->getLevel() >= m_level) {
-        uint64_t now = time(0);
-        if (now != m_lastTime) {
-            reopen(std::ios::app); //每隔一秒重新打开，app方式
-            m_lastTime = now;
-        }
+std::string LogFormatter::format(LogEvent::ptr event) {
+    std::string out;
+    format(*event, out);
+    return out;
+}
 
-        MutexType::Lock lock(m_mutex);
-        m_filestream << m_formatter->format(event);
-        m_filestream.flush();
+void LogFormatter::format(const LogEvent& event, std::string& out) const {
+    for (auto& op : m_ops) {
+        switch (op.code) {
+            case OpCode::LITERAL:
+#ifdef TEST_LOG_MUTEX_USLEEP
+                // sleep here to test mutex
+                ::usleep(10000);
+#endif // TEST_LOG_MUTEX_USLEEP
+                out.append(op.arg);
+                break;
+            case OpCode::MESSAGE:
+#ifdef TEST_LOG_MUTEX_USLEEP
+                // sleep here to test mutex
+                ::usleep(1000);
+#endif // TEST_LOG_MUTEX_USLEEP
+                out.append(event.getContentData(), event.getContentSize());
+                break;
+            case OpCode::LEVEL:
+                out.append(LogLevel::ToString(event.getLevel()));
+                break;
+            case OpCode::COLOR_LEVEL: {
+                auto level = event.getLevel();
+                out.append(level >= LogLevel::DEBUG && level <= LogLevel::FATAL 
+                        ? s_stdout_colors[level] : s_stdout_colors[0]);
+                out.append(LogLevel::ToString(level));
+                out.append(stdout_clearfmt);
+                break;
+            }
+            case OpCode::ELAPSE:
+                AppendUInt(out, event.getElapse());
+                break;
+            case OpCode::NAME:
+                out.append(event.getLogger()->getName());
+                break;
+            case OpCode::THREAD_ID:
+                AppendUInt(out, event.getThreadId());
+                break;
+            case OpCode::FIBER_ID:
+                AppendUInt(out, event.getFiberId());
+                break;
+            case OpCode::THREAD_NAME:
+                out.append(event.getThreadName());
+                break;
+            case OpCode::DATETIME:
+                appendDateTime(out, op, (&op - m_ops.data()), event.getTimeNs());
+                break;
+            case OpCode::FILENAME:
+                out.append(event.getFile());
+                break;
+            case OpCode::FILENAME_SHORT:
+                if (event.getCallSite()) {
+                    out.append(event.getCallSite()->getShortFile());
+                } else {
+                    out.append(LogCallSite::ShortFilename(event.getFile()));
+                }
+                break;
+            case OpCode::FILENAME_RELATIVE:
+                if (event.getCallSite()) {
+                    out.append(event.getCallSite()->getRelativeFile());
+                } else {
+                    out.append(LogCallSite::RelativeFilename(event.getFile()));
+                }
+                break;
+            case OpCode::LINE:
+                AppendInt(out, event.getLine());
+                break;
+            case OpCode::FIELDS:
+                for (size_t i = 0; i < event.getFieldCount(); ++i) {
+                    const LogField& field = event.getField(i);
+                    out.push_back(' ');
+                    out.append(field.key);
+                    out.push_back('=');
+                    AppendFieldValue(out, event, field, false);
+                }
+                break;
+        }
     }
 }
 
-LogFormatter::LogFormatter(const std::string& pattern) 
-    : m_pattern(pattern) {
-    init();
+// pattern只用于toYamlString，不参与格式化
+JsonLogFormatter::JsonLogFormatter()
+    : LogFormatter("json")
+    , m_time{OpCode::DATETIME, "%Y-%m-%d %H:%M:%S", 3} {
 }
 
-std::string LogFormatter::format(LogEvent::ptr event) {
-    std::stringstream ss;
-    for (auto& item : m_items) {
-        item->format(ss, event);
+static const char s_hex_digits[] = "0123456789abcdef";
+
+void JsonLogFormatter::AppendEscaped(std::string& out, const char* data, size_t size) {
+    const char* p = data;
+    const char* end = data + size;
+    while (p < end) {
+        // 找到下一个需要转义的字符，之前的部分整段拷贝
+        const char* q = p;
+#ifdef __SSE2__
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i ctrl = _mm_set1_epi8(0x1f);
+        while (end - q >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)q);
+            // 无符号 v <= 0x1f 等价于 max(v, 0x1f) == 0x1f
+            __m128i m = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                    _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl));
+            int mask = _mm_movemask_epi8(m);
+            if (mask) {
+                q += __builtin_ctz(mask);
+                break;
+            }
+            q += 16;
+        }
+#endif
+        while (q < end && (uint8_t)*q >= 0x20 && *q != '"' && *q != '\\') {
+            ++q;
+        }
+        out.append(p, q - p);
+        if (q == end) {
+            break;
+        }
+
+        switch (*q) {
+            case '"': out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\n': out.append("\\n"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+            case '\b': out.append("\\b"); break;
+            case '\f': out.append("\\f"); break;
+            default: {
+                char buf[6] = {'\\', 'u', '0', '0',
+                    s_hex_digits[(uint8_t)*q >> 4], s_hex_digits[*q & 0xf]};
+                out.append(buf, sizeof(buf));
+                break;
+            }
+        }
+        p = q + 1;
     }
+}
 
-    return ss.str();
+void JsonLogFormatter::format(const LogEvent& event, std::string& out) const {
+    out.append("{\"time\":\"");
+    appendDateTime(out, m_time, 0, event.getTimeNs());
+    out.append("\",\"level\":\"");
+    out.append(LogLevel::ToString(event.getLevel()));
+    out.append("\",\"logger\":\"");
+    const std::string& name = event.getLogger()->getName();
+    AppendEscaped(out, name.data(), name.size());
+    out.append("\",\"thread\":");
+    AppendUInt(out, event.getThreadId());
+    out.append(",\"thread_name\":\"");
+    AppendEscaped(out, event.getThreadName().data(), event.getThreadName().size());
+    out.append("\",\"fiber\":");
+    AppendUInt(out, event.getFiberId());
+    out.append(",\"file\":\"");
+    if (event.getFile()) {
+        AppendEscaped(out, event.getFile(), strlen(event.getFile()));
+    }
+    out.append("\",\"line\":");
+    AppendInt(out, event.getLine());
+    out.append(",\"msg\":\"");
+    AppendEscaped(out, event.getContentData(), event.getContentSize());
+    out.push_back('"');
+    for (size_t i = 0; i < event.getFieldCount(); ++i) {
+        const LogField& field = event.getField(i);
+        out.append(",\"");
+        AppendEscaped(out, field.key, strlen(field.key));
+        out.append("\":");
+        AppendFieldValue(out, event, field, true);
+    }
+    out.append("}\n");
 }
 
 // %xxx %xxx{xxx} %%
@@ -696,45 +2349,84 @@ void LogFormatter::init() {
         vec.push_back(std::make_tuple(nstr, "", 0));
     }
 */
-    static std::map<std::string, std::function<FormatItem::ptr(const std::string& str)> > s_format_items = {
+    static const std::map<std::string, OpCode> s_op_codes = {
 #define XX(str, C) \
-        {#str, [](const std::string& fmt) {return FormatItem::ptr(new C(fmt));}}
-
-        XX(m, MessageFormatItem),
-        XX(p, LevelFormatItem),
-        XX(r, ElapseFormatItem),
-        XX(c, NameFormatItem),
-        XX(t, ThreadIDFormatItem),
-        XX(n, NewLineFormatItem),
-        XX(d, DateTimeFormatItem),
-        XX(f, FilenameFormatItem),
-        XX(l, LineFormatItem),
-        XX(T, TabFormatItem),
-        XX(F, FiberIDFormatItem),
-        XX(P, ColorLevelFormatItem),
-        XX(N, ThreadNameFormatItem)
+        {#str, OpCode::C}
+
+        XX(m, MESSAGE),
+        XX(p, LEVEL),
+        XX(r, ELAPSE),
+        XX(c, NAME),
+        XX(t, THREAD_ID),
+        XX(d, DATETIME),
+        XX(f, FILENAME),
+        XX(l, LINE),
+        XX(F, FIBER_ID),
+        XX(P, COLOR_LEVEL),
+        XX(N, THREAD_NAME),
+        XX(K, FIELDS)
 
 #undef XX
     };
 
+    // 编译为扁平的操作码序列，%T %n和普通字符串一样作为常量，相邻常量合并
+    auto add_literal = [this](const std::string& str) {
+        if (!m_ops.empty() && m_ops.back().code == OpCode::LITERAL) {
+            m_ops.back().arg.append(str);
+        } else {
+            m_ops.push_back({OpCode::LITERAL, str});
+        }
+    };
+
     for (auto& i : vec) {
+        const std::string& key = std::get<0>(i);
+        const std::string& fmt = std::get<1>(i);
         if (std::get<2>(i) == 0) {
-            m_items.push_back(FormatItem::ptr(new StringFormatItem(std::get<0>(i))));
+            add_literal(key);
+        } else if (key == "T") {
+            add_literal("\t");
+        } else if (key == "n") {
+            add_literal("\n");
         } else {
-            auto it = s_format_items.find(std::get<0>(i));
-            if (it == s_format_items.end()) {
+            auto it = s_op_codes.find(key);
+            if (it == s_op_codes.end()) {
                 m_error = true;
-                m_items.push_back(FormatItem::ptr(new StringFormatItem("<<error_format %" + std::get<0>(i) + ">>")));
-            } else {
-                m_items.push_back(it->second(std::get<1>(i)));
+                add_literal("<<error_format %" + key + ">>");
+                continue;
+            }
+
+            Op op{it->second, fmt};
+            if (op.code == OpCode::DATETIME) {
+                // %d{ms} 或 %d{%H:%M:%S|us}
+                static const std::map<std::string, uint32_t> s_precisions = {
+                    {"ms", 3}, {"us", 6}, {"ns", 9}
+                };
+                std::string sub = op.arg;
+                size_t pos = op.arg.rfind('|');
+                if (pos != std::string::npos) {
+                    sub = op.arg.substr(pos + 1);
+                }
+                auto pit = s_precisions.find(sub);
+                if (pit != s_precisions.end()) {
+                    op.num = pit->second;
+                    op.arg = (pos == std::string::npos ? "" : op.arg.substr(0, pos));
+                }
+                if (op.arg.empty()) {
+                    op.arg = "%Y-%m-%d %H:%M:%S";
+                }
+            } else if (op.code == OpCode::FILENAME) {
+                if (fmt == "s") {
+                    op.code = OpCode::FILENAME_SHORT;
+                } else if (fmt == "r") {
+                    op.code = OpCode::FILENAME_RELATIVE;
+                }
             }
+            m_ops.push_back(op);
         }
 
         // std::cout << "(" << std::get<0>(i) << ") - (" << std::get<1>(i) << ") - (" << std::get<2>(i) << ")" << std::endl;
     }
 
-    // std::cout << m_items.size() << std::endl;
-
     /*
     %m -- message
     %p -- level
@@ -751,7 +2443,8 @@ void LogFormatter::init() {
 
 }
 
-LoggerManager::LoggerManager() {
+LoggerManager::LoggerManager()
+    : m_loggers(new LoggerMap) {
     m_root.reset(new Logger("root"));
 
     // root日志器的初始化
@@ -765,41 +2458,205 @@ LoggerManager::LoggerManager() {
     file_appender->setFormatter(file_formatter);
     m_root->addAppender(file_appender);
 
-    m_loggers[m_root->getName()] = m_root;
+    const_cast<LoggerMap*>(m_loggers.load(std::memory_order_relaxed))
+        ->emplace(m_root->getName(), m_root);
 
     init();
 }
 
+LoggerManager::~LoggerManager() {
+    flush();
+    delete m_loggers.load(std::memory_order_relaxed);
+}
+
+void LoggerManager::flush() {
+    // flush可能很慢，不在读临界区内做
+    std::vector<Logger::ptr> loggers;
+    {
+        Epoch::ReadGuard guard;
+        const LoggerMap* map = m_loggers.load(std::memory_order_acquire);
+        loggers.reserve(map->size());
+        for (auto& i : *map) {
+            loggers.push_back(i.second);
+        }
+    }
+    for (auto& i : loggers) {
+        i->flush();
+    }
+}
+
 Logger::ptr LoggerManager::getLogger(const std::string& name) {
-    MutexType::Lock lock(m_mutex);
-    auto it = m_loggers.find(name);
-    if (it != m_loggers.end()) {
+    {
+        Epoch::ReadGuard guard;
+        const LoggerMap* map = m_loggers.load(std::memory_order_acquire);
+        auto it = map->find(name);
+        if (it != map->end()) {
+            return it->second;
+        }
+    }
+
+    // 复制一次表，把本logger及缺少的父logger都加进去后只发布一次，解锁后再retire旧表
+    Logger::ptr logger;
+    const LoggerMap* old = nullptr;
+    {
+        MutexType::Lock lock(m_mutex);
+        const LoggerMap* cur = m_loggers.load(std::memory_order_relaxed);
+        auto it = cur->find(name);
+        if (it != cur->end()) {
+            return it->second;
+        }
+        LoggerMap* map = new LoggerMap(*cur);
+        logger = createLoggerNoLock(name, *map);
+        old = m_loggers.exchange(map, std::memory_order_acq_rel);
+    }
+    Epoch::GetInstance()->retire([old](){ delete old; });
+    return logger;
+}
+
+Logger::ptr LoggerManager::createLoggerNoLock(const std::string& name, LoggerMap& map) {
+    auto it = map.find(name);
+    if (it != map.end()) {
         return it->second;
     }
 
+    // 先保证父logger存在
+    Logger::ptr parent;
+    size_t pos = name.rfind('.');
+    if (pos != std::string::npos && pos > 0) {
+        parent = createLoggerNoLock(name.substr(0, pos), map);
+    }
+
     // 如果没有查询到，则创建一个新的logger，并使其拥有一个指向root日志器的指针
     Logger::ptr logger = std::make_shared<Logger>(name);
     logger->m_root = m_root;
-    m_loggers[name] = logger;
+    {
+        LogMutex::Lock lock(EffectiveMutex());
+        m_root->m_fallbacks.push_back(logger.get());
+        logger->updateEffectiveLevelNoLock();
+    }
+    if (parent) {
+        LogMutex::Lock lock(HierarchyMutex());
+        logger->m_parent = parent.get();
+        logger->m_ownLevel = LogLevel::UNKNOW;
+        logger->updateLevelNoLock();
+        parent->m_children.push_back(logger.get());
+    }
+
+    map.emplace(name, logger);
     return logger;
 }
 
+// 转换失败返回false而不是抛出异常，配置错误只打印并忽略该项
+template <class T>
+static bool ConvertScalar(const YAML::Node& node, T& v) {
+    return YAML::convert<T>::decode(node, v);
+}
+
 struct LogAppenderDefine {
     enum Type {
         TypeUNKNOW = 0,
         TypeFileLogAppender = 1,
-        TypeStdoutLogAppender = 2
+        TypeStdoutLogAppender = 2,
+        TypeAsyncLogAppender = 3,
+        TypeMmapFileLogAppender = 4,
+        TypeRingBufferLogAppender = 5,
+        TypeSocketLogAppender = 6,
+        TypeShmLogAppender = 7
     };
-    Type type = TypeUNKNOW; // 1 File, 2 Stdout
+    Type type = TypeUNKNOW; // 1 File, 2 Stdout, 3 Async, 4 MmapFile, 5 RingBuffer, 6 Socket, 7 Shm
     LogLevel::Level level = LogLevel::Level::UNKNOW;
     std::string formatter;
     std::string file;
 
+    // AsyncLogAppender
+    Type sink = TypeUNKNOW; // 被包装的File、MmapFile或Stdout
+    size_t capacity = 0;
+    std::string overflow;
+
+    // FileLogAppender，包括作为AsyncLogAppender的sink时；flush_interval也用于SocketLogAppender
+    uint64_t buffer_size = FileLogAppender::kDefaultBufferSize;
+    uint64_t flush_interval = FileLogAppender::kDefaultFlushInterval; // ms
+    uint64_t max_size = 0; // 0不按大小轮转
+    uint32_t max_files = 0; // 0保留全部
+    std::string rotate;
+    bool reopen_on_sighup = false;
+    uint64_t index_interval = 0; // 0不写索引
+
+    // MmapFileLogAppender
+    uint64_t segment_size = MmapFileLogAppender::kDefaultSegmentSize;
+
+    // RingBufferLogAppender，file为转储文件
+    uint64_t ring_size = RingBufferLogAppender::kDefaultRingSize;
+    bool dump_on_signal = true;
+
+    // SocketLogAppender
+    std::string address;
+    std::string app_name;
+    uint32_t facility = SocketLogAppender::kDefaultFacility;
+    uint64_t batch_size = SocketLogAppender::kDefaultBatchSize;
+
+    // ShmLogAppender
+    std::string shm;
+    uint64_t shm_size = ShmLogRing::kDefaultSize;
+
     bool operator==(const LogAppenderDefine& rhs) const {
         return type == rhs.type 
             && level == rhs.level
             && formatter == rhs.formatter
-            && file == rhs.file;
+            && file == rhs.file
+            && sink == rhs.sink
+            && capacity == rhs.capacity
+            && overflow == rhs.overflow
+            && buffer_size == rhs.buffer_size
+            && flush_interval == rhs.flush_interval
+            && max_size == rhs.max_size
+            && max_files == rhs.max_files
+            && rotate == rhs.rotate
+            && reopen_on_sighup == rhs.reopen_on_sighup
+            && index_interval == rhs.index_interval
+            && segment_size == rhs.segment_size
+            && ring_size == rhs.ring_size
+            && dump_on_signal == rhs.dump_on_signal
+            && address == rhs.address
+            && app_name == rhs.app_name
+            && facility == rhs.facility
+            && batch_size == rhs.batch_size
+            && shm == rhs.shm
+            && shm_size == rhs.shm_size;
+    }
+
+    // 支持K/M/G后缀，如 64K, 100M
+    static bool ParseSize(const std::string& str, uint64_t& v) {
+        char* end = nullptr;
+        errno = 0;
+        unsigned long long n = strtoull(str.c_str(), &end, 10);
+        if (end == str.c_str() || errno) {
+            return false;
+        }
+        switch (toupper(*end)) {
+            case 'G':
+                n <<= 10;
+                // fallthrough
+            case 'M':
+                n <<= 10;
+                // fallthrough
+            case 'K':
+                n <<= 10;
+                ++end;
+                break;
+            case '\0':
+                break;
+            default:
+                return false;
+        }
+        if (toupper(*end) == 'B') {
+            ++end;
+        }
+        if (*end) {
+            return false;
+        }
+        v = n;
+        return true;
     }
 
     static Type StringToType(const std::string& str) {
@@ -811,6 +2668,16 @@ struct LogAppenderDefine {
             return Type::TypeFileLogAppender;
         } else if (ucstr == "STDOUTLOGAPPENDER") {
             return Type::TypeStdoutLogAppender;
+        } else if (ucstr == "ASYNCLOGAPPENDER") {
+            return Type::TypeAsyncLogAppender;
+        } else if (ucstr == "MMAPFILELOGAPPENDER") {
+            return Type::TypeMmapFileLogAppender;
+        } else if (ucstr == "RINGBUFFERLOGAPPENDER") {
+            return Type::TypeRingBufferLogAppender;
+        } else if (ucstr == "SOCKETLOGAPPENDER") {
+            return Type::TypeSocketLogAppender;
+        } else if (ucstr == "SHMLOGAPPENDER") {
+            return Type::TypeShmLogAppender;
         }
 
         return Type::TypeUNKNOW;
@@ -825,6 +2692,11 @@ struct LogAppenderDefine {
 
             XX(FileLogAppender);
             XX(StdoutLogAppender);
+            XX(AsyncLogAppender);
+            XX(MmapFileLogAppender);
+            XX(RingBufferLogAppender);
+            XX(SocketLogAppender);
+            XX(ShmLogAppender);
 #undef XX
             default:
                 return "UNKNOW";
@@ -836,6 +2708,10 @@ struct LogDefine {
     std::string name;
     LogLevel::Level level = LogLevel::Level::UNKNOW;
     std::string formatter;
+    std::string binary; // BinaryLog文件，非空时SYLAR_LOG_FMT_*写二进制日志
+    uint32_t rate_limit = 0; // 每秒最多输出条数，0不限
+    uint32_t burst = 0;      // 允许的突发条数，0时同rate_limit
+    std::vector<std::string> debug; // 低于level也输出的调用点，见LogSiteRule
 
     std::vector<LogAppenderDefine> appenders;
 
@@ -843,6 +2719,10 @@ struct LogDefine {
         return name == rhs.name 
             && level == rhs.level
             && formatter == rhs.formatter
+            && binary == rhs.binary
+            && rate_limit == rhs.rate_limit
+            && burst == rhs.burst
+            && debug == rhs.debug
             && appenders == rhs.appenders;
     }
 
@@ -855,19 +2735,19 @@ struct LogDefine {
     }
 };
 
-static sylar::ConfigVar<std::set<LogDefine> >::ptr g_log_defines = 
-    sylar::Config::Lookup("logs", std::set<LogDefine>(), "logs config");
-
+// 直接读写节点，logs加载时不再逐个输出+解析LogDefine
 template <>
-class LexicalCast<std::string, LogDefine> {
+class LexicalCast<YAML::Node, LogDefine> {
 public:
-    LogDefine operator()(const std::string& v) {
-        YAML::Node node = YAML::Load(v);
+    LogDefine operator()(const YAML::Node& node) {
         LogDefine ld;
         
         if (!_read_name(ld, node)) return ld;
         if (!_read_level(ld, node)) return ld;
         if (!_read_formatter(ld, node)) return ld;
+        if (!_read_binary(ld, node)) return ld;
+        if (!_read_rate_limit(ld, node)) return ld;
+        if (!_read_debug(ld, node)) return ld;
         if (!_read_appenders(ld, node)) return ld;
         
         return ld;
@@ -918,6 +2798,56 @@ private:
         return true;
     }
 
+    bool _read_binary(LogDefine& ld, const YAML::Node& node) {
+        if (!node["binary"].IsDefined()) {
+            return true;
+        }
+
+        if (!node["binary"].IsScalar()) {
+            std::cout << "log config error: binary not scalar\n" << node << std::endl;
+            return false;
+        }
+        
+        ld.binary = node["binary"].as<std::string>();
+        return true;
+    }
+
+    bool _read_rate_limit(LogDefine& ld, const YAML::Node& node) {
+        if (node["rate_limit"].IsDefined()) {
+            if (!node["rate_limit"].IsScalar() || !ConvertScalar(node["rate_limit"], ld.rate_limit)) {
+                std::cout << "log config error: rate_limit invalid\n" << node << std::endl;
+                return false;
+            }
+        }
+
+        if (node["burst"].IsDefined()) {
+            if (!node["burst"].IsScalar() || !ConvertScalar(node["burst"], ld.burst)) {
+                std::cout << "log config error: burst invalid\n" << node << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool _read_debug(LogDefine& ld, const YAML::Node& node) {
+        if (!node["debug"].IsDefined()) {
+            return true;
+        }
+        if (!node["debug"].IsSequence()) {
+            std::cout << "log config error: debug not sequence\n" << node << std::endl;
+            return false;
+        }
+        for (auto& i : node["debug"]) {
+            LogSiteRule rule;
+            if (!i.IsScalar() || !LogSiteRule::Parse(i.as<std::string>(), rule)) {
+                std::cout << "log config error: debug rule invalid\n" << node << std::endl;
+                return false;
+            }
+            ld.debug.push_back(i.as<std::string>());
+        }
+        return true;
+    }
+
     bool _read_appenders(LogDefine& ld, const YAML::Node& node) {
         if (!node["appenders"].IsDefined()) {
             std::cout << "log config warn: appenders not defined\n" << node << std::endl;
@@ -956,13 +2886,36 @@ private:
             return false;
         }
 
-        // file iff FileLogAppender
-        if (lad.type == LogAppenderDefine::Type::TypeFileLogAppender) {
-            if (!appender_node["file"].IsDefined() || !appender_node["file"].IsScalar()) {
-                std::cout << "logappender config error: file not defined or not scalar\n" << appender_node << std::endl;
+        // sink iff AsyncLogAppender
+        if (lad.type == LogAppenderDefine::Type::TypeAsyncLogAppender) {
+            if (!_read_async(lad, appender_node)) {
+                return false;
+            }
+        }
+
+        // file iff FileLogAppender or MmapFileLogAppender
+        if (lad.type == LogAppenderDefine::Type::TypeFileLogAppender
+                || lad.sink == LogAppenderDefine::Type::TypeFileLogAppender) {
+            if (!_read_file(lad, appender_node)) {
+                return false;
+            }
+        } else if (lad.type == LogAppenderDefine::Type::TypeMmapFileLogAppender
+                || lad.sink == LogAppenderDefine::Type::TypeMmapFileLogAppender) {
+            if (!_read_mmap_file(lad, appender_node)) {
+                return false;
+            }
+        } else if (lad.type == LogAppenderDefine::Type::TypeRingBufferLogAppender) {
+            if (!_read_ring(lad, appender_node)) {
+                return false;
+            }
+        } else if (lad.type == LogAppenderDefine::Type::TypeSocketLogAppender) {
+            if (!_read_socket(lad, appender_node)) {
+                return false;
+            }
+        } else if (lad.type == LogAppenderDefine::Type::TypeShmLogAppender) {
+            if (!_read_shm(lad, appender_node)) {
                 return false;
             }
-            lad.file = appender_node["file"].as<std::string>();
         }
 
         // level
@@ -993,16 +2946,185 @@ private:
         
         return true;
     }
+
+    bool _read_async(LogAppenderDefine& lad, const YAML::Node& appender_node) {
+        if (!appender_node["sink"].IsDefined() || !appender_node["sink"].IsScalar()) {
+            std::cout << "logappender config error: sink not defined or not scalar\n" << appender_node << std::endl;
+            return false;
+        }
+
+        lad.sink = LogAppenderDefine::StringToType(appender_node["sink"].as<std::string>());
+        if (lad.sink != LogAppenderDefine::Type::TypeFileLogAppender
+                && lad.sink != LogAppenderDefine::Type::TypeMmapFileLogAppender
+                && lad.sink != LogAppenderDefine::Type::TypeStdoutLogAppender) {
+            std::cout << "logappender config error: sink should be FileLogAppender, MmapFileLogAppender or StdoutLogAppender\n" << appender_node << std::endl;
+            return false;
+        }
+
+        if (appender_node["capacity"].IsDefined()) {
+            if (!appender_node["capacity"].IsScalar()
+                    || !ConvertScalar(appender_node["capacity"], lad.capacity)) {
+                std::cout << "logappender config error: capacity invalid\n" << appender_node << std::endl;
+                return false;
+            }
+        }
+
+        if (appender_node["overflow"].IsDefined()) {
+            if (!appender_node["overflow"].IsScalar()) {
+                std::cout << "logappender config error: overflow not scalar\n" << appender_node << std::endl;
+                return false;
+            }
+            lad.overflow = appender_node["overflow"].as<std::string>();
+        }
+        return true;
+    }
+
+    bool _read_filename(LogAppenderDefine& lad, const YAML::Node& appender_node) {
+        if (!appender_node["file"].IsDefined() || !appender_node["file"].IsScalar()) {
+            std::cout << "logappender config error: file not defined or not scalar\n" << appender_node << std::endl;
+            return false;
+        }
+        lad.file = appender_node["file"].as<std::string>();
+        return true;
+    }
+
+    bool _read_mmap_file(LogAppenderDefine& lad, const YAML::Node& appender_node) {
+        if (!_read_filename(lad, appender_node)) {
+            return false;
+        }
+        if (appender_node["segment_size"].IsDefined()) {
+            if (!appender_node["segment_size"].IsScalar()
+                    || !LogAppenderDefine::ParseSize(appender_node["segment_size"].as<std::string>(), lad.segment_size)
+                    || !lad.segment_size) {
+                std::cout << "logappender config error: segment_size invalid\n" << appender_node << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool _read_ring(LogAppenderDefine& lad, const YAML::Node& appender_node) {
+        if (!_read_filename(lad, appender_node)) {
+            return false;
+        }
+        if (appender_node["ring_size"].IsDefined()) {
+            if (!appender_node["ring_size"].IsScalar()
+                    || !LogAppenderDefine::ParseSize(appender_node["ring_size"].as<std::string>(), lad.ring_size)
+                    || !lad.ring_size) {
+                std::cout << "logappender config error: ring_size invalid\n" << appender_node << std::endl;
+                return false;
+            }
+        }
+        if (appender_node["dump_on_signal"].IsDefined()) {
+            if (!appender_node["dump_on_signal"].IsScalar()
+                    || !ConvertScalar(appender_node["dump_on_signal"], lad.dump_on_signal)) {
+                std::cout << "logappender config error: dump_on_signal invalid\n" << appender_node << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool _read_socket(LogAppenderDefine& lad, const YAML::Node& appender_node) {
+        if (!appender_node["address"].IsDefined() || !appender_node["address"].IsScalar()) {
+            std::cout << "logappender config error: address not defined or not scalar\n" << appender_node << std::endl;
+            return false;
+        }
+        lad.address = appender_node["address"].as<std::string>();
+        if (lad.address.compare(0, 5, "unix:") != 0 && lad.address.compare(0, 4, "udp:") != 0) {
+            std::cout << "logappender config error: address should be unix:/path or udp:host:port\n" << appender_node << std::endl;
+            return false;
+        }
+
+#define XX(key, parse) \
+        if (appender_node[#key].IsDefined()) { \
+            if (!appender_node[#key].IsScalar()) { \
+                std::cout << "logappender config error: " #key " not scalar\n" << appender_node << std::endl; \
+                return false; \
+            } \
+            if (!(parse)) { \
+                std::cout << "logappender config error: " #key " invalid\n" << appender_node << std::endl; \
+                return false; \
+            } \
+        }
+
+        XX(app_name, (lad.app_name = appender_node["app_name"].as<std::string>(), !lad.app_name.empty()));
+        XX(facility, ConvertScalar(appender_node["facility"], lad.facility) && lad.facility <= 23);
+        XX(batch_size, ConvertScalar(appender_node["batch_size"], lad.batch_size) && lad.batch_size > 0);
+        XX(flush_interval, ConvertScalar(appender_node["flush_interval"], lad.flush_interval));
+#undef XX
+        return true;
+    }
+
+    bool _read_shm(LogAppenderDefine& lad, const YAML::Node& appender_node) {
+        if (!appender_node["shm"].IsDefined() || !appender_node["shm"].IsScalar()) {
+            std::cout << "logappender config error: shm not defined or not scalar\n" << appender_node << std::endl;
+            return false;
+        }
+        lad.shm = appender_node["shm"].as<std::string>();
+        if (lad.shm.empty() || lad.shm.find('/', 1) != std::string::npos) {
+            std::cout << "logappender config error: shm should be a name without '/'\n" << appender_node << std::endl;
+            return false;
+        }
+        if (appender_node["shm_size"].IsDefined()) {
+            if (!appender_node["shm_size"].IsScalar()
+                    || !LogAppenderDefine::ParseSize(appender_node["shm_size"].as<std::string>(), lad.shm_size)
+                    || !lad.shm_size) {
+                std::cout << "logappender config error: shm_size invalid\n" << appender_node << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool _read_file(LogAppenderDefine& lad, const YAML::Node& appender_node) {
+        if (!_read_filename(lad, appender_node)) {
+            return false;
+        }
+
+#define XX(key, parse) \
+        if (appender_node[#key].IsDefined()) { \
+            if (!appender_node[#key].IsScalar()) { \
+                std::cout << "logappender config error: " #key " not scalar\n" << appender_node << std::endl; \
+                return false; \
+            } \
+            std::string str = appender_node[#key].as<std::string>(); \
+            if (!(parse)) { \
+                std::cout << "logappender config error: " #key " invalid\n" << appender_node << std::endl; \
+                return false; \
+            } \
+        }
+
+        XX(buffer_size, LogAppenderDefine::ParseSize(str, lad.buffer_size));
+        XX(max_size, LogAppenderDefine::ParseSize(str, lad.max_size));
+        XX(flush_interval, ConvertScalar(appender_node["flush_interval"], lad.flush_interval));
+        XX(max_files, ConvertScalar(appender_node["max_files"], lad.max_files));
+        XX(rotate, (lad.rotate = str, FileLogAppender::StringToRotateType(str) != FileLogAppender::RotateType::NONE
+                    || str == "none"));
+        XX(reopen_on_sighup, ConvertScalar(appender_node["reopen_on_sighup"], lad.reopen_on_sighup));
+        XX(index_interval, LogAppenderDefine::ParseSize(str, lad.index_interval));
+#undef XX
+        return true;
+    }
 };
 
 template <>
-class LexicalCast<LogDefine, std::string> {
+class LexicalCast<LogDefine, YAML::Node> {
 public:
-    std::string operator()(const LogDefine& ld) {
+    YAML::Node operator()(const LogDefine& ld) {
         YAML::Node node;
         node["name"] = ld.name;
         node["level"] = LogLevel::ToString(ld.level);
         node["formatter"] = ld.formatter;
+        if (!ld.binary.empty())
+            node["binary"] = ld.binary;
+        if (ld.rate_limit)
+            node["rate_limit"] = ld.rate_limit;
+        if (ld.burst)
+            node["burst"] = ld.burst;
+        for (auto& i : ld.debug) {
+            node["debug"].push_back(i);
+        }
         
         YAML::Node appenders_node;
         for (size_t n = 0; n < ld.appenders.size(); ++n) {
@@ -1013,16 +3135,87 @@ public:
                 appenders_node[n]["formatter"] = a.formatter;
             if (a.level != LogLevel::Level::UNKNOW)
                 appenders_node[n]["level"] = LogLevel::ToString(a.level);
+            if (a.sink != LogAppenderDefine::Type::TypeUNKNOW)
+                appenders_node[n]["sink"] = LogAppenderDefine::TypeToString(a.sink);
+            if (a.capacity)
+                appenders_node[n]["capacity"] = a.capacity;
+            if (!a.overflow.empty())
+                appenders_node[n]["overflow"] = a.overflow;
+            if (a.buffer_size != FileLogAppender::kDefaultBufferSize)
+                appenders_node[n]["buffer_size"] = a.buffer_size;
+            if (a.flush_interval != FileLogAppender::kDefaultFlushInterval)
+                appenders_node[n]["flush_interval"] = a.flush_interval;
+            if (a.max_size)
+                appenders_node[n]["max_size"] = a.max_size;
+            if (a.max_files)
+                appenders_node[n]["max_files"] = a.max_files;
+            if (!a.rotate.empty())
+                appenders_node[n]["rotate"] = a.rotate;
+            if (a.reopen_on_sighup)
+                appenders_node[n]["reopen_on_sighup"] = true;
+            if (a.index_interval)
+                appenders_node[n]["index_interval"] = a.index_interval;
+            if (a.segment_size != MmapFileLogAppender::kDefaultSegmentSize)
+                appenders_node[n]["segment_size"] = a.segment_size;
+            if (a.ring_size != RingBufferLogAppender::kDefaultRingSize)
+                appenders_node[n]["ring_size"] = a.ring_size;
+            if (!a.dump_on_signal)
+                appenders_node[n]["dump_on_signal"] = false;
+            if (!a.address.empty())
+                appenders_node[n]["address"] = a.address;
+            if (!a.app_name.empty())
+                appenders_node[n]["app_name"] = a.app_name;
+            if (a.facility != SocketLogAppender::kDefaultFacility)
+                appenders_node[n]["facility"] = a.facility;
+            if (a.batch_size != SocketLogAppender::kDefaultBatchSize)
+                appenders_node[n]["batch_size"] = a.batch_size;
+            if (!a.shm.empty())
+                appenders_node[n]["shm"] = a.shm;
+            if (a.shm_size != ShmLogRing::kDefaultSize)
+                appenders_node[n]["shm_size"] = a.shm_size;
             appenders_node[n]["type"] = LogAppenderDefine::TypeToString(a.type);
         }
         node["appenders"] = appenders_node;
+        return node;
+    }
+};
 
+template <>
+class LexicalCast<std::string, LogDefine> {
+public:
+    LogDefine operator()(const std::string& v) {
+        return LexicalCast<YAML::Node, LogDefine>()(YAML::Load(v));
+    }
+};
+
+template <>
+class LexicalCast<LogDefine, std::string> {
+public:
+    std::string operator()(const LogDefine& ld) {
         std::stringstream ss;
-        ss << node;
+        ss << LexicalCast<LogDefine, YAML::Node>()(ld);
         return ss.str();
     }
 };
 
+// 在LogDefine的LexicalCast特化之后声明
+static sylar::ConfigVar<std::set<LogDefine> >::ptr g_log_defines = 
+    sylar::Config::Lookup("logs", std::set<LogDefine>(), "logs config");
+
+static FileLogAppender::ptr CreateFileAppender(const LogAppenderDefine& a) {
+    FileLogAppender::ptr ap(new FileLogAppender(a.file));
+    ap->setBufferSize(a.buffer_size);
+    ap->setFlushInterval(a.flush_interval);
+    ap->setMaxSize(a.max_size);
+    ap->setMaxFiles(a.max_files);
+    ap->setRotateType(FileLogAppender::StringToRotateType(a.rotate));
+    ap->setIndexInterval(a.index_interval);
+    if (a.reopen_on_sighup) {
+        FileLogAppender::InstallSighupHandler();
+    }
+    return ap;
+}
+
 struct LogIniter {
     LogIniter() {
         SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "New Launch\
@@ -1057,13 +3250,55 @@ struct LogIniter {
                     logger->setFormatter(i.formatter);
                 }
 
+                if (i.binary.empty()) {
+                    logger->setBinary(false);
+                } else if (BinaryLog::GetInstance()->open(i.binary)) {
+                    logger->setBinary(true);
+                } else {
+                    std::cout << "open binary log failed:" << i.binary << std::endl;
+                    logger->setBinary(false);
+                }
+                logger->setRateLimit(i.rate_limit, i.burst);
+
+                std::vector<LogSiteRule> rules(i.debug.size());
+                for (size_t n = 0; n < i.debug.size(); ++n) {
+                    LogSiteRule::Parse(i.debug[n], rules[n]);
+                }
+                logger->setDebugSites(rules);
+
                 logger->clearAppenders();
                 for (auto &a : i.appenders) {
                     sylar::LogAppender::ptr ap;
                     if (a.type == LogAppenderDefine::Type::TypeFileLogAppender) {
-                        ap.reset(new FileLogAppender(a.file));
+                        ap = CreateFileAppender(a);
+                    } else if (a.type == LogAppenderDefine::Type::TypeMmapFileLogAppender) {
+                        ap.reset(new MmapFileLogAppender(a.file, a.segment_size));
                     } else if (a.type == LogAppenderDefine::Type::TypeStdoutLogAppender) {
                         ap.reset(new StdoutLogAppender);
+                    } else if (a.type == LogAppenderDefine::Type::TypeRingBufferLogAppender) {
+                        ap.reset(new RingBufferLogAppender(a.file, a.ring_size));
+                        if (a.dump_on_signal) {
+                            RingBufferLogAppender::InstallSignalHandlers();
+                        }
+                    } else if (a.type == LogAppenderDefine::Type::TypeSocketLogAppender) {
+                        SocketLogAppender::ptr sock(new SocketLogAppender(a.address,
+                                    a.app_name.empty() ? "sylar" : a.app_name, a.facility));
+                        sock->setBatchSize(a.batch_size);
+                        sock->setFlushInterval(a.flush_interval);
+                        ap = sock;
+                    } else if (a.type == LogAppenderDefine::Type::TypeShmLogAppender) {
+                        ap.reset(new ShmLogAppender(a.shm, a.shm_size));
+                    } else if (a.type == LogAppenderDefine::Type::TypeAsyncLogAppender) {
+                        sylar::LogAppender::ptr sink;
+                        if (a.sink == LogAppenderDefine::Type::TypeFileLogAppender) {
+                            sink = CreateFileAppender(a);
+                        } else if (a.sink == LogAppenderDefine::Type::TypeMmapFileLogAppender) {
+                            sink.reset(new MmapFileLogAppender(a.file, a.segment_size));
+                        } else {
+                            sink.reset(new StdoutLogAppender);
+                        }
+                        ap.reset(new AsyncLogAppender(sink, a.capacity, 
+                                    AsyncLogAppender::StringToPolicy(a.overflow)));
                     } else {
                         std::cout << "Unknown Appender Type" << std::endl;
                         break;
@@ -1071,7 +3306,7 @@ struct LogIniter {
 
                     ap->setLevel(a.level);
                     if (!a.formatter.empty())
-                        ap->setFormatter(std::make_shared<LogFormatter>(a.formatter));
+                        ap->setFormatter(LogFormatter::Create(a.formatter));
                     
                     logger->addAppender(ap);
                 }
@@ -1085,6 +3320,9 @@ struct LogIniter {
                     // 删除
                     auto logger = SYLAR_LOG_NAME(i.name);
                     logger->setLevel(static_cast<LogLevel::Level>(100)); // 通过设置高的level来使其不输出
+                    logger->setBinary(false);
+                    logger->setRateLimit(0);
+                    logger->setDebugSites({});
                     logger->clearAppenders();
                 }
             }
@@ -1103,9 +3341,15 @@ void LoggerManager::init() {
 }
 
 std::string LoggerManager::toYamlString() const {
-    MutexType::Lock lock(m_mutex);
+    // 按名字排序输出
+    std::map<std::string, Logger::ptr> loggers;
+    {
+        Epoch::ReadGuard guard;
+        const LoggerMap* map = m_loggers.load(std::memory_order_acquire);
+        loggers.insert(map->begin(), map->end());
+    }
     YAML::Node node;
-    for (auto& i : m_loggers) {
+    for (auto& i : loggers) {
         node.push_back(YAML::Load(i.second->toYamlString()));
     }
 
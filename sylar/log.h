@@ -8,19 +8,41 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <string_view>
+#include <type_traits>
 
+#include <atomic>
 #include <cstdint>
 #include <cstdarg>
+#include <cstring>
 
 #include "singleton.h"
 #include "util.h"
 #include "thread.h" // 线程锁
 
-#define SYLAR_LOG_LEVEL(logger, level)                                                              \
-    if (logger->getLevel() <= level)                                                                \
-        sylar::LogEventWrap(std::make_shared<sylar::LogEvent>(logger, level, __FILE__, __LINE__, 0, \
-            sylar::GetThreadId(), sylar::GetFiberId(), time(0),                                     \
-            sylar::Thread::GetName())).getSS()
+// 函数内static的调用点描述，首次执行时构造，之后只取引用
+#define SYLAR_LOG_CALLSITE(level)                                                          \
+    ([](const char* func, sylar::LogLevel::Level lv) -> const sylar::LogCallSite& {        \
+        static const sylar::LogCallSite s_sylar_site(__FILE__, __LINE__, func, lv);        \
+        return s_sylar_site;                                                               \
+    }(__func__, level))
+
+// 调用点开关，按logs配置的debug规则在运行时单独放行某些调用点
+// 开关是常量初始化的static，没有初始化guard，未启用时只有一次读取和一次分支
+#define SYLAR_LOG_SITE_ENABLED()                                                           \
+    ([](const char* func) -> bool {                                                        \
+        static sylar::LogSiteSwitch s_sylar_switch;                                        \
+        return s_sylar_switch.enabled(__FILE__, __LINE__, func);                           \
+    }(__func__))
+
+// 以"if (!cond) {} else"开头，整个宏是一条以else分支结尾的语句，
+// 调用方写"if (c) SYLAR_LOG_INFO(g) << ...; else ..."时else不会被宏内的if抢走
+#define SYLAR_LOG_LEVEL(logger, level)                                                     \
+    if (!((logger->getEffectiveLevel() <= level || SYLAR_LOG_SITE_ENABLED())               \
+            && logger->checkRate())) {}                                                    \
+    else sylar::LogEventWrap(sylar::LogEvent::Create(&*(logger), level,                    \
+            SYLAR_LOG_CALLSITE(level))).getSS()
 
 #define SYLAR_LOG_DEBUG(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::DEBUG)
 #define SYLAR_LOG_INFO(logger)  SYLAR_LOG_LEVEL(logger, sylar::LogLevel::INFO)
@@ -28,13 +50,57 @@
 #define SYLAR_LOG_ERROR(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::ERROR)
 #define SYLAR_LOG_FATAL(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::FATAL)
 
-#define SYLAR_LOG_FMT_LEVEL(logger, level, fmt, ...)                                                \
-    if (logger->getLevel() <= level)                                                                \
-        sylar::LogEventWrap(std::make_shared<sylar::LogEvent>(logger, level, __FILE__, __LINE__, 0, \
-            sylar::GetThreadId(), sylar::GetFiberId(), time(0),                                     \
-            sylar::Thread::GetName()))                                                               \
-        .getEvent()                                                                                 \
-        ->format(fmt, __VA_ARGS__)
+// 按调用点采样，check为LogCallSite的everyN/firstN/everyMs
+// 先过级别和采样，再取logger的令牌，被丢弃的调用不构造LogEvent
+#define SYLAR_LOG_SAMPLED(logger, level, check)                                            \
+    if (!(logger->getEffectiveLevel() <= level || SYLAR_LOG_SITE_ENABLED())) {}            \
+    else if (const sylar::LogCallSite& sylar_site = SYLAR_LOG_CALLSITE(level);             \
+            !(sylar_site.check && logger->checkRate())) {}                                 \
+    else sylar::LogEventWrap(sylar::LogEvent::Create(&*(logger), level,                    \
+            sylar_site)).getSS()
+
+// 第1, n+1, 2n+1...次执行时输出
+#define SYLAR_LOG_EVERY_N(logger, level, n) SYLAR_LOG_SAMPLED(logger, level, everyN(n))
+// 只输出前n次
+#define SYLAR_LOG_FIRST_N(logger, level, n) SYLAR_LOG_SAMPLED(logger, level, firstN(n))
+// 每ms毫秒最多输出一次
+#define SYLAR_LOG_EVERY_MS(logger, level, ms) SYLAR_LOG_SAMPLED(logger, level, everyMs(ms))
+
+#define SYLAR_LOG_DEBUG_EVERY_N(logger, n) SYLAR_LOG_EVERY_N(logger, sylar::LogLevel::DEBUG, n)
+#define SYLAR_LOG_INFO_EVERY_N(logger, n)  SYLAR_LOG_EVERY_N(logger, sylar::LogLevel::INFO, n)
+#define SYLAR_LOG_WARN_EVERY_N(logger, n)  SYLAR_LOG_EVERY_N(logger, sylar::LogLevel::WARN, n)
+#define SYLAR_LOG_ERROR_EVERY_N(logger, n) SYLAR_LOG_EVERY_N(logger, sylar::LogLevel::ERROR, n)
+#define SYLAR_LOG_FATAL_EVERY_N(logger, n) SYLAR_LOG_EVERY_N(logger, sylar::LogLevel::FATAL, n)
+
+#define SYLAR_LOG_DEBUG_FIRST_N(logger, n) SYLAR_LOG_FIRST_N(logger, sylar::LogLevel::DEBUG, n)
+#define SYLAR_LOG_INFO_FIRST_N(logger, n)  SYLAR_LOG_FIRST_N(logger, sylar::LogLevel::INFO, n)
+#define SYLAR_LOG_WARN_FIRST_N(logger, n)  SYLAR_LOG_FIRST_N(logger, sylar::LogLevel::WARN, n)
+#define SYLAR_LOG_ERROR_FIRST_N(logger, n) SYLAR_LOG_FIRST_N(logger, sylar::LogLevel::ERROR, n)
+#define SYLAR_LOG_FATAL_FIRST_N(logger, n) SYLAR_LOG_FIRST_N(logger, sylar::LogLevel::FATAL, n)
+
+#define SYLAR_LOG_DEBUG_EVERY_MS(logger, ms) SYLAR_LOG_EVERY_MS(logger, sylar::LogLevel::DEBUG, ms)
+#define SYLAR_LOG_INFO_EVERY_MS(logger, ms)  SYLAR_LOG_EVERY_MS(logger, sylar::LogLevel::INFO, ms)
+#define SYLAR_LOG_WARN_EVERY_MS(logger, ms)  SYLAR_LOG_EVERY_MS(logger, sylar::LogLevel::WARN, ms)
+#define SYLAR_LOG_ERROR_EVERY_MS(logger, ms) SYLAR_LOG_EVERY_MS(logger, sylar::LogLevel::ERROR, ms)
+#define SYLAR_LOG_FATAL_EVERY_MS(logger, ms) SYLAR_LOG_EVERY_MS(logger, sylar::LogLevel::FATAL, ms)
+
+// 同SYLAR_LOG_CALLSITE，另记录格式串供二进制日志使用
+#define SYLAR_LOG_FMT_CALLSITE(level, fmt)                                                 \
+    ([](const char* func, sylar::LogLevel::Level lv, const char* f)                        \
+            -> const sylar::LogCallSite& {                                                 \
+        static const sylar::LogCallSite s_sylar_site(__FILE__, __LINE__, func, lv, f);     \
+        return s_sylar_site;                                                               \
+    }(__func__, level, fmt))
+
+// logger开启二进制模式时只记录原始参数，由sylar_logdecode离线格式化
+#define SYLAR_LOG_FMT_LEVEL(logger, level, fmt, ...)                                       \
+    if (!((logger->getEffectiveLevel() <= level || SYLAR_LOG_SITE_ENABLED())               \
+            && logger->checkRate())) {}                                                    \
+    else if (const sylar::LogCallSite& sylar_site = SYLAR_LOG_FMT_CALLSITE(level, fmt);    \
+            sylar::BinaryLog::Enabled(&*(logger), sylar_site, level, fmt)) {               \
+        sylar::BinaryLog::Write(&*(logger), sylar_site, level, fmt, __VA_ARGS__);          \
+    } else sylar::LogEventWrap(sylar::LogEvent::Create(&*(logger), level,                  \
+            sylar_site)).getEvent()->format(fmt, __VA_ARGS__)
 
 #define SYLAR_LOG_FMT_DEBUG(logger, fmt, ...) SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::DEBUG, fmt, __VA_ARGS__)
 #define SYLAR_LOG_FMT_INFO(logger, fmt, ...)  SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::INFO,  fmt, __VA_ARGS__)
@@ -42,6 +108,24 @@
 #define SYLAR_LOG_FMT_ERROR(logger, fmt, ...) SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::ERROR, fmt, __VA_ARGS__)
 #define SYLAR_LOG_FMT_FATAL(logger, fmt, ...) SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::FATAL, fmt, __VA_ARGS__)
 
+// {}风格格式化，格式串须为字面量，与参数不匹配时编译失败，见LogFormat
+// SYLAR_LOG_FORMAT_INFO(g_logger, "user {} took {:.3f}ms", id, ms);
+#define SYLAR_LOG_FORMAT_LEVEL(logger, level, fmt, ...)                                    \
+    if (!((logger->getEffectiveLevel() <= level || SYLAR_LOG_SITE_ENABLED())               \
+            && logger->checkRate())) {}                                                    \
+    else [](sylar::LogStream& sylar_ss, const auto&... sylar_args) {                        \
+            static_assert(sylar::LogFormat::Check<decltype(sylar_args)...>(fmt),           \
+                    "log format string does not match arguments");                         \
+            sylar::LogFormat::Write(sylar_ss, fmt, sylar_args...);                         \
+        }(sylar::LogEventWrap(sylar::LogEvent::Create(&*(logger), level,                   \
+            SYLAR_LOG_CALLSITE(level))).getSS(), ##__VA_ARGS__)
+
+#define SYLAR_LOG_FORMAT_DEBUG(logger, fmt, ...) SYLAR_LOG_FORMAT_LEVEL(logger, sylar::LogLevel::DEBUG, fmt, ##__VA_ARGS__)
+#define SYLAR_LOG_FORMAT_INFO(logger, fmt, ...)  SYLAR_LOG_FORMAT_LEVEL(logger, sylar::LogLevel::INFO,  fmt, ##__VA_ARGS__)
+#define SYLAR_LOG_FORMAT_WARN(logger, fmt, ...)  SYLAR_LOG_FORMAT_LEVEL(logger, sylar::LogLevel::WARN,  fmt, ##__VA_ARGS__)
+#define SYLAR_LOG_FORMAT_ERROR(logger, fmt, ...) SYLAR_LOG_FORMAT_LEVEL(logger, sylar::LogLevel::ERROR, fmt, ##__VA_ARGS__)
+#define SYLAR_LOG_FORMAT_FATAL(logger, fmt, ...) SYLAR_LOG_FORMAT_LEVEL(logger, sylar::LogLevel::FATAL, fmt, ##__VA_ARGS__)
+
 #define SYLAR_LOG_ROOT() sylar::LoggerMgr::GetInstance()->getRoot()
 #define SYLAR_LOG_NAME(name) sylar::LoggerMgr::GetInstance()->getLogger(name)
 
@@ -69,6 +153,8 @@ using LogMutex = NullMutex;
 
 class Logger;
 class LoggerManager;
+class LogFormatter;
+class LogEvent;
 
 class LogLevel {
 public:
@@ -85,54 +171,565 @@ public:
     static LogLevel::Level FromString(const std::string& str);
 };
 
+// 日志调用点的静态信息
+// 文件名的简化形式(%f{s})和相对路径(%f{r})在构造时算好，格式化时直接取用
+class LogCallSite {
+    friend class BinaryLog;
+public:
+    LogCallSite(const char* file, int32_t line, const char* func, LogLevel::Level level,
+            const char* format = nullptr);
+
+    const char* getFile() const { return m_file; }
+    const std::string& getShortFile() const { return m_shortFile; }
+    const std::string& getRelativeFile() const { return m_relativeFile; }
+    int32_t getLine() const { return m_line; }
+    const char* getFunction() const { return m_func; }
+    // 首次执行该调用点时的日志级别
+    LogLevel::Level getLevel() const { return m_level; }
+    // SYLAR_LOG_FMT_*的格式串，首次执行时记录
+    const char* getFormat() const { return m_format; }
+    // 二进制日志中的描述符id，未注册为0
+    uint32_t getBinaryId() const { return m_binaryId.load(std::memory_order_acquire); }
+
+    // 采样判断，供SYLAR_LOG_*_EVERY_N等宏使用，被丢弃的次数计入suppressed
+    bool everyN(uint64_t n) const {
+        if (m_count.fetch_add(1, std::memory_order_relaxed) % (n ? n : 1) == 0) {
+            return true;
+        }
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    // 前n次之后不再输出，也不计suppressed
+    bool firstN(uint64_t n) const {
+        return m_count.load(std::memory_order_relaxed) < n
+            && m_count.fetch_add(1, std::memory_order_relaxed) < n;
+    }
+    bool everyMs(uint64_t ms) const;
+    // 取走上次输出以来被丢弃的次数
+    uint64_t takeSuppressed() const {
+        return m_suppressed.load(std::memory_order_relaxed)
+            ? m_suppressed.exchange(0, std::memory_order_relaxed) : 0;
+    }
+
+    static std::string ShortFilename(const char* file);
+    static std::string RelativeFilename(const char* file);
+private:
+    const char* m_file;
+    std::string m_shortFile;
+    std::string m_relativeFile;
+    int32_t m_line;
+    const char* m_func;
+    LogLevel::Level m_level;
+    const char* m_format;
+    mutable std::atomic<uint32_t> m_binaryId {0};
+    mutable std::atomic<uint64_t> m_count {0};      // everyN/firstN的执行次数
+    mutable std::atomic<uint64_t> m_lastMs {0};     // everyMs上次输出的时间，GetMonotonicMS
+    mutable std::atomic<uint64_t> m_suppressed {0};
+
+private:
+    SYLAR_DISABLE_COPY(LogCallSite)
+};
+
+// 放行调用点的规则，配置写法:
+//   fiber.cc            整个文件(按路径后缀匹配，可带目录 sylar/fiber.cc)
+//   fiber.cc:120        单行
+//   fiber.cc:100-200    行范围
+//   run()               函数名，即__func__，Scheduler::run()只比较最后一段
+struct LogSiteRule {
+    std::string file;
+    int32_t begin = 0;
+    int32_t end = INT32_MAX;
+    std::string func;
+
+    bool match(const char* file, int32_t line, const char* func) const;
+    std::string toString() const;
+    // 格式错误返回false
+    static bool Parse(const std::string& str, LogSiteRule& rule);
+};
+
+// 每个日志调用点一个，记录该调用点是否被debug规则放行
+// 首次执行时登记并按当前规则求值，规则变化时统一重算
+class LogSiteSwitch {
+public:
+    enum State : uint8_t {
+        UNKNOWN = 0,    // 尚未登记
+        DISABLED = 1,
+        ENABLED = 2
+    };
+
+    constexpr LogSiteSwitch() {}
+
+    bool enabled(const char* file, int32_t line, const char* func) {
+        uint8_t state = m_state.load(std::memory_order_relaxed);
+        return state != DISABLED && (state == ENABLED || resolve(file, line, func));
+    }
+
+    // 设置logger的规则，所有logger的规则的并集决定开关状态
+    static void SetRules(const Logger* logger, const std::vector<LogSiteRule>& rules);
+    // 已登记且被放行的调用点数
+    static size_t EnabledCount();
+private:
+    bool resolve(const char* file, int32_t line, const char* func);
+private:
+    std::atomic<uint8_t> m_state {UNKNOWN};
+    const char* m_file = nullptr;
+    int32_t m_line = 0;
+    const char* m_func = nullptr;
+    LogSiteSwitch* m_next = nullptr;
+
+private:
+    SYLAR_DISABLE_COPY(LogSiteSwitch)
+};
+
+// 日志消息缓冲，先写入定长的内联缓冲区，写满后才转移到堆上
+// 随LogEvent一起被线程本地复用，稳态下不分配内存
+class LogStreamBuf : public std::streambuf {
+public:
+    static const size_t kInlineSize = 512;
+    // 复用时保留的最大堆缓冲，超过则释放，避免个别超长日志长期占用内存
+    static const size_t kMaxRetainSize = 64 * 1024;
+
+    LogStreamBuf();
+
+    const char* data() const { return pbase(); }
+    size_t size() const { return pptr() - pbase(); }
+    void clear();
+    void append(const char* s, size_t n);
+    // 保证至少还有n字节可写，返回写指针，写完后调用commit
+    char* reserve(size_t n);
+    void commit(size_t n) { pbump((int)n); }
+
+protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+
+private:
+    void grow(size_t n);
+
+private:
+    char m_inline[kInlineSize];
+    std::unique_ptr<char[]> m_heap;
+    size_t m_heapSize = 0;
+
+private:
+    SYLAR_DISABLE_COPY(LogStreamBuf)
+};
+
+class LogStream : public std::ostream {
+public:
+    LogStream(LogEvent* event) : std::ostream(&m_buf), m_event(event) {}
+
+    const char* data() const { return m_buf.data(); }
+    size_t size() const { return m_buf.size(); }
+    std::string str() const { return std::string(data(), size()); }
+    LogStreamBuf& buf() { return m_buf; }
+    // 清空内容，并恢复格式标志(上一条日志可能设置了std::hex等)
+    void reset();
+
+    // 给所属事件添加结构化字段，SYLAR_LOG_INFO(g).kv("user", id) << "msg"
+    template <class T>
+    LogStream& kv(const char* key, const T& value);
+
+private:
+    LogStreamBuf m_buf;
+    LogEvent* m_event;
+};
+
+// 结构化字段，值按类型原样保存，由formatter输出时才转成文本
+// key不拷贝，须是字符串字面量或比事件活得久
+struct LogField {
+    enum Type : uint8_t {
+        INT = 0,
+        UINT,
+        DOUBLE,
+        BOOL,
+        STRING
+    };
+
+    const char* key;
+    Type type;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        bool b;
+        struct {
+            uint32_t offset;    // 在事件字段缓冲中的位置
+            uint32_t size;
+        } str;
+    };
+};
+
 class LogEvent {
+    friend class BinaryLogReader;
 public:
     using ptr = std::shared_ptr<LogEvent>;
-    LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level, 
+    // time: 秒
+    LogEvent(Logger* logger, LogLevel::Level level, 
             const char* file, int32_t line, uint32_t elapse, 
             uint32_t thread_id, uint32_t fiber_id, uint64_t time,
             const std::string& thread_name);
     ~LogEvent();
 
+    // 日志宏使用的构造入口，复用当前线程缓存的LogEvent
+    // 只有缓存的事件仍被他处持有(异步appender队列、嵌套日志)时才新分配
+    static LogEvent::ptr Create(Logger* logger, LogLevel::Level level,
+            const char* file, int32_t line);
+    static LogEvent::ptr Create(Logger* logger, LogLevel::Level level,
+            const LogCallSite& site);
+
     const char* getFile() const { return m_file; }
     int32_t getLine() const { return m_line; }
     uint32_t getElapse() const { return m_elapse; }
     uint32_t getThreadId() const { return m_threadId; }
     uint32_t getFiberId() const { return m_fiberId; }
-    uint64_t getTime() const { return m_time; }
+    // 秒
+    uint64_t getTime() const { return m_time / 1000000000ull; }
+    // 纳秒
+    uint64_t getTimeNs() const { return m_time; }
     std::string getContent() const { return m_ss.str(); }
-    std::shared_ptr<Logger> getLogger() const { return m_logger; }
+    const char* getContentData() const { return m_ss.data(); }
+    size_t getContentSize() const { return m_ss.size(); }
+    // 不持有logger，logger须比事件活得更久(Logger析构时会flush其appender)
+    Logger* getLogger() const { return m_logger; }
     LogLevel::Level getLevel() const { return m_level; }
     const std::string& getThreadName() const { return m_threadName; }
+    // 通过日志宏产生的事件才有调用点，手工构造的为nullptr
+    const LogCallSite* getCallSite() const { return m_site; }
+    // 级别低于logger的生效级别，由调用点开关放行，appender不再按级别过滤
+    bool isForced() const { return m_forced; }
+
+    // 结构化字段，按添加顺序
+    size_t getFieldCount() const { return m_fieldCount; }
+    const LogField& getField(size_t i) const {
+        return i < kInlineFields ? m_fields[i] : m_moreFields[i - kInlineFields];
+    }
+    std::string_view getFieldString(const LogField& field) const {
+        return std::string_view(m_fieldData.data() + field.str.offset, field.str.size);
+    }
+    // 整数、浮点、bool、字符串之外的类型编译报错
+    template <class T>
+    void addField(const char* key, const T& value);
 
-    std::stringstream& getSS() { return m_ss; }
+    LogStream& getSS() { return m_ss; }
     void format(const char* fmt, ...);
     void format(const char* fmt, va_list al);
+
+    // 取fmt格式化后的文本，多个appender共享同一formatter时只格式化一次
+    // 事件被异步队列共享后不再写缓存，未命中时结果写入调用方的scratch
+    const std::string& getFormatted(const LogFormatter& fmt, std::string& scratch);
+    void setShared() { m_shared = true; }
+private:
+    // time_ns: 纳秒
+    void reset(Logger* logger, LogLevel::Level level, 
+            const char* file, int32_t line, uint32_t elapse, 
+            uint32_t thread_id, uint32_t fiber_id, uint64_t time_ns,
+            const std::string& thread_name);
+    LogField& newField(const char* key, LogField::Type type);
+    void addStringField(const char* key, const char* data, size_t size);
 private:
     const char* m_file = nullptr;
     int32_t m_line = 0;
     uint32_t m_elapse = 0;
     uint32_t m_threadId = 0;
     uint32_t m_fiberId = 0;
-    uint64_t m_time = 0;
-    std::shared_ptr<Logger> m_logger;
+    uint64_t m_time = 0; // 纳秒
+    Logger* m_logger = nullptr;
     LogLevel::Level m_level;
     std::string m_threadName;
+    const LogCallSite* m_site = nullptr;
+    bool m_forced = false;
+
+    LogStream m_ss;
+
+    // 前kInlineFields个字段放在事件内，字符串值拷贝到m_fieldData，都随事件复用
+    static const size_t kInlineFields = 8;
+    LogField m_fields[kInlineFields];
+    std::vector<LogField> m_moreFields;
+    uint32_t m_fieldCount = 0;
+    std::string m_fieldData;
 
-    std::stringstream m_ss;
+    struct FormatCache {
+        uint64_t formatter = 0; // LogFormatter::getId()
+        std::string text;
+    };
+    static const size_t kFormatCacheSize = 2;
+    FormatCache m_cache[kFormatCacheSize];
+    uint8_t m_cacheNext = 0;
+    bool m_shared = false;
 };
 
+template <class T>
+void LogEvent::addField(const char* key, const T& value) {
+    if constexpr (std::is_same<T, bool>::value) {
+        newField(key, LogField::BOOL).b = value;
+    } else if constexpr (std::is_enum<T>::value) {
+        newField(key, LogField::INT).i = (int64_t)value;
+    } else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value) {
+        newField(key, LogField::INT).i = value;
+    } else if constexpr (std::is_integral<T>::value) {
+        newField(key, LogField::UINT).u = value;
+    } else if constexpr (std::is_floating_point<T>::value) {
+        newField(key, LogField::DOUBLE).d = value;
+    } else if constexpr (std::is_convertible<const T&, const char*>::value) {
+        const char* str = value;
+        if (str) {
+            addStringField(key, str, strlen(str));
+        } else {
+            addStringField(key, "(null)", 6);
+        }
+    } else {
+        static_assert(std::is_convertible<const T&, std::string_view>::value,
+                "unsupported log field type");
+        std::string_view str = value;
+        addStringField(key, str.data(), str.size());
+    }
+}
+
+template <class T>
+LogStream& LogStream::kv(const char* key, const T& value) {
+    m_event->addField(key, value);
+    return *this;
+}
+
 class LogEventWrap {
 public:
     LogEventWrap(LogEvent::ptr event);
     ~LogEventWrap();
 
-    std::stringstream& getSS();
+    LogStream& getSS();
     LogEvent::ptr getEvent() { return m_event; }
 private:
     LogEvent::ptr m_event;
 };
 
+// T能否写入std::ostream
+template <class T, class = void>
+struct LogFormatStreamable : std::false_type {};
+template <class T>
+struct LogFormatStreamable<T, std::void_t<
+        decltype(std::declval<std::ostream&>() << std::declval<const T&>())> > : std::true_type {};
+
+// {}风格的格式化，由SYLAR_LOG_FORMAT_*使用
+// 格式串为字面量，编译期按参数类型检查占位符个数和spec，运行时直接写入事件缓冲
+// 支持 {} {:spec} {{ }}，spec为 [<|>][0][width][.precision][type]
+//   整数 d x X o b c，浮点 f e g(不写type时为最短的可还原形式)，字符串 s，指针 p
+//   字符串的precision表示最多输出的字节数；数字默认右对齐，其余左对齐
+// 其它类型通过operator<<输出，只能用{}
+class LogFormat {
+public:
+    enum class Kind : uint8_t {
+        NONE = 0,
+        BOOL,
+        CHAR,
+        INT,
+        FLOAT,
+        STRING,
+        POINTER,
+        STREAM
+    };
+
+    struct Spec {
+        char align = 0;         // '<' '>' 或0(默认)
+        char fill = ' ';
+        uint32_t width = 0;
+        int32_t precision = -1;
+        char type = 0;
+    };
+
+    static const int32_t kMaxPrecision = 500;
+
+    template <class T>
+    static constexpr Kind KindOf() {
+        using U = std::decay_t<T>;
+        if constexpr (std::is_same<U, bool>::value) {
+            return Kind::BOOL;
+        } else if constexpr (std::is_same<U, char>::value) {
+            return Kind::CHAR;
+        } else if constexpr (std::is_integral<U>::value || std::is_enum<U>::value) {
+            return Kind::INT;
+        } else if constexpr (std::is_floating_point<U>::value) {
+            return Kind::FLOAT;
+        } else if constexpr (std::is_same<U, char*>::value || std::is_same<U, const char*>::value
+                || std::is_convertible<const U&, std::string_view>::value) {
+            return Kind::STRING;
+        } else if constexpr (std::is_pointer<U>::value) {
+            return Kind::POINTER;
+        } else if constexpr (LogFormatStreamable<U>::value) {
+            return Kind::STREAM;
+        } else {
+            return Kind::NONE;
+        }
+    }
+
+    // p指向':'之后，成功返回指向'}'的指针，失败返回nullptr
+    static constexpr const char* ParseSpec(const char* p, Spec& spec) {
+        if (*p == '<' || *p == '>') {
+            spec.align = *p++;
+        }
+        if (*p == '0') {
+            spec.fill = '0';
+            ++p;
+        }
+        while (*p >= '0' && *p <= '9') {
+            spec.width = spec.width * 10 + (*p++ - '0');
+        }
+        if (*p == '.') {
+            ++p;
+            if (*p < '0' || *p > '9') {
+                return nullptr;
+            }
+            spec.precision = 0;
+            while (*p >= '0' && *p <= '9' && spec.precision <= kMaxPrecision) {
+                spec.precision = spec.precision * 10 + (*p++ - '0');
+            }
+        }
+        if (*p && *p != '}') {
+            spec.type = *p++;
+        }
+        return *p == '}' ? p : nullptr;
+    }
+
+    static constexpr bool SpecValid(Kind kind, const Spec& spec) {
+        if (spec.precision > kMaxPrecision) {
+            return false;
+        }
+        char t = spec.type;
+        switch (kind) {
+            case Kind::BOOL:
+                return spec.precision < 0 && (t == 0 || t == 's' || t == 'd');
+            case Kind::CHAR:
+            case Kind::INT:
+                return spec.precision < 0 && (t == 0 || t == 'd' || t == 'x' || t == 'X'
+                        || t == 'o' || t == 'b' || t == 'c');
+            case Kind::FLOAT:
+                return t == 0 || t == 'f' || t == 'e' || t == 'g';
+            case Kind::STRING:
+                return t == 0 || t == 's';
+            case Kind::POINTER:
+                return spec.precision < 0 && (t == 0 || t == 'p');
+            case Kind::STREAM:
+                return t == 0 && spec.precision < 0 && spec.width == 0
+                    && spec.align == 0 && spec.fill == ' ';
+            default:
+                return false;
+        }
+    }
+
+    // 格式串与参数类型是否匹配
+    template <class... Args>
+    static constexpr bool Check(const char* fmt) {
+        constexpr Kind kinds[] = {KindOf<Args>()..., Kind::NONE};
+        size_t n = 0;
+        for (const char* p = fmt; *p; ++p) {
+            if (*p == '{') {
+                if (p[1] == '{') {
+                    ++p;
+                    continue;
+                }
+                if (n >= sizeof...(Args)) {
+                    return false;
+                }
+                Spec spec;
+                if (p[1] == '}') {
+                    ++p;
+                } else if (p[1] == ':') {
+                    p = ParseSpec(p + 2, spec);
+                    if (!p) {
+                        return false;
+                    }
+                } else {
+                    return false; // 不支持按位置或名字引用参数
+                }
+                if (!SpecValid(kinds[n], spec)) {
+                    return false;
+                }
+                ++n;
+            } else if (*p == '}') {
+                if (p[1] != '}') {
+                    return false;
+                }
+                ++p;
+            }
+        }
+        return n == sizeof...(Args);
+    }
+
+    // 格式串须已通过Check
+    template <class... Args>
+    static void Write(LogStream& ss, const char* fmt, const Args&... args) {
+        Spec spec;
+        const char* p = fmt;
+        ((p = NextArg(ss.buf(), p, spec), WriteValue(ss, spec, args)), ...);
+        NextArg(ss.buf(), p, spec);
+    }
+
+private:
+    // 追加下一个占位符之前的常量部分并解析其spec，返回占位符之后的位置
+    static const char* NextArg(LogStreamBuf& buf, const char* p, Spec& spec);
+    static void WriteInt(LogStreamBuf& buf, const Spec& spec, uint64_t v, bool neg);
+    // long double按double输出
+    static void WriteFloat(LogStreamBuf& buf, const Spec& spec, double v);
+    static void WriteString(LogStreamBuf& buf, const Spec& spec, const char* data, size_t size);
+
+    template <class T>
+    static void WriteValue(LogStream& ss, const Spec& spec, const T& v) {
+        constexpr Kind kind = KindOf<T>();
+        if constexpr (kind == Kind::BOOL) {
+            if (spec.type == 'd') {
+                WriteInt(ss.buf(), spec, v, false);
+            } else {
+                WriteString(ss.buf(), spec, v ? "true" : "false", v ? 4 : 5);
+            }
+        } else if constexpr (kind == Kind::CHAR) {
+            if (spec.type == 0 || spec.type == 'c') {
+                WriteString(ss.buf(), spec, &v, 1);
+            } else {
+                WriteInt(ss.buf(), spec, (uint8_t)v, false);
+            }
+        } else if constexpr (kind == Kind::INT) {
+            if constexpr (std::is_enum<T>::value) {
+                WriteValue(ss, spec, (std::underlying_type_t<T>)v);
+            } else if constexpr (std::is_signed<T>::value) {
+                if (spec.type == 'c') {
+                    char c = (char)v;
+                    WriteString(ss.buf(), spec, &c, 1);
+                } else {
+                    WriteInt(ss.buf(), spec, v < 0 ? 0 - (uint64_t)v : (uint64_t)v, v < 0);
+                }
+            } else {
+                if (spec.type == 'c') {
+                    char c = (char)v;
+                    WriteString(ss.buf(), spec, &c, 1);
+                } else {
+                    WriteInt(ss.buf(), spec, v, false);
+                }
+            }
+        } else if constexpr (kind == Kind::FLOAT) {
+            WriteFloat(ss.buf(), spec, (double)v);
+        } else if constexpr (kind == Kind::STRING) {
+            if constexpr (std::is_convertible<const T&, std::string_view>::value
+                    && !std::is_pointer<std::decay_t<T> >::value) {
+                std::string_view str = v;
+                WriteString(ss.buf(), spec, str.data(), str.size());
+            } else {
+                const char* str = v;
+                if (str) {
+                    WriteString(ss.buf(), spec, str, strlen(str));
+                } else {
+                    WriteString(ss.buf(), spec, "(null)", 6);
+                }
+            }
+        } else if constexpr (kind == Kind::POINTER) {
+            Spec hex = spec;
+            hex.type = 'p';
+            WriteInt(ss.buf(), hex, (uintptr_t)v, false);
+        } else {
+            ss << v;
+        }
+    }
+};
+
 /*
 %m -- message
 %p -- level
@@ -140,42 +737,91 @@ private:
 %r -- time after launch
 %c -- name of log
 %t -- thread id
-%d -- time
+%d -- time, %d{ms} %d{us} %d{ns} or %d{strftime_fmt|ms} appends sub-second digits
 %f -- file name
 %l -- line number
 %T -- Tab
 %F -- Fiber id
 %N -- Thread name
+%K -- structured fields, " key=value" for each
 */
 class LogFormatter {
 public:
     using ptr = std::shared_ptr<LogFormatter>;
     LogFormatter(const std::string& pattern);
+    virtual ~LogFormatter() {}
 
-    std::string format(LogEvent::ptr event);
+    // pattern为"json"时创建JsonLogFormatter，供配置使用
+    static LogFormatter::ptr Create(const std::string& pattern);
 
-    class FormatItem {
-    public:
-        using ptr = std::shared_ptr<FormatItem>;
-        // FormatItem(/*const std::string& fmt = ""*/) {}
-        virtual ~FormatItem() {}
-        virtual void format(std::ostream& os, LogEvent::ptr event) = 0;
-    };
+    std::string format(LogEvent::ptr event);
+    // 按编译好的执行计划追加到out，out由调用方持有并复用
+    virtual void format(const LogEvent& event, std::string& out) const;
 
     void init();
 
     bool isError() const { return m_error; }
 
     const std::string& getPattern() const { return m_pattern; }
+    // 进程内唯一，用作LogEvent格式化缓存的key
+    uint64_t getId() const { return m_id; }
+protected:
+    enum class OpCode : uint8_t {
+        LITERAL = 0,        // 常量字符串，包括%T %n
+        MESSAGE,
+        LEVEL,
+        COLOR_LEVEL,
+        ELAPSE,
+        NAME,
+        THREAD_ID,
+        FIBER_ID,
+        THREAD_NAME,
+        DATETIME,
+        FILENAME,
+        FILENAME_SHORT,     // %f{s}
+        FILENAME_RELATIVE,  // %f{r}
+        LINE,
+        FIELDS
+    };
+
+    struct Op {
+        OpCode code;
+        std::string arg;    // 常量内容或子格式
+        uint32_t num = 0;   // DATETIME: 秒以下的位数(0/3/6/9)
+    };
+
+    void appendDateTime(std::string& out, const Op& op, size_t index, uint64_t ns) const;
+
 private:
     std::string m_pattern;
-    std::vector<FormatItem::ptr> m_items;
+    std::vector<Op> m_ops;
+    uint64_t m_id = 0;
     bool m_error = false;
 
 };
 
+// 每条日志输出一行JSON，结构化字段作为同级的key
+// {"time":"2024-01-01 12:00:00.123","level":"INFO","logger":"root","thread":1,
+//  "thread_name":"main","fiber":0,"file":"a.cc","line":10,"msg":"...","user":42}
+// 字符串直接转义写入输出缓冲，SSE2下每次检查16字节，不含需转义字符时整段拷贝
+// 非ASCII字节原样输出，不校验UTF-8
+class JsonLogFormatter : public LogFormatter {
+public:
+    using ptr = std::shared_ptr<JsonLogFormatter>;
+    JsonLogFormatter();
+
+    void format(const LogEvent& event, std::string& out) const override;
+
+    // 转义后追加，不含两侧引号
+    static void AppendEscaped(std::string& out, const char* data, size_t size);
+private:
+    Op m_time;
+};
+
 
 class LogAppender {
+    friend class LogTimer;
+    friend class Logger;
 public:
     using ptr = std::shared_ptr<LogAppender>;
     using MutexType = LogMutex;
@@ -183,30 +829,53 @@ public:
 
     virtual void log(LogEvent::ptr event) = 0;
     virtual std::string toYamlString() const = 0;
+    // 将已缓冲的日志写出，默认无缓冲
+    virtual void flush() {}
 
-    void setFormatter(LogFormatter::ptr val);
+    virtual void setFormatter(LogFormatter::ptr val);
     LogFormatter::ptr getFormatter() const;
 
-    void setLevel(LogLevel::Level level) { m_level = level; }
-    LogLevel::Level getLevel() const { return m_level; }
+    // 同时更新使用该appender的logger的生效级别
+    void setLevel(LogLevel::Level level);
+    LogLevel::Level getLevel() const { return m_level.load(std::memory_order_relaxed); }
 
     bool hasFormatter() const { MutexType::Lock lock(m_mutex); return m_has_formatter; }
 protected:
-    LogLevel::Level m_level = LogLevel::DEBUG;
+    // 达到appender级别，或由调用点开关放行
+    bool accept(const LogEvent& event) const {
+        return event.getLevel() >= getLevel() || event.isForced();
+    }
+    // 由后台定时器线程约每100ms调用一次，用于按时间写出缓冲；now_ms取自GetMonotonicMS
+    // 子类在构造时AddTimer(this)，析构时DelTimer(this)
+    virtual void onTimer(uint64_t /*now_ms*/) {}
+    static void AddTimer(LogAppender* appender);
+    static void DelTimer(LogAppender* appender);
+protected:
+    std::atomic<LogLevel::Level> m_level {LogLevel::DEBUG};
     LogFormatter::ptr m_formatter;
 	mutable MutexType m_mutex;
     bool m_has_formatter = false;
+    std::string m_buffer; // 格式化缓冲，由m_mutex保护
+private:
+    std::vector<Logger*> m_loggers; // 添加了本appender的logger，由m_mutex保护
 };
 
 
+// appender列表是不可变快照，增删时整体替换，旧快照经Epoch延迟释放
+// log()只做一次原子读取，不持有Logger的锁；m_mutex只串行化修改
 class Logger : public std::enable_shared_from_this<Logger> {
     friend class LoggerManager;
+    friend class LogAppender;
 public:
     using ptr = std::shared_ptr<Logger>;
     using MutexType = LogMutex;
+    using AppenderList = std::vector<LogAppender::ptr>;
     Logger(const std::string& name = "root");
+    ~Logger();
 
     void log(LogEvent::ptr event);
+    // flush所有appender，没有appender时flush root
+    void flush();
 
     // void log(LogLevel::Level level, LogEvent::ptr event);
 
@@ -219,10 +888,20 @@ public:
     void addAppender(LogAppender::ptr appender);
     void delAppender(LogAppender::ptr appender);
     void clearAppenders();
-    std::list<LogAppender::ptr> getAppenders() { return m_appenders; }
+    std::list<LogAppender::ptr> getAppenders() const;
 
-    LogLevel::Level getLevel() const { return m_level; }
-    void setLevel(LogLevel::Level level) { m_level = level; }
+    // 生效的级别，继承的级别在设置时已算好
+    LogLevel::Level getLevel() const { return m_level.load(std::memory_order_relaxed); }
+    // 带'.'的logger设为UNKNOW时继承父logger的级别，修改会向下更新继承它的子logger
+    void setLevel(LogLevel::Level level);
+    // 低于该级别的日志不会被任何appender输出，宏据此在构造LogEvent前过滤
+    // 取自身级别与appender级别最小值中的较大者，没有appender时用root的生效级别
+    // 开启二进制日志时等于自身级别
+    LogLevel::Level getEffectiveLevel() const { return m_effectiveLevel.load(std::memory_order_relaxed); }
+
+    // 低于级别但匹配规则的调用点仍输出到本logger，规则未命中的调用点无额外开销
+    void setDebugSites(const std::vector<LogSiteRule>& rules);
+    std::vector<LogSiteRule> getDebugSites() const;
 
     const std::string& getName() const { return m_name; }
 
@@ -230,11 +909,57 @@ public:
     void setFormatter(const std::string& val);
     LogFormatter::ptr getFormatter() const;
 
+    // 开启后SYLAR_LOG_FMT_*写入BinaryLog，须先BinaryLog::GetInstance()->open()
+    // 流式的SYLAR_LOG_*不受影响，仍交给appender
+    void setBinary(bool v);
+    bool isBinary() const { return getBinaryId() != 0; }
+    uint32_t getBinaryId() const { return m_binaryId.load(std::memory_order_relaxed); }
+
+    // 令牌桶限流，每秒rate条，最多突发burst条，rate为0表示不限
+    // 超出的日志在构造LogEvent前丢弃，丢弃数附在下一条输出的日志末尾
+    void setRateLimit(uint32_t rate, uint32_t burst = 0);
+    uint32_t getRateLimit() const { return m_rate.load(std::memory_order_relaxed); }
+    uint32_t getBurst() const { return m_burst.load(std::memory_order_relaxed); }
+    // 未限流时只有一次relaxed读
+    bool checkRate() {
+        return m_rateInterval.load(std::memory_order_relaxed) == 0 || acquireToken();
+    }
+    // 取走限流丢弃的次数
+    uint64_t takeSuppressed() {
+        return m_suppressed.load(std::memory_order_relaxed)
+            ? m_suppressed.exchange(0, std::memory_order_relaxed) : 0;
+    }
+
     std::string toYamlString() const;
+private:
+    bool acquireToken();
+    // 须持有层级锁
+    void updateLevelNoLock();
+    // 须持有m_mutex，返回旧表，由调用方解锁后交给Epoch::retire
+    const AppenderList* setAppendersNoLock(const AppenderList* list);
+    // 由调用点开关放行的事件是否匹配本logger的规则
+    bool matchDebugSite(const LogEvent& event) const;
+    // 级别、appender或其级别变化后调用
+    void updateEffectiveLevel();
+    void updateEffectiveLevelNoLock();
 private:
     std::string m_name;
-    LogLevel::Level m_level; // when level >= m_level, log
-    std::list<LogAppender::ptr> m_appenders;
+    std::atomic<LogLevel::Level> m_level; // when level >= m_level, log
+    std::atomic<LogLevel::Level> m_effectiveLevel;
+    LogLevel::Level m_ownLevel;         // 自身设置的级别，UNKNOW表示继承
+    Logger* m_parent = nullptr;         // 名字去掉最后一段的logger，由LoggerManager持有
+    std::vector<Logger*> m_children;
+    std::vector<Logger*> m_fallbacks;   // 以本logger为m_root的logger
+    std::atomic<uint32_t> m_binaryId {0};
+    // 令牌桶按GCRA实现: m_tat为理论到达时间(ns)，每条日志推后m_rateInterval
+    std::atomic<uint32_t> m_rate {0};
+    std::atomic<uint32_t> m_burst {0};
+    std::atomic<uint64_t> m_rateInterval {0};
+    std::atomic<uint64_t> m_rateTolerance {0};
+    std::atomic<uint64_t> m_tat {0};
+    std::atomic<uint64_t> m_suppressed {0};
+    std::atomic<const AppenderList*> m_appenders;
+    std::vector<LogSiteRule> m_debugSites; // m_mutex保护
     LogFormatter::ptr m_formatter; 
     mutable MutexType m_mutex;
     Logger::ptr m_root;
@@ -248,28 +973,584 @@ public:
 private:
 };
 
+// FileLogAppender的稀疏时间索引，与日志文件同名加.idx后缀
+// 16字节文件头(magic, 间隔)后是定长条目，只追加
+// 条目在它指向的记录写出后才写出，崩溃后不会指向不存在的数据；不完整的末尾条目在重新打开时截掉
+struct FileLogIndex {
+    static const uint64_t kMagic = 0x5844494c59533130; // "01SYLIDX"
+    static const size_t kEntrySize = 16;
+
+    struct Entry {
+        uint64_t time_ms;   // 该偏移处记录的时间，不小于前一条目
+        uint64_t offset;
+    };
+
+    static std::string IndexFile(const std::string& filename) { return filename + ".idx"; }
+    // 读取filename的索引，丢弃不完整、乱序或超出日志长度的条目；没有索引或索引无效时返回false
+    // max_size为调用方已映射或已读取的长度，日志仍在增长时避免条目指向其后
+    static bool Load(const std::string& filename, std::vector<Entry>& entries,
+            uint64_t max_size = UINT64_MAX);
+};
+
+// 文件日志输出器
+// 记录先写入用户态缓冲，缓冲满、ERROR及以上级别、或距上次写出超过flush_interval时才write
+// 支持按大小/按小时/按天轮转，轮转后的文件为 file.1 file.2 ...(数字越大越旧)
 class FileLogAppender : public LogAppender {
 public:
     using ptr = std::shared_ptr<FileLogAppender>;
+
+    enum class RotateType {
+        NONE = 0,
+        HOURLY,
+        DAILY
+    };
+
+    static const size_t kDefaultBufferSize = 64 * 1024;
+    static const uint64_t kDefaultFlushInterval = 1000; // ms
+
     FileLogAppender(const std::string& filename);
     ~FileLogAppender();
     void log(LogEvent::ptr event) override;
     std::string toYamlString() const override; 
+    void flush() override;
+
+    // append=false时截断文件
+    bool reopen(bool append = true);
 
-    bool reopen(std::ios_base::openmode openmode = std::ios::out);
+    const std::string& getFilename() const { return m_filename; }
+
+    // 以下参数与定时器线程共享，读写都持有m_mutex
+    // 0表示不缓冲，每条记录直接write
+    void setBufferSize(size_t v);
+    size_t getBufferSize() const { MutexType::Lock lock(m_mutex); return m_bufferSize; }
+    void setFlushInterval(uint64_t ms);
+    uint64_t getFlushInterval() const { MutexType::Lock lock(m_mutex); return m_flushInterval; }
+    // 超过该字节数时轮转，0不按大小轮转
+    void setMaxSize(uint64_t v);
+    uint64_t getMaxSize() const { MutexType::Lock lock(m_mutex); return m_maxSize; }
+    void setRotateType(RotateType v);
+    RotateType getRotateType() const { MutexType::Lock lock(m_mutex); return m_rotateType; }
+    // 保留的轮转文件数，0表示全部保留
+    void setMaxFiles(uint32_t v);
+    uint32_t getMaxFiles() const { MutexType::Lock lock(m_mutex); return m_maxFiles; }
+    // 每写入约v字节在索引中记一个条目，0不写索引；轮转时索引随日志文件一起改名
+    void setIndexInterval(uint64_t v);
+    uint64_t getIndexInterval() const { MutexType::Lock lock(m_mutex); return m_indexInterval; }
+
+    static RotateType StringToRotateType(const std::string& str);
+    static const char* RotateTypeToString(RotateType type);
+
+    // 安装SIGHUP处理函数(只安装一次)
+    // 收到信号后所有FileLogAppender在下次写入或定时器到期时重新打开文件，配合外部logrotate使用
+    static void InstallSighupHandler();
+
+protected:
+    void onTimer(uint64_t now_ms) override;
+
+private:
+    bool reopenNoLock(bool append);
+    void flushNoLock();
+    void writeNoLock(const char* data, size_t len);
+    void rotateNoLock(uint64_t now_sec);
+    void checkReopenNoLock();
+    uint64_t nextRotateTime(uint64_t now_sec) const;
+    bool openIndexNoLock(bool truncate);
+    void closeIndexNoLock();
+
+private:
+    std::string m_filename;
+    int m_fd = -1;
+    std::string m_writeBuf;
+    size_t m_bufferSize = kDefaultBufferSize;
+    uint64_t m_flushInterval = kDefaultFlushInterval;
+    uint64_t m_lastFlush = 0;       // GetMonotonicMS
+    uint64_t m_fileSize = 0;        // 含缓冲中未写出的部分
+    uint64_t m_maxSize = 0;
+    RotateType m_rotateType = RotateType::NONE;
+    uint64_t m_nextRotate = 0;      // 下次按时间轮转的时刻(秒)
+    uint32_t m_maxFiles = 0;
+    uint64_t m_reopenGen = 0;
+    int m_indexFd = -1;
+    uint64_t m_indexInterval = 0;
+    uint64_t m_nextIndex = 0;       // 下一个条目的最小偏移
+    uint64_t m_lastIndexTime = 0;   // ms
+    std::string m_indexBuf;         // 等数据写出后再写的条目
+};
+
+// 内存映射文件日志输出器
+// 文件按segment_size用fallocate预分配后mmap，记录直接memcpy进映射区，不经过write
+// 文件末尾kTrailerSize字节为trailer，记录已提交长度；进程崩溃最多丢失正在写的一条
+// 重新打开时若发现trailer则截断到已提交长度，正常析构时同样截断，留下纯文本文件
+// 运行中文件尾部是预分配的0字节和trailer，tail -f等工具会看到它们
+class MmapFileLogAppender : public LogAppender {
+public:
+    using ptr = std::shared_ptr<MmapFileLogAppender>;
+
+    static const size_t kDefaultSegmentSize = 32 * 1024 * 1024;
+    static const size_t kTrailerSize = 16;
+    static const uint64_t kTrailerMagic = 0x4c4f474d4d415031; // "LOGMMAP1"
+
+    MmapFileLogAppender(const std::string& filename, size_t segment_size = kDefaultSegmentSize);
+    ~MmapFileLogAppender();
+    void log(LogEvent::ptr event) override;
+    std::string toYamlString() const override;
+    // msync(MS_ASYNC)，只针对掉电；进程崩溃时页缓存里的数据不会丢
+    void flush() override;
 
     const std::string& getFilename() const { return m_filename; }
+    size_t getSegmentSize() const { return m_segmentSize; }
+    // 已提交的字节数，即截断后的文件长度
+    uint64_t getCommitted() const { return m_committed; }
+
+    // 按trailer截断一个未正常关闭的文件，返回截断后的长度，失败返回-1
+    static int64_t Recover(const std::string& filename);
+
+private:
+    bool openNoLock();
+    void closeNoLock();
+    // 保证从m_committed起至少还能写入len字节
+    bool growNoLock(size_t len);
+    void writeTrailerNoLock();
+
 private:
     std::string m_filename;
-    std::ofstream m_filestream;
-    uint64_t m_lastTime;
+    size_t m_segmentSize;
+    int m_fd = -1;
+    char* m_map = nullptr;
+    uint64_t m_mapOffset = 0;   // 映射区在文件中的起始偏移(页对齐)
+    uint64_t m_mapSize = 0;
+    uint64_t m_fileSize = 0;    // 含预分配部分和trailer
+    uint64_t m_committed = 0;
+};
+
+// 飞行记录器，最近的日志按线程写入各自定长的内存环，不做I/O
+// FATAL日志、SYLAR_ASSERT失败或致命信号时把所有环写到dump文件
+// 典型用法: logger设为DEBUG，其它appender设为INFO，DEBUG上下文只留在内存里
+// dump只用open/write，可在信号处理函数中调用；写入中的线程可能让dump中最后一条不完整
+// 线程退出后它的环保留到被新线程复用，dump时仍能看到
+class RingBufferLogAppender : public LogAppender {
+public:
+    using ptr = std::shared_ptr<RingBufferLogAppender>;
+
+    static const size_t kDefaultRingSize = 64 * 1024;
+    // 信号处理函数中能遍历到的实例数，超出的实例不参与DumpAll
+    static const size_t kMaxInstances = 8;
+
+    // ring_size向上取整为2的幂
+    RingBufferLogAppender(const std::string& dump_file, size_t ring_size = kDefaultRingSize);
+    ~RingBufferLogAppender();
+    void log(LogEvent::ptr event) override;
+    std::string toYamlString() const override;
+    void setFormatter(LogFormatter::ptr val) override;
+
+    const std::string& getDumpFile() const { return m_dumpFile; }
+    size_t getRingSize() const { return m_ringSize; }
+
+    // 覆盖写dump文件，返回写入的字节数，失败返回-1；async-signal-safe
+    int64_t dump(const char* reason);
+
+    // 所有实例各dump一次，Logger收到FATAL和SYLAR_ASSERT失败时调用
+    static void DumpAll(const char* reason);
+    // SIGSEGV SIGBUS SIGFPE SIGILL SIGABRT时DumpAll，之后恢复原来的处理方式重新触发(只安装一次)
+    static void InstallSignalHandlers();
+
+private:
+    struct Ring;
+    struct ThreadRings;
+    Ring* getRing();
+    Ring* acquireRing();
+
+private:
+    std::string m_dumpFile;
+    size_t m_ringSize;
+    uint64_t m_id;                              // 进程内唯一，用于线程缓存
+    std::atomic<LogFormatter*> m_current {nullptr}; // m_formatter的裸指针，旧的经Epoch释放
+    std::atomic<Ring*> m_rings {nullptr};       // 只增不减，dump时无锁遍历
+    std::atomic_flag m_dumping = ATOMIC_FLAG_INIT;
+};
+
+// 数据报日志输出器，发往本机的日志收集进程，避免先写文件再tail
+// 地址为 unix:/path(Unix数据报socket) 或 udp:host:port
+// 每条记录一个RFC5424报文: <PRI>1 时间 主机名 app_name 进程id logger名 - 格式化后的日志(去掉末尾换行)
+// 记录先攒成一批，满batch_size条、ERROR及以上或超过flush_interval时用一次sendmmsg发出
+// socket非阻塞，接收方来不及读或不存在时整批剩余记录丢弃并计数，发送恢复后补发一条丢弃数提示
+class SocketLogAppender : public LogAppender {
+public:
+    using ptr = std::shared_ptr<SocketLogAppender>;
+
+    static const size_t kDefaultBatchSize = 64;
+    static const uint64_t kDefaultFlushInterval = 1000; // ms
+    static const uint32_t kDefaultFacility = 1;         // user-level
+    static const size_t kMaxMessageSize = 8192;         // 超出的部分截断
+
+    SocketLogAppender(const std::string& address, const std::string& app_name = "sylar",
+            uint32_t facility = kDefaultFacility);
+    ~SocketLogAppender();
+    void log(LogEvent::ptr event) override;
+    std::string toYamlString() const override;
+    void flush() override;
+
+    const std::string& getAddress() const { return m_address; }
+    const std::string& getAppName() const { return m_appName; }
+    uint32_t getFacility() const { return m_facility; }
+    // 1表示不攒批，每条记录直接发送
+    void setBatchSize(size_t v);
+    size_t getBatchSize() const { MutexType::Lock lock(m_mutex); return m_batchSize; }
+    void setFlushInterval(uint64_t ms);
+    uint64_t getFlushInterval() const { MutexType::Lock lock(m_mutex); return m_flushInterval; }
+
+    // 已发出和已丢弃的记录数
+    uint64_t getSent() const { return m_sent.load(std::memory_order_relaxed); }
+    uint64_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    // RFC5424的severity
+    static int ToSeverity(LogLevel::Level level);
+protected:
+    void onTimer(uint64_t now_ms) override;
+
+private:
+    bool connectNoLock();
+    void appendNoLock(int severity, uint64_t time_ns, const std::string& msgid,
+            const char* msg, size_t len);
+    void flushNoLock();
+
+private:
+    std::string m_address;
+    std::string m_appName;
+    uint32_t m_facility;
+    std::string m_hostname;
+    std::string m_pid;
+    int m_fd = -1;
+    uint64_t m_lastConnect = 0;     // ms，连接失败后每个flush_interval重试一次
+    std::string m_batchBuf;
+    std::vector<std::pair<size_t, size_t> > m_records; // 每条记录在m_batchBuf中的偏移和长度
+    size_t m_batchSize = kDefaultBatchSize;
+    uint64_t m_flushInterval = kDefaultFlushInterval;
+    uint64_t m_lastFlush = 0;       // GetMonotonicMS
+    uint64_t m_reported = 0;        // 已发出提示的丢弃数
+    std::atomic<uint64_t> m_sent {0};
+    std::atomic<uint64_t> m_dropped {0};
+};
+
+// 共享内存中的日志环(多线程生产、单消费)，由shm_open创建，位于/dev/shm，生产者与消费者进程都映射它
+// 生产者(ShmLogAppender)原子地预留空间后写入并提交，不做任何I/O，环满时丢弃并计数
+// 同一时刻只允许一个存活的生产者进程(owner)：预留后还没写入记录头就崩溃时，
+// 消费者只能靠owner判断预留者已死并丢弃到预留位置，多个生产者进程无法区分
+// 消费者(sylar_logd)按顺序取出已提交的记录写盘
+// 进程崩溃时已提交的记录仍在共享内存中，由消费者继续写出；正在写的那条丢失
+class ShmLogRing {
+public:
+    using ptr = std::shared_ptr<ShmLogRing>;
+
+    static const size_t kDefaultSize = 4 * 1024 * 1024;
+    static const size_t kHeaderSize = 4096;
+    static const uint64_t kMagic = 0x474e49524c485331; // "1SHLRING"
+
+    // 打开或创建，size向上取整为2的幂；已存在时沿用原有大小
+    static ShmLogRing::ptr Open(const std::string& name, size_t size = kDefaultSize);
+    static bool Unlink(const std::string& name);
+    ~ShmLogRing();
+
+    // 生产者，owner进程内可多线程并发调用；放不下时丢弃并返回false
+    bool write(const char* data, size_t len);
+    // 生产者写入前调用，登记pid为owner供消费者判断生产者是否存活
+    // 已有其它存活的owner时失败
+    bool setOwner(pid_t pid);
+    pid_t getOwner() const;
+
+    // 消费者，只能有一个；按顺序把已提交的记录交给cb，遇到未提交的记录即停，返回取出的记录数
+    size_t read(const std::function<void(const char* data, size_t len)>& cb);
+    // 消费者，read()卡在未提交的记录上且写入它的进程已不存在时跳过它，返回是否跳过
+    bool skipDead();
+    // 已预留的空间全部被取出
+    bool empty() const;
+
+    const std::string& getName() const { return m_name; }
+    size_t getCapacity() const { return m_capacity; }
+    // 单条记录的最大长度，超出的部分截断
+    size_t getMaxRecord() const { return m_capacity / 4; }
+    uint64_t getDropped() const;
+
+private:
+    struct Header;
+    ShmLogRing() {}
+    std::atomic<uint64_t>& recordHeader(uint64_t pos) const {
+        return *reinterpret_cast<std::atomic<uint64_t>*>(m_data + (pos & (m_capacity - 1)));
+    }
+
+private:
+    std::string m_name;
+    int m_fd = -1;
+    Header* m_header = nullptr;
+    char* m_data = nullptr;
+    size_t m_capacity = 0;
+    pid_t m_pid = 0;
+
+private:
+    SYLAR_DISABLE_COPY(ShmLogRing)
 };
 
+// 写共享内存日志环的输出器，由独立的sylar_logd进程写盘，请求路径不受磁盘抖动影响
+// 格式化在本进程完成，环中是最终文本
+class ShmLogAppender : public LogAppender {
+public:
+    using ptr = std::shared_ptr<ShmLogAppender>;
+    ShmLogAppender(const std::string& name, size_t size = ShmLogRing::kDefaultSize);
+    void log(LogEvent::ptr event) override;
+    std::string toYamlString() const override;
+
+    // 打开失败时为nullptr，日志被丢弃
+    ShmLogRing::ptr getRing() const { return m_ring; }
+    const std::string& getName() const { return m_name; }
+
+private:
+    std::string m_name;
+    size_t m_size;
+    ShmLogRing::ptr m_ring;
+};
+
+// 异步日志输出器
+// log()只把事件放入有界无锁队列，由专用线程取出后交给sink(File/Stdout)格式化并写出
+class AsyncLogAppender : public LogAppender {
+public:
+    using ptr = std::shared_ptr<AsyncLogAppender>;
+
+    // 队列满时的处理策略
+    enum class OverflowPolicy {
+        BLOCK = 0,      // 等待后台线程腾出空间
+        DROP_NEWEST,    // 丢弃当前事件
+        DROP_OLDEST     // 丢弃队列中最旧的事件
+    };
+
+    AsyncLogAppender(LogAppender::ptr sink, size_t capacity = 8192,
+            OverflowPolicy policy = OverflowPolicy::BLOCK);
+    ~AsyncLogAppender();
+
+    void log(LogEvent::ptr event) override;
+    std::string toYamlString() const override;
+    // 等待调用前已入队的事件全部写出，再flush sink
+    void flush() override;
+
+    void setFormatter(LogFormatter::ptr val) override;
+
+    LogAppender::ptr getSink() const { return m_sink; }
+    size_t getCapacity() const;
+    OverflowPolicy getPolicy() const { return m_policy; }
+    // 因队列满被丢弃的事件数
+    uint64_t getDropped() const;
+
+    static OverflowPolicy StringToPolicy(const std::string& str);
+    static const char* PolicyToString(OverflowPolicy policy);
+private:
+    struct Context;
+    static void Run(std::shared_ptr<Context> ctx);
+    void wakeup();
+
+private:
+    LogAppender::ptr m_sink;
+    OverflowPolicy m_policy;
+    // 队列及计数由后台线程共同持有，保证appender在后台线程上析构时也是安全的
+    std::shared_ptr<Context> m_ctx;
+    Thread::ptr m_thread;
+};
+
+// 二进制日志参数按printf默认实参提升归一化，再按类型原样编码
+inline int32_t BinaryLogValue(int v) { return v; }
+inline uint32_t BinaryLogValue(unsigned int v) { return v; }
+inline int64_t BinaryLogValue(long v) { return v; }
+inline int64_t BinaryLogValue(long long v) { return v; }
+inline uint64_t BinaryLogValue(unsigned long v) { return v; }
+inline uint64_t BinaryLogValue(unsigned long long v) { return v; }
+inline double BinaryLogValue(double v) { return v; }
+inline long double BinaryLogValue(long double v) { return v; }
+inline const char* BinaryLogValue(const char* v) { return v; }
+inline const void* BinaryLogValue(const void* v) { return v; }
+
+template <typename T> struct BinaryLogType;
+template <> struct BinaryLogType<int32_t> { static constexpr char value = 'i'; };
+template <> struct BinaryLogType<uint32_t> { static constexpr char value = 'u'; };
+template <> struct BinaryLogType<int64_t> { static constexpr char value = 'l'; };
+template <> struct BinaryLogType<uint64_t> { static constexpr char value = 'L'; };
+template <> struct BinaryLogType<double> { static constexpr char value = 'd'; };
+template <> struct BinaryLogType<long double> { static constexpr char value = 'D'; };
+template <> struct BinaryLogType<const char*> { static constexpr char value = 's'; };
+template <> struct BinaryLogType<const void*> { static constexpr char value = 'p'; };
+
+// 调用点的参数类型串，如 "isd"
+template <typename... T>
+struct BinaryLogSignature {
+    static constexpr char value[] = {BinaryLogType<T>::value..., '\0'};
+};
+
+template <typename T>
+inline size_t BinaryLogArgSize(T v) { return sizeof(v); }
+// 字符串为 uint32长度 + 内容，nullptr长度为UINT32_MAX
+inline size_t BinaryLogArgSize(const char* v) { return sizeof(uint32_t) + (v ? strlen(v) : 0); }
+
+template <typename T>
+inline char* BinaryLogArgEncode(char* p, T v) {
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+}
+
+inline char* BinaryLogArgEncode(char* p, const char* v) {
+    uint32_t len = v ? strlen(v) : UINT32_MAX;
+    memcpy(p, &len, sizeof(len));
+    p += sizeof(len);
+    if (v) {
+        memcpy(p, v, len);
+        p += len;
+    }
+    return p;
+}
+
+// 二进制日志(延迟格式化)
+// 调用点首次执行时注册描述符(文件、行号、格式串、参数类型)，之后每条日志只把原始参数写入
+// 线程本地的暂存环形缓冲，由后台线程批量写入文件，sylar_logdecode离线还原为文本
+// 文件格式: "SYLARBL1" 后接若干块，每块 uint8类型 + uint32长度 + 内容
+//   SITE    uint32 id, uint32 line, uint8 level, str file, str func, str fmt, str signature
+//   LOGGER  uint32 id, str name
+//   THREAD  uint32 tid, str name
+//   RECORDS uint32 tid, 若干条记录(kRecordHeaderSize字节头部 + 参数)
+//           level带kSuppressedFlag时头部后先跟uint64 suppressed，解码时同文本日志追加"[suppressed N]"
+// 格式串须为字符串字面量(const char数组)，指针或可写缓冲内容可能改变，退回文本日志
+class BinaryLog {
+public:
+    using MutexType = Mutex;
+
+    enum BlockType {
+        SITE = 1,
+        LOGGER = 2,
+        THREAD = 3,
+        RECORDS = 4
+    };
+
+    static const char kMagic[8];
+    // uint32 size, uint32 site, uint32 logger, uint32 fiber, uint64 time(ns), uint8 level
+    static const size_t kRecordHeaderSize = 25;
+    static const uint8_t kSuppressedFlag = 0x80;
+    // 每线程暂存区，超过一半的记录退回文本日志
+    static const size_t kBufferSize = 1024 * 1024;
+
+    // 不析构，open()时注册atexit写完剩余记录
+    static BinaryLog* GetInstance();
+
+    // 截断并打开文件；已打开其它文件时失败
+    bool open(const std::string& filename);
+    // 写完暂存区中的记录并关闭，之后二进制logger退回文本日志
+    void close();
+    // 等待调用前提交的记录写入文件
+    void flush();
+    bool isOpen() const { return m_open.load(std::memory_order_acquire); }
+    std::string getFilename() const;
+
+    // 同名logger得到相同id
+    uint32_t registerLogger(const std::string& name);
+
+    // 低于logger级别、由调用点开关放行的事件走文本路径，由Logger::log匹配本logger的规则
+    template <typename F>
+    static bool Enabled(Logger* logger, const LogCallSite& site, LogLevel::Level level,
+            F&& fmt) {
+        using T = std::remove_reference_t<F>;
+        if constexpr (std::is_array_v<T> && std::is_const_v<std::remove_extent_t<T> >) {
+            return logger->getBinaryId() && fmt == site.getFormat()
+                && level >= logger->getEffectiveLevel();
+        } else {
+            return false;
+        }
+    }
+
+    template <typename... Args>
+    static void Write(Logger* logger, const LogCallSite& site, LogLevel::Level level,
+            const char* fmt, const Args&... args) {
+        uint32_t site_id = site.getBinaryId();
+        if (!site_id) {
+            site_id = RegisterSite(site, 
+                BinaryLogSignature<decltype(BinaryLogValue(+args))...>::value);
+        }
+        uint64_t suppressed = logger->takeSuppressed() + site.takeSuppressed();
+        size_t n = kRecordHeaderSize + (suppressed ? sizeof(suppressed) : 0)
+            + (BinaryLogArgSize(BinaryLogValue(+args)) + ... + 0);
+        char* p = Reserve(n);
+        if (!p) {
+            // 未打开或记录过长
+            LogEventWrap wrap(LogEvent::Create(logger, level, site));
+            wrap.getEvent()->format(fmt, args...);
+            if (suppressed) {
+                wrap.getSS() << " [suppressed " << suppressed << "]";
+            }
+            return;
+        }
+        p = EncodeHeader(p, n, site_id, logger->getBinaryId(), level, suppressed);
+        ((p = BinaryLogArgEncode(p, BinaryLogValue(+args))), ...);
+        Commit(n);
+    }
+
+private:
+    struct Context;
+
+    BinaryLog();
+
+    static uint32_t RegisterSite(const LogCallSite& site, const char* signature);
+    static char* Reserve(size_t n);
+    static void Commit(size_t n);
+    static char* EncodeHeader(char* p, size_t n, uint32_t site, uint32_t logger, LogLevel::Level level,
+            uint64_t suppressed);
+
+    void run();
+    bool drain();
+
+private:
+    std::unique_ptr<Context> m_ctx;
+    std::atomic<bool> m_open {false};
+};
+
+// 读取BinaryLog文件，逐条还原为LogFormatter格式化后的文本
+class BinaryLogReader {
+public:
+    BinaryLogReader(const std::string& filename);
+    ~BinaryLogReader();
+
+    bool isOpen() const;
+    // 读出下一条并按formatter追加到out，文件结束或损坏时返回false
+    bool next(const LogFormatter& formatter, std::string& out);
+    // 文件末尾不完整(写入进程崩溃)
+    bool isTruncated() const { return m_truncated; }
+
+    // 按printf语义把编码后的参数格式化到out，参数与格式串不匹配时返回false
+    static bool FormatMessage(const char* fmt, const char* signature,
+            const char* data, size_t len, std::string& out);
+
+private:
+    struct Site;
+    bool readBlock();
+
+private:
+    std::ifstream m_ifs;
+    std::string m_block;
+    size_t m_pos = 0;
+    uint32_t m_tid = 0;
+    std::map<uint32_t, std::unique_ptr<Site> > m_sites;
+    std::map<uint32_t, Logger::ptr> m_loggers;
+    std::map<uint32_t, std::string> m_threads;
+    LogEvent::ptr m_event;
+    std::string m_message;
+    bool m_truncated = false;
+};
+
+// logger表是不可变快照，查找已有logger不加锁
+// 新建logger加锁复制整张表后替换，旧表在解锁后经Epoch延迟释放
+// "system.fiber"会先创建"system"，并默认继承它的级别
 class LoggerManager {
 public:
     LoggerManager();
+    ~LoggerManager();
     using MutexType = LogMutex;
+    using LoggerMap = std::unordered_map<std::string, Logger::ptr>;
     Logger::ptr getLogger(const std::string& name);
+
+    // flush所有logger，析构时也会调用，保证退出时异步日志不丢失
+    void flush();
     
     void init();
     Logger::ptr getRoot() const { return m_root; }
@@ -281,8 +1562,11 @@ public:
     std::string toYamlString() const;
 
 private:
-    mutable MutexType m_mutex;
-    std::map<std::string, Logger::ptr> m_loggers;
+    // 须持有m_mutex，新建的logger及其父logger加入map，由调用方发布
+    Logger::ptr createLoggerNoLock(const std::string& name, LoggerMap& map);
+private:
+    mutable MutexType m_mutex;  // 只串行化新建
+    std::atomic<const LoggerMap*> m_loggers;
     Logger::ptr m_root;
 };
 
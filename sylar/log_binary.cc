@@ -0,0 +1,775 @@
+#include "log.h"
+
+#include <cctype>
+#include <cstring>
+#include <list>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+
+namespace sylar {
+
+const char BinaryLog::kMagic[8] = {'S', 'Y', 'L', 'A', 'R', 'B', 'L', '1'};
+
+static_assert((BinaryLog::kBufferSize & (BinaryLog::kBufferSize - 1)) == 0,
+        "BinaryLog::kBufferSize must be a power of 2");
+
+// 每个线程一个的单生产者单消费者环形缓冲
+// 记录不跨越缓冲末尾：放不下时跳到开头，剩余不少于4字节时写入长度0作为标记
+struct BinaryLogBuffer {
+    BinaryLogBuffer(uint32_t t, const std::string& n)
+        : data(new char[BinaryLog::kBufferSize]), tid(t), name(n) {}
+
+    std::unique_ptr<char[]> data;
+    uint32_t tid;
+    std::string name;
+    uint64_t reserved = 0;                  // 生产者: 本次记录的起始位置
+    bool announced = false;                 // 消费者: 已写出THREAD块
+    std::atomic<bool> retired {false};      // 线程已退出，读空后释放
+    alignas(64) std::atomic<uint64_t> head {0};
+    alignas(64) std::atomic<uint64_t> tail {0};
+};
+
+// 线程退出时标记缓冲可回收，由后台线程读空后释放
+struct BinaryLogBufferHolder {
+    ~BinaryLogBufferHolder() {
+        if (buffer) {
+            buffer->retired.store(true, std::memory_order_release);
+        }
+    }
+    BinaryLogBuffer* buffer = nullptr;
+};
+
+static thread_local BinaryLogBufferHolder t_binlog_buffer;
+
+struct BinaryLogSiteDesc {
+    std::string file;
+    std::string func;
+    std::string fmt;
+    std::string signature;
+    uint32_t line;
+    LogLevel::Level level;
+};
+
+struct BinaryLog::Context {
+    MutexType mutex;        // 保护以下注册表和buffers
+    std::string filename;
+    int fd = -1;
+    std::list<BinaryLogBuffer*> buffers;
+    std::vector<BinaryLogSiteDesc> sites;
+    size_t sitesWritten = 0;
+    std::map<std::string, uint32_t> loggerIds;
+    std::vector<std::string> loggers;
+    size_t loggersWritten = 0;
+
+    Thread::ptr thread;
+    std::atomic<bool> stopping {false};
+    std::atomic<uint64_t> flushReq {0};
+    std::atomic<uint64_t> flushDone {0};
+    std::string out;        // 后台线程的写缓冲
+};
+
+static void AppendU8(std::string& out, uint8_t v) {
+    out.push_back((char)v);
+}
+
+static void AppendU32(std::string& out, uint32_t v) {
+    out.append((const char*)&v, sizeof(v));
+}
+
+static void AppendStr(std::string& out, const std::string& v) {
+    AppendU32(out, v.size());
+    out.append(v);
+}
+
+// 写块头，返回长度字段的位置，块内容写完后PatchBlock回填
+static size_t BeginBlock(std::string& out, BinaryLog::BlockType type) {
+    AppendU8(out, type);
+    size_t pos = out.size();
+    AppendU32(out, 0);
+    return pos;
+}
+
+static void PatchBlock(std::string& out, size_t pos) {
+    uint32_t len = out.size() - pos - sizeof(uint32_t);
+    memcpy(&out[pos], &len, sizeof(len));
+}
+
+static bool WriteAll(int fd, const char* data, size_t len) {
+    while (len) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+BinaryLog* BinaryLog::GetInstance() {
+    static BinaryLog* s_log = new BinaryLog;
+    return s_log;
+}
+
+BinaryLog::BinaryLog()
+    : m_ctx(new Context) {
+}
+
+bool BinaryLog::open(const std::string& filename) {
+    MutexType::Lock lock(m_ctx->mutex);
+    if (isOpen()) {
+        return m_ctx->filename == filename;
+    }
+
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (!WriteAll(fd, kMagic, sizeof(kMagic))) {
+        ::close(fd);
+        return false;
+    }
+
+    // 新文件需要重新写出全部描述符
+    m_ctx->filename = filename;
+    m_ctx->fd = fd;
+    m_ctx->sitesWritten = 0;
+    m_ctx->loggersWritten = 0;
+    for (auto& i : m_ctx->buffers) {
+        i->announced = false;
+    }
+
+    static bool s_atexit = [](){
+        atexit([](){ BinaryLog::GetInstance()->close(); });
+        return true;
+    }();
+    (void)s_atexit;
+
+    m_ctx->stopping.store(false, std::memory_order_relaxed);
+    m_ctx->thread.reset(new Thread(std::bind(&BinaryLog::run, this), "binlog"));
+    m_open.store(true, std::memory_order_release);
+    return true;
+}
+
+void BinaryLog::close() {
+    Thread::ptr thread;
+    {
+        MutexType::Lock lock(m_ctx->mutex);
+        if (!m_open.exchange(false, std::memory_order_acq_rel)) {
+            return;
+        }
+        thread.swap(m_ctx->thread);
+    }
+    // 退出前run()会再drain一次
+    m_ctx->stopping.store(true, std::memory_order_release);
+    thread->join();
+
+    MutexType::Lock lock(m_ctx->mutex);
+    ::close(m_ctx->fd);
+    m_ctx->fd = -1;
+}
+
+void BinaryLog::flush() {
+    if (!isOpen()) {
+        return;
+    }
+    uint64_t req = m_ctx->flushReq.fetch_add(1, std::memory_order_acq_rel) + 1;
+    while (m_ctx->flushDone.load(std::memory_order_acquire) < req && isOpen()) {
+        usleep(100);
+    }
+}
+
+std::string BinaryLog::getFilename() const {
+    MutexType::Lock lock(m_ctx->mutex);
+    return m_ctx->filename;
+}
+
+uint32_t BinaryLog::registerLogger(const std::string& name) {
+    MutexType::Lock lock(m_ctx->mutex);
+    auto it = m_ctx->loggerIds.find(name);
+    if (it != m_ctx->loggerIds.end()) {
+        return it->second;
+    }
+    m_ctx->loggers.push_back(name);
+    uint32_t id = m_ctx->loggers.size();
+    m_ctx->loggerIds[name] = id;
+    return id;
+}
+
+uint32_t BinaryLog::RegisterSite(const LogCallSite& site, const char* signature) {
+    Context* ctx = GetInstance()->m_ctx.get();
+    MutexType::Lock lock(ctx->mutex);
+    uint32_t id = site.m_binaryId.load(std::memory_order_relaxed);
+    if (id) {
+        return id;
+    }
+    ctx->sites.push_back({site.getFile(), site.getFunction(), site.getFormat(), signature,
+            (uint32_t)site.getLine(), site.getLevel()});
+    id = ctx->sites.size();
+    site.m_binaryId.store(id, std::memory_order_release);
+    return id;
+}
+
+char* BinaryLog::Reserve(size_t n) {
+    static const size_t kMask = kBufferSize - 1;
+    BinaryLog* log = GetInstance();
+    if (!log->isOpen() || n > kBufferSize / 2) {
+        return nullptr;
+    }
+
+    BinaryLogBuffer* buf = t_binlog_buffer.buffer;
+    if (!buf) {
+        buf = new BinaryLogBuffer(GetThreadId(), Thread::GetName());
+        MutexType::Lock lock(log->m_ctx->mutex);
+        log->m_ctx->buffers.push_back(buf);
+        t_binlog_buffer.buffer = buf;
+    }
+
+    uint64_t head = buf->head.load(std::memory_order_relaxed);
+    size_t contig = kBufferSize - (head & kMask);
+    size_t skip = n > contig ? contig : 0;
+    // 写满时等待后台线程，不丢日志
+    while (head + skip + n - buf->tail.load(std::memory_order_acquire) > kBufferSize) {
+        if (!log->isOpen()) {
+            return nullptr;
+        }
+        sched_yield();
+    }
+
+    if (skip) {
+        if (skip >= sizeof(uint32_t)) {
+            memset(buf->data.get() + (head & kMask), 0, sizeof(uint32_t));
+        }
+        head += skip;
+    }
+    buf->reserved = head;
+    return buf->data.get() + (head & kMask);
+}
+
+void BinaryLog::Commit(size_t n) {
+    BinaryLogBuffer* buf = t_binlog_buffer.buffer;
+    buf->head.store(buf->reserved + n, std::memory_order_release);
+}
+
+char* BinaryLog::EncodeHeader(char* p, size_t n, uint32_t site, uint32_t logger, LogLevel::Level level,
+        uint64_t suppressed) {
+    uint32_t h[4] = {(uint32_t)n, site, logger, GetFiberId()};
+    memcpy(p, h, sizeof(h));
+    uint64_t time = GetCurrentNS();
+    memcpy(p + sizeof(h), &time, sizeof(time));
+    p[sizeof(h) + sizeof(time)] = (char)(suppressed ? level | kSuppressedFlag : level);
+    p += kRecordHeaderSize;
+    if (suppressed) {
+        memcpy(p, &suppressed, sizeof(suppressed));
+        p += sizeof(suppressed);
+    }
+    return p;
+}
+
+void BinaryLog::run() {
+    Context* ctx = m_ctx.get();
+    while (!ctx->stopping.load(std::memory_order_acquire)) {
+        uint64_t req = ctx->flushReq.load(std::memory_order_acquire);
+        bool busy = drain();
+        ctx->flushDone.store(req, std::memory_order_release);
+        if (!busy) {
+            usleep(1000);
+        }
+    }
+    drain();
+    ctx->flushDone.store(ctx->flushReq.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+bool BinaryLog::drain() {
+    static const size_t kMask = kBufferSize - 1;
+    Context* ctx = m_ctx.get();
+    std::string& out = ctx->out;
+    std::vector<std::pair<BinaryLogBuffer*, uint64_t> > bufs;
+
+    {
+        MutexType::Lock lock(ctx->mutex);
+        // 先取各缓冲的head，再写描述符：head之前的记录引用的描述符一定已注册
+        for (auto& i : ctx->buffers) {
+            bufs.push_back(std::make_pair(i, i->head.load(std::memory_order_acquire)));
+        }
+
+        for (; ctx->sitesWritten < ctx->sites.size(); ++ctx->sitesWritten) {
+            auto& s = ctx->sites[ctx->sitesWritten];
+            size_t pos = BeginBlock(out, SITE);
+            AppendU32(out, ctx->sitesWritten + 1);
+            AppendU32(out, s.line);
+            AppendU8(out, s.level);
+            AppendStr(out, s.file);
+            AppendStr(out, s.func);
+            AppendStr(out, s.fmt);
+            AppendStr(out, s.signature);
+            PatchBlock(out, pos);
+        }
+
+        for (; ctx->loggersWritten < ctx->loggers.size(); ++ctx->loggersWritten) {
+            size_t pos = BeginBlock(out, LOGGER);
+            AppendU32(out, ctx->loggersWritten + 1);
+            AppendStr(out, ctx->loggers[ctx->loggersWritten]);
+            PatchBlock(out, pos);
+        }
+
+        for (auto& i : bufs) {
+            if (!i.first->announced) {
+                size_t pos = BeginBlock(out, THREAD);
+                AppendU32(out, i.first->tid);
+                AppendStr(out, i.first->name);
+                PatchBlock(out, pos);
+                i.first->announced = true;
+            }
+        }
+    }
+
+    bool busy = false;
+    for (auto& i : bufs) {
+        BinaryLogBuffer* buf = i.first;
+        uint64_t head = i.second;
+        uint64_t tail = buf->tail.load(std::memory_order_relaxed);
+        if (tail == head) {
+            continue;
+        }
+        busy = true;
+
+        size_t pos = BeginBlock(out, RECORDS);
+        AppendU32(out, buf->tid);
+        while (tail < head) {
+            size_t off = tail & kMask;
+            size_t contig = kBufferSize - off;
+            uint32_t size = 0;
+            if (contig >= sizeof(size)) {
+                memcpy(&size, buf->data.get() + off, sizeof(size));
+            }
+            if (!size) {
+                tail += contig;
+                continue;
+            }
+            out.append(buf->data.get() + off, size);
+            tail += size;
+        }
+        PatchBlock(out, pos);
+        buf->tail.store(tail, std::memory_order_release);
+    }
+
+    {
+        MutexType::Lock lock(ctx->mutex);
+        for (auto it = ctx->buffers.begin(); it != ctx->buffers.end();) {
+            BinaryLogBuffer* buf = *it;
+            if (buf->retired.load(std::memory_order_acquire)
+                    && buf->tail.load(std::memory_order_relaxed)
+                        == buf->head.load(std::memory_order_acquire)) {
+                delete buf;
+                it = ctx->buffers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    if (!out.empty()) {
+        if (!WriteAll(ctx->fd, out.data(), out.size())) {
+            std::cout << "write binary log failed:" << ctx->filename << std::endl;
+        }
+        out.clear();
+    }
+    return busy;
+}
+
+struct BinaryLogReader::Site {
+    std::string file;
+    std::string func;
+    std::string fmt;
+    std::string signature;
+    std::unique_ptr<LogCallSite> site;
+};
+
+BinaryLogReader::BinaryLogReader(const std::string& filename)
+    : m_ifs(filename, std::ios::binary) {
+    char magic[sizeof(BinaryLog::kMagic)];
+    if (!m_ifs.read(magic, sizeof(magic))
+            || memcmp(magic, BinaryLog::kMagic, sizeof(magic)) != 0) {
+        m_ifs.close();
+    }
+    m_event = std::make_shared<LogEvent>(nullptr, LogLevel::UNKNOW, "", 0, 0, 0, 0, 0, "");
+}
+
+BinaryLogReader::~BinaryLogReader() {
+}
+
+bool BinaryLogReader::isOpen() const {
+    return m_ifs.is_open();
+}
+
+// 从data中顺序读取，越界时返回false
+class BinaryLogParser {
+public:
+    BinaryLogParser(const char* data, size_t len)
+        : m_cur(data), m_end(data + len) {}
+
+    template <typename T>
+    bool read(T& v) {
+        if ((size_t)(m_end - m_cur) < sizeof(v)) {
+            return false;
+        }
+        memcpy(&v, m_cur, sizeof(v));
+        m_cur += sizeof(v);
+        return true;
+    }
+
+    bool read(std::string& v) {
+        uint32_t len = 0;
+        if (!read(len) || (size_t)(m_end - m_cur) < len) {
+            return false;
+        }
+        v.assign(m_cur, len);
+        m_cur += len;
+        return true;
+    }
+
+    // 字符串参数，nullptr时null为true
+    bool readArg(std::string& v, bool& null) {
+        uint32_t len = 0;
+        if (!read(len)) {
+            return false;
+        }
+        null = len == UINT32_MAX;
+        if (null) {
+            v.clear();
+            return true;
+        }
+        if ((size_t)(m_end - m_cur) < len) {
+            return false;
+        }
+        v.assign(m_cur, len);
+        m_cur += len;
+        return true;
+    }
+
+private:
+    const char* m_cur;
+    const char* m_end;
+};
+
+bool BinaryLogReader::readBlock() {
+    while (true) {
+        uint8_t type = 0;
+        uint32_t len = 0;
+        if (!m_ifs.read((char*)&type, sizeof(type))) {
+            return false;
+        }
+        if (!m_ifs.read((char*)&len, sizeof(len))) {
+            m_truncated = true;
+            return false;
+        }
+        m_block.resize(len);
+        if (!m_ifs.read(&m_block[0], len)) {
+            m_truncated = true;
+            return false;
+        }
+
+        BinaryLogParser parser(m_block.data(), m_block.size());
+        switch (type) {
+            case BinaryLog::SITE: {
+                uint32_t id = 0;
+                uint32_t line = 0;
+                uint8_t level = 0;
+                std::unique_ptr<Site> site(new Site);
+                if (!parser.read(id) || !parser.read(line) || !parser.read(level)
+                        || !parser.read(site->file) || !parser.read(site->func)
+                        || !parser.read(site->fmt) || !parser.read(site->signature)) {
+                    return false;
+                }
+                site->site.reset(new LogCallSite(site->file.c_str(), line, site->func.c_str(),
+                            (LogLevel::Level)level, site->fmt.c_str()));
+                m_sites[id] = std::move(site);
+                break;
+            }
+            case BinaryLog::LOGGER: {
+                uint32_t id = 0;
+                std::string name;
+                if (!parser.read(id) || !parser.read(name)) {
+                    return false;
+                }
+                m_loggers[id] = std::make_shared<Logger>(name);
+                break;
+            }
+            case BinaryLog::THREAD: {
+                uint32_t tid = 0;
+                std::string name;
+                if (!parser.read(tid) || !parser.read(name)) {
+                    return false;
+                }
+                m_threads[tid] = name;
+                break;
+            }
+            case BinaryLog::RECORDS:
+                if (!parser.read(m_tid)) {
+                    return false;
+                }
+                m_pos = sizeof(m_tid);
+                return true;
+            default:
+                // 未知块跳过，便于以后扩展
+                break;
+        }
+    }
+}
+
+bool BinaryLogReader::next(const LogFormatter& formatter, std::string& out) {
+    while (m_pos >= m_block.size()) {
+        if (!readBlock()) {
+            return false;
+        }
+    }
+
+    BinaryLogParser parser(m_block.data() + m_pos, m_block.size() - m_pos);
+    uint32_t size = 0;
+    uint32_t site_id = 0;
+    uint32_t logger_id = 0;
+    uint32_t fiber_id = 0;
+    uint64_t time = 0;
+    uint8_t level = 0;
+    if (!parser.read(size) || !parser.read(site_id) || !parser.read(logger_id)
+            || !parser.read(fiber_id) || !parser.read(time) || !parser.read(level)
+            || size < BinaryLog::kRecordHeaderSize || size > m_block.size() - m_pos) {
+        return false;
+    }
+    const char* args = m_block.data() + m_pos + BinaryLog::kRecordHeaderSize;
+    size_t args_len = size - BinaryLog::kRecordHeaderSize;
+    uint64_t suppressed = 0;
+    if (level & BinaryLog::kSuppressedFlag) {
+        level &= ~BinaryLog::kSuppressedFlag;
+        if (args_len < sizeof(suppressed)) {
+            return false;
+        }
+        memcpy(&suppressed, args, sizeof(suppressed));
+        args += sizeof(suppressed);
+        args_len -= sizeof(suppressed);
+    }
+    m_pos += size;
+
+    auto sit = m_sites.find(site_id);
+    if (sit == m_sites.end()) {
+        return false;
+    }
+    Site& site = *sit->second;
+
+    auto lit = m_loggers.find(logger_id);
+    if (lit == m_loggers.end()) {
+        lit = m_loggers.insert(std::make_pair(logger_id,
+                    std::make_shared<Logger>("unknown"))).first;
+    }
+
+    m_event->reset(lit->second.get(), (LogLevel::Level)level, site.file.c_str(),
+            site.site->getLine(), 0, m_tid, fiber_id, time, m_threads[m_tid]);
+    m_event->m_site = site.site.get();
+
+    m_message.clear();
+    if (!FormatMessage(site.fmt.c_str(), site.signature.c_str(), args, args_len, m_message)) {
+        m_message.append("<binary log: argument mismatch>");
+    }
+    if (suppressed) {
+        m_message.append(" [suppressed ").append(std::to_string(suppressed)).append("]");
+    }
+    m_event->m_ss.buf().append(m_message.data(), m_message.size());
+    formatter.format(*m_event, out);
+    return true;
+}
+
+template <typename T>
+static void AppendPrintf(std::string& out, const std::string& spec, T v) {
+    char buf[128];
+    int n = snprintf(buf, sizeof(buf), spec.c_str(), v);
+    if (n < 0) {
+        return;
+    }
+    if ((size_t)n < sizeof(buf)) {
+        out.append(buf, n);
+        return;
+    }
+    size_t old = out.size();
+    out.resize(old + n + 1);
+    snprintf(&out[old], n + 1, spec.c_str(), v);
+    out.resize(old + n);
+}
+
+bool BinaryLogReader::FormatMessage(const char* fmt, const char* signature,
+        const char* data, size_t len, std::string& out) {
+    BinaryLogParser parser(data, len);
+    const char* sig = signature;
+
+    // 取一个整型参数，用于 * 宽度/精度
+    auto read_int = [&](int& v) -> bool {
+        if (*sig != 'i' && *sig != 'u') {
+            return false;
+        }
+        ++sig;
+        int32_t i = 0;
+        if (!parser.read(i)) {
+            return false;
+        }
+        v = i;
+        return true;
+    };
+
+    const char* p = fmt;
+    while (*p) {
+        if (*p != '%') {
+            const char* q = strchr(p, '%');
+            if (!q) {
+                q = p + strlen(p);
+            }
+            out.append(p, q - p);
+            p = q;
+            continue;
+        }
+        if (p[1] == '%') {
+            out.push_back('%');
+            p += 2;
+            continue;
+        }
+
+        // 重建单个转换说明，* 替换为实际数值，长度修饰按归一化后的类型重写
+        std::string spec = "%";
+        ++p;
+        while (*p && strchr("-+ #0'I", *p)) {
+            spec.push_back(*p++);
+        }
+        if (*p == '*') {
+            int w = 0;
+            if (!read_int(w)) {
+                return false;
+            }
+            spec.append(std::to_string(w));
+            ++p;
+        } else {
+            while (isdigit(*p)) {
+                spec.push_back(*p++);
+            }
+        }
+        if (*p == '.') {
+            spec.push_back(*p++);
+            if (*p == '*') {
+                int prec = 0;
+                if (!read_int(prec)) {
+                    return false;
+                }
+                spec.append(std::to_string(prec));
+                ++p;
+            } else {
+                while (isdigit(*p)) {
+                    spec.push_back(*p++);
+                }
+            }
+        }
+        std::string length;
+        while (*p && strchr("hlLqjzt", *p)) {
+            length.push_back(*p++);
+        }
+        char conv = *p;
+        if (!conv) {
+            return false;
+        }
+        ++p;
+
+        char type = *sig;
+        if (conv != 'm') {
+            if (!type) {
+                return false;
+            }
+            ++sig;
+        }
+
+        switch (conv) {
+            case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': case 'c': {
+                if (type == 'i' || type == 'u') {
+                    // 保留h/hh的截断语义
+                    if (conv != 'c' && (length == "h" || length == "hh")) {
+                        spec.append(length);
+                    }
+                    spec.push_back(conv);
+                    uint32_t v = 0;
+                    if (!parser.read(v)) {
+                        return false;
+                    }
+                    AppendPrintf(out, spec, v);
+                } else if (type == 'l' || type == 'L') {
+                    spec.append("ll");
+                    spec.push_back(conv);
+                    uint64_t v = 0;
+                    if (!parser.read(v)) {
+                        return false;
+                    }
+                    AppendPrintf(out, spec, (unsigned long long)v);
+                } else {
+                    return false;
+                }
+                break;
+            }
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A': {
+                if (type == 'd') {
+                    spec.push_back(conv);
+                    double v = 0;
+                    if (!parser.read(v)) {
+                        return false;
+                    }
+                    AppendPrintf(out, spec, v);
+                } else if (type == 'D') {
+                    spec.push_back('L');
+                    spec.push_back(conv);
+                    long double v = 0;
+                    if (!parser.read(v)) {
+                        return false;
+                    }
+                    AppendPrintf(out, spec, v);
+                } else {
+                    return false;
+                }
+                break;
+            }
+            case 's': {
+                if (type != 's') {
+                    return false;
+                }
+                spec.push_back(conv);
+                std::string v;
+                bool null = false;
+                if (!parser.readArg(v, null)) {
+                    return false;
+                }
+                AppendPrintf(out, spec, null ? nullptr : v.c_str());
+                break;
+            }
+            case 'p': {
+                spec.push_back(conv);
+                uint64_t v = 0;
+                if (type == 'p' || type == 'l' || type == 'L') {
+                    if (!parser.read(v)) {
+                        return false;
+                    }
+                } else {
+                    return false;
+                }
+                AppendPrintf(out, spec, (const void*)(uintptr_t)v);
+                break;
+            }
+            case 'm':
+                // errno在写日志时已无法取得
+                out.append("%m");
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+}
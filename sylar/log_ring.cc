@@ -0,0 +1,360 @@
+#include "log.h"
+
+#include <cstring>
+#include <set>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "config.h"
+
+namespace sylar {
+
+// 单线程写入的环，pos为累计写入的字节数
+struct RingBufferLogAppender::Ring {
+    Ring(size_t size) : data(new char[size]), mask(size - 1) {}
+
+    void write(const char* str, size_t len) {
+        size_t size = mask + 1;
+        if (len > size) {
+            str += len - size;
+            len = size;
+        }
+        uint64_t p = pos.load(std::memory_order_relaxed);
+        size_t off = p & mask;
+        size_t first = std::min(len, size - off);
+        memcpy(data.get() + off, str, first);
+        memcpy(data.get(), str + first, len - first);
+        pos.store(p + len, std::memory_order_release);
+    }
+
+    std::unique_ptr<char[]> data;
+    size_t mask;
+    std::atomic<uint64_t> pos {0};
+    std::atomic<bool> used {false};
+    pid_t tid = 0;
+    char name[32] = {0};
+    Ring* next = nullptr;
+};
+
+// 存活的实例id，线程退出归还环时据此判断appender是否已析构
+struct RingRegistry {
+    Mutex mutex;
+    std::set<uint64_t> alive;
+};
+
+// 线程退出时可能晚于静态对象析构，不释放
+static RingRegistry* GetRingRegistry() {
+    static RingRegistry* s_registry = new RingRegistry;
+    return s_registry;
+}
+
+static std::atomic<uint64_t> s_ring_id {0};
+// 信号处理函数中无锁遍历
+static std::atomic<RingBufferLogAppender*> s_instances[RingBufferLogAppender::kMaxInstances];
+// 正在遍历s_instances的DumpAll数，析构时等其归零
+static std::atomic<int> s_dumping {0};
+
+// 当前线程在各appender中持有的环，线程退出时归还
+struct RingBufferLogAppender::ThreadRings {
+    struct Entry {
+        uint64_t id;
+        Ring* ring;
+    };
+
+    ~ThreadRings() {
+        RingRegistry* reg = GetRingRegistry();
+        Mutex::Lock lock(reg->mutex);
+        for (auto& i : entries) {
+            if (reg->alive.count(i.id)) {
+                i.ring->used.store(false, std::memory_order_release);
+            }
+        }
+    }
+
+    std::vector<Entry> entries;
+};
+
+RingBufferLogAppender::RingBufferLogAppender(const std::string& dump_file, size_t ring_size)
+    : m_dumpFile(dump_file), m_id(++s_ring_id) {
+    m_ringSize = 4096;
+    while (m_ringSize < ring_size) {
+        m_ringSize <<= 1;
+    }
+
+    RingRegistry* reg = GetRingRegistry();
+    Mutex::Lock lock(reg->mutex);
+    reg->alive.insert(m_id);
+    for (auto& i : s_instances) {
+        RingBufferLogAppender* expected = nullptr;
+        if (i.compare_exchange_strong(expected, this)) {
+            return;
+        }
+    }
+    std::cout << "RingBufferLogAppender: more than " << kMaxInstances
+              << " instances, " << dump_file << " will not be dumped by DumpAll" << std::endl;
+}
+
+RingBufferLogAppender::~RingBufferLogAppender() {
+    {
+        RingRegistry* reg = GetRingRegistry();
+        Mutex::Lock lock(reg->mutex);
+        reg->alive.erase(m_id);
+        for (auto& i : s_instances) {
+            RingBufferLogAppender* expected = this;
+            i.compare_exchange_strong(expected, nullptr);
+        }
+    }
+    while (s_dumping.load(std::memory_order_acquire)) {
+        sched_yield();
+    }
+
+    Ring* ring = m_rings.load(std::memory_order_acquire);
+    while (ring) {
+        Ring* next = ring->next;
+        delete ring;
+        ring = next;
+    }
+}
+
+RingBufferLogAppender::Ring* RingBufferLogAppender::getRing() {
+    static thread_local ThreadRings t_rings;
+    for (auto& i : t_rings.entries) {
+        if (i.id == m_id) {
+            return i.ring;
+        }
+    }
+
+    RingRegistry* reg = GetRingRegistry();
+    Mutex::Lock lock(reg->mutex);
+    // 顺便清掉已析构appender的缓存
+    auto& entries = t_rings.entries;
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [reg](const ThreadRings::Entry& e) {
+        return !reg->alive.count(e.id);
+    }), entries.end());
+
+    Ring* ring = acquireRing();
+    entries.push_back({m_id, ring});
+    return ring;
+}
+
+// 须持有注册表的锁
+RingBufferLogAppender::Ring* RingBufferLogAppender::acquireRing() {
+    Ring* ring = nullptr;
+    for (Ring* i = m_rings.load(std::memory_order_acquire); i; i = i->next) {
+        if (!i->used.load(std::memory_order_acquire)) {
+            ring = i;
+            break;
+        }
+    }
+    if (ring) {
+        // 复用已退出线程的环，丢弃其中的旧内容
+        ring->pos.store(0, std::memory_order_relaxed);
+    } else {
+        ring = new Ring(m_ringSize);
+        ring->next = m_rings.load(std::memory_order_relaxed);
+        m_rings.store(ring, std::memory_order_release);
+    }
+    ring->tid = GetThreadId();
+    strncpy(ring->name, Thread::GetName().c_str(), sizeof(ring->name) - 1);
+    ring->used.store(true, std::memory_order_release);
+    return ring;
+}
+
+void RingBufferLogAppender::log(LogEvent::ptr event) {
+    if (!accept(*event)) {
+        return;
+    }
+    Epoch::ReadGuard guard;
+    LogFormatter* fmt = m_current.load(std::memory_order_acquire);
+    if (!fmt) {
+        return;
+    }
+    static thread_local std::string t_scratch;
+    const std::string& str = event->getFormatted(*fmt, t_scratch);
+    getRing()->write(str.data(), str.size());
+}
+
+void RingBufferLogAppender::setFormatter(LogFormatter::ptr val) {
+    LogFormatter::ptr old;
+    {
+        MutexType::Lock lock(m_mutex);
+        old = m_formatter;
+        m_formatter = val;
+        m_has_formatter = true;
+        m_current.store(val.get(), std::memory_order_release);
+    }
+    if (old) {
+        // 正在log()中的线程可能仍在使用旧formatter
+        Epoch::GetInstance()->retire([old](){});
+    }
+}
+
+std::string RingBufferLogAppender::toYamlString() const {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "RingBufferLogAppender";
+    if (m_level != LogLevel::Level::UNKNOW)
+        node["level"] = LogLevel::ToString(m_level);
+    node["file"] = m_dumpFile;
+    if (m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    if (m_ringSize != kDefaultRingSize)
+        node["ring_size"] = m_ringSize;
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+// 以下只用async-signal-safe的调用
+
+static int64_t RingWrite(int fd, const char* data, size_t len) {
+    size_t left = len;
+    while (left) {
+        ssize_t n = ::write(fd, data, left);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        left -= n;
+    }
+    return len;
+}
+
+static int64_t RingWriteStr(int fd, const char* str) {
+    return RingWrite(fd, str, strlen(str));
+}
+
+static int64_t RingWriteUInt(int fd, uint64_t v) {
+    char buf[24];
+    char* p = buf + sizeof(buf);
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    return RingWrite(fd, p, buf + sizeof(buf) - p);
+}
+
+int64_t RingBufferLogAppender::dump(const char* reason) {
+    if (m_dumping.test_and_set(std::memory_order_acquire)) {
+        return -1;
+    }
+    int fd = ::open(m_dumpFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        m_dumping.clear(std::memory_order_release);
+        return -1;
+    }
+
+    int64_t total = 0;
+    bool ok = RingWriteStr(fd, "==== sylar flight recorder: ") >= 0
+        && RingWriteStr(fd, reason ? reason : "") >= 0
+        && RingWriteStr(fd, " ====\n") >= 0;
+    for (Ring* ring = m_rings.load(std::memory_order_acquire); ok && ring; ring = ring->next) {
+        uint64_t pos = ring->pos.load(std::memory_order_acquire);
+        if (!pos) {
+            continue;
+        }
+        ok = RingWriteStr(fd, "---- thread ") >= 0
+            && RingWriteUInt(fd, ring->tid) >= 0
+            && RingWriteStr(fd, " ") >= 0
+            && RingWriteStr(fd, ring->name) >= 0
+            && RingWriteStr(fd, " ----\n") >= 0;
+
+        const char* data = ring->data.get();
+        size_t size = ring->mask + 1;
+        if (pos <= size) {
+            ok = ok && RingWrite(fd, data, pos) >= 0;
+            total += pos;
+            continue;
+        }
+        // 已回绕: 较旧的一段在off之后，跳过其中被覆盖了开头的第一行
+        size_t off = pos & ring->mask;
+        const char* older = data + off;
+        size_t older_len = size - off;
+        const char* newer = data;
+        size_t newer_len = off;
+        const char* nl = (const char*)memchr(older, '\n', older_len);
+        if (nl) {
+            older_len -= nl + 1 - older;
+            older = nl + 1;
+        } else {
+            nl = (const char*)memchr(newer, '\n', newer_len);
+            older_len = 0;
+            if (nl) {
+                newer_len -= nl + 1 - newer;
+                newer = nl + 1;
+            }
+        }
+        ok = ok && RingWrite(fd, older, older_len) >= 0
+            && RingWrite(fd, newer, newer_len) >= 0;
+        total += older_len + newer_len;
+    }
+    ::close(fd);
+    m_dumping.clear(std::memory_order_release);
+    return ok ? total : -1;
+}
+
+void RingBufferLogAppender::DumpAll(const char* reason) {
+    s_dumping.fetch_add(1, std::memory_order_acq_rel);
+    for (auto& i : s_instances) {
+        RingBufferLogAppender* appender = i.load(std::memory_order_acquire);
+        if (appender) {
+            appender->dump(reason);
+        }
+    }
+    s_dumping.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+static const int s_fatal_signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+static struct sigaction s_old_fatal_actions[sizeof(s_fatal_signals) / sizeof(s_fatal_signals[0])];
+
+static void FatalSignalHandler(int sig, siginfo_t* info, void* ctx) {
+    char reason[32] = "signal ";
+    char* p = reason + strlen(reason);
+    char digits[8];
+    int n = 0;
+    int v = sig;
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v && n < (int)sizeof(digits));
+    while (n) {
+        *p++ = digits[--n];
+    }
+    *p = '\0';
+    RingBufferLogAppender::DumpAll(reason);
+
+    for (size_t i = 0; i < sizeof(s_fatal_signals) / sizeof(s_fatal_signals[0]); ++i) {
+        if (s_fatal_signals[i] == sig) {
+            sigaction(sig, &s_old_fatal_actions[i], nullptr);
+            break;
+        }
+    }
+    // 处理函数返回后信号解除阻塞，按原来的方式处理(默认为终止并产生core)
+    raise(sig);
+}
+
+void RingBufferLogAppender::InstallSignalHandlers() {
+    static bool s_installed = [](){
+        bool ok = true;
+        for (size_t i = 0; i < sizeof(s_fatal_signals) / sizeof(s_fatal_signals[0]); ++i) {
+            struct sigaction sa;
+            memset(&sa, 0, sizeof(sa));
+            sa.sa_sigaction = &FatalSignalHandler;
+            sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+            sigemptyset(&sa.sa_mask);
+            ok = sigaction(s_fatal_signals[i], &sa, &s_old_fatal_actions[i]) == 0 && ok;
+        }
+        return ok;
+    }();
+    if (!s_installed) {
+        std::cout << "RingBufferLogAppender install signal handlers failed" << std::endl;
+    }
+}
+
+}
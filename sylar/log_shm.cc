@@ -0,0 +1,272 @@
+#include "log.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.h"
+
+namespace sylar {
+
+// 位于共享内存开头，之后是capacity字节的数据区
+// reserve与read为累计字节数，reserve - read为已占用的空间
+struct ShmLogRing::Header {
+    uint64_t magic;
+    uint64_t capacity;
+    std::atomic<int32_t> owner;
+    alignas(64) std::atomic<uint64_t> reserve;
+    alignas(64) std::atomic<uint64_t> read;
+    alignas(64) std::atomic<uint64_t> dropped;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock free");
+
+// 每条记录以8字节的头开始，低32位为长度，高32位为状态:
+// 0 未写入，kCommitted 已提交，kPad 填充到环尾，其它值为正在写入的进程id
+// 记录不跨越环尾，放不下时先写一条填充记录
+static const uint32_t kCommitted = 0xffffffff;
+static const uint32_t kPad = 0xfffffffe;
+static const size_t kRecordHead = 8;
+
+static uint64_t RecordSize(size_t len) {
+    return (kRecordHead + len + 7) & ~(uint64_t)7;
+}
+
+static std::string ShmPath(const std::string& name) {
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+static bool ProcessAlive(pid_t pid) {
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+ShmLogRing::ptr ShmLogRing::Open(const std::string& name, size_t size) {
+    static_assert(sizeof(Header) <= kHeaderSize, "header too large");
+    std::string path = ShmPath(name);
+    int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return nullptr;
+    }
+    // 生产者与消费者可能同时创建，由文件锁保证只初始化一次
+    flock(fd, LOCK_EX);
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    size_t capacity = 64 * 1024;
+    if (ok && st.st_size == 0) {
+        while (capacity < size) {
+            capacity <<= 1;
+        }
+        ok = ftruncate(fd, kHeaderSize + capacity) == 0;
+    } else if (ok) {
+        capacity = st.st_size > (off_t)kHeaderSize ? st.st_size - kHeaderSize : 0;
+    }
+
+    void* addr = MAP_FAILED;
+    if (ok) {
+        addr = mmap(nullptr, kHeaderSize + capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (addr == MAP_FAILED) {
+        flock(fd, LOCK_UN);
+        ::close(fd);
+        return nullptr;
+    }
+
+    Header* header = (Header*)addr;
+    if (header->magic == 0) {
+        header->capacity = capacity;
+        header->magic = kMagic;
+    } else if (header->magic != kMagic || header->capacity != capacity
+            || (capacity & (capacity - 1))) {
+        std::cout << "ShmLogRing: " << path << " is not a log ring" << std::endl;
+        munmap(addr, kHeaderSize + capacity);
+        flock(fd, LOCK_UN);
+        ::close(fd);
+        return nullptr;
+    }
+    flock(fd, LOCK_UN);
+
+    ShmLogRing::ptr ring(new ShmLogRing);
+    ring->m_name = name;
+    ring->m_fd = fd;
+    ring->m_header = header;
+    ring->m_data = (char*)addr + kHeaderSize;
+    ring->m_capacity = capacity;
+    ring->m_pid = getpid();
+    return ring;
+}
+
+bool ShmLogRing::Unlink(const std::string& name) {
+    return shm_unlink(ShmPath(name).c_str()) == 0;
+}
+
+ShmLogRing::~ShmLogRing() {
+    munmap(m_header, kHeaderSize + m_capacity);
+    ::close(m_fd);
+}
+
+bool ShmLogRing::write(const char* data, size_t len) {
+    len = std::min(len, getMaxRecord());
+    uint64_t need = RecordSize(len);
+    uint64_t pos = m_header->reserve.load(std::memory_order_relaxed);
+    uint64_t pad = 0;
+    do {
+        uint64_t left = m_capacity - (pos & (m_capacity - 1));
+        pad = left < need ? left : 0;
+        if (pos + pad + need - m_header->read.load(std::memory_order_acquire) > m_capacity) {
+            m_header->dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    } while (!m_header->reserve.compare_exchange_weak(pos, pos + pad + need,
+                std::memory_order_acquire, std::memory_order_relaxed));
+
+    if (pad) {
+        recordHeader(pos).store((pad - kRecordHead) | (uint64_t)kPad << 32, std::memory_order_release);
+        pos += pad;
+    }
+    // 先写入长度和进程id，写入途中崩溃时消费者据此跳过
+    std::atomic<uint64_t>& head = recordHeader(pos);
+    head.store(len | (uint64_t)m_pid << 32, std::memory_order_relaxed);
+    memcpy(m_data + (pos & (m_capacity - 1)) + kRecordHead, data, len);
+    head.store(len | (uint64_t)kCommitted << 32, std::memory_order_release);
+    return true;
+}
+
+size_t ShmLogRing::read(const std::function<void(const char* data, size_t len)>& cb) {
+    uint64_t pos = m_header->read.load(std::memory_order_relaxed);
+    uint64_t end = m_header->reserve.load(std::memory_order_acquire);
+    size_t count = 0;
+    while (pos < end) {
+        std::atomic<uint64_t>& head = recordHeader(pos);
+        uint64_t v = head.load(std::memory_order_acquire);
+        uint32_t len = v & 0xffffffff;
+        uint32_t state = v >> 32;
+        if (state == kCommitted) {
+            cb(m_data + (pos & (m_capacity - 1)) + kRecordHead, len);
+            ++count;
+        } else if (state != kPad) {
+            break;
+        }
+        // 整条记录清零后才能交还给生产者：回绕后新记录的头可能落在旧记录的正文上，
+        // 生产者写入长度前消费者看到的必须是0，而不是被当作进程id的正文
+        uint64_t size = RecordSize(len);
+        memset(m_data + (pos & (m_capacity - 1)) + kRecordHead, 0, size - kRecordHead);
+        head.store(0, std::memory_order_relaxed);
+        pos += size;
+    }
+    m_header->read.store(pos, std::memory_order_release);
+    return count;
+}
+
+bool ShmLogRing::skipDead() {
+    uint64_t pos = m_header->read.load(std::memory_order_relaxed);
+    uint64_t end = m_header->reserve.load(std::memory_order_acquire);
+    if (pos >= end) {
+        return false;
+    }
+    std::atomic<uint64_t>& head = recordHeader(pos);
+    uint64_t v = head.load(std::memory_order_acquire);
+    uint32_t len = v & 0xffffffff;
+    uint32_t state = v >> 32;
+    if (state == kCommitted || state == kPad) {
+        return false;
+    }
+    // 长度不合法时头不可信，按还没写入长度处理
+    if (state && (len > getMaxRecord()
+                || (pos & (m_capacity - 1)) + RecordSize(len) > m_capacity
+                || pos + RecordSize(len) > end)) {
+        state = 0;
+    }
+    pid_t pid = state ? (pid_t)state : getOwner();
+    if (pid && ProcessAlive(pid)) {
+        return false;
+    }
+    if (state) {
+        head.store(len | (uint64_t)kPad << 32, std::memory_order_release);
+        return true;
+    }
+    // owner预留后还没来得及写长度就崩溃了，无法定位后续记录，丢弃到当前预留位置；
+    // 只有一个生产者进程，owner已死时没有其它写者还在写这段空间
+    for (uint64_t p = pos; p < end; ) {
+        size_t off = p & (m_capacity - 1);
+        size_t n = std::min(end - p, (uint64_t)(m_capacity - off));
+        memset(m_data + off, 0, n);
+        p += n;
+    }
+    m_header->read.store(end, std::memory_order_release);
+    return true;
+}
+
+bool ShmLogRing::empty() const {
+    return m_header->read.load(std::memory_order_acquire)
+        == m_header->reserve.load(std::memory_order_acquire);
+}
+
+bool ShmLogRing::setOwner(pid_t pid) {
+    pid_t cur = m_header->owner.load(std::memory_order_acquire);
+    while (true) {
+        if (cur == pid) {
+            return true;
+        }
+        if (cur && ProcessAlive(cur)) {
+            return false;
+        }
+        if (m_header->owner.compare_exchange_weak(cur, pid, std::memory_order_acq_rel)) {
+            return true;
+        }
+    }
+}
+
+pid_t ShmLogRing::getOwner() const {
+    return m_header->owner.load(std::memory_order_acquire);
+}
+
+uint64_t ShmLogRing::getDropped() const {
+    return m_header->dropped.load(std::memory_order_relaxed);
+}
+
+ShmLogAppender::ShmLogAppender(const std::string& name, size_t size)
+    : m_name(name), m_size(size) {
+    m_ring = ShmLogRing::Open(name, size);
+    if (m_ring) {
+        if (!m_ring->setOwner(getpid())) {
+            std::cout << "ShmLogAppender shm already has a producer process: " << name
+                      << " owner=" << m_ring->getOwner() << std::endl;
+            m_ring = nullptr;
+        }
+    } else {
+        std::cout << "ShmLogAppender open shm failed: " << name
+                  << " errno=" << errno << " " << strerror(errno) << std::endl;
+    }
+}
+
+void ShmLogAppender::log(LogEvent::ptr event) {
+    if (m_ring && accept(*event)) {
+        MutexType::Lock lock(m_mutex);
+        const std::string& str = event->getFormatted(*m_formatter, m_buffer);
+        m_ring->write(str.data(), str.size());
+    }
+}
+
+std::string ShmLogAppender::toYamlString() const {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "ShmLogAppender";
+    if (m_level != LogLevel::Level::UNKNOW)
+        node["level"] = LogLevel::ToString(m_level);
+    node["shm"] = m_name;
+    if (m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    if (m_size != ShmLogRing::kDefaultSize)
+        node["shm_size"] = m_size;
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+}
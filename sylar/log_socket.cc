@@ -0,0 +1,291 @@
+#include "log.h"
+
+#include <algorithm>
+#include <ctime>
+#include <cstring>
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "config.h"
+
+namespace sylar {
+
+// RFC5424中HOSTNAME、APP-NAME、MSGID只允许可打印的非空格ASCII，并有长度上限
+static std::string SyslogField(const std::string& str, size_t max_len) {
+    std::string out;
+    for (char c : str) {
+        if (out.size() >= max_len) {
+            break;
+        }
+        out.push_back(c > 32 && c < 127 ? c : '_');
+    }
+    return out.empty() ? "-" : out;
+}
+
+SocketLogAppender::SocketLogAppender(const std::string& address, const std::string& app_name,
+        uint32_t facility)
+    : m_address(address)
+    , m_appName(SyslogField(app_name, 48))
+    , m_facility(facility > 23 ? kDefaultFacility : facility)
+    , m_pid(std::to_string(getpid())) {
+    char host[256] = {0};
+    if (gethostname(host, sizeof(host) - 1) == 0) {
+        m_hostname = SyslogField(host, 255);
+    } else {
+        m_hostname = "-";
+    }
+    m_lastFlush = GetMonotonicMS();
+
+    if (address.compare(0, 5, "unix:") != 0 && address.compare(0, 4, "udp:") != 0) {
+        std::cout << "SocketLogAppender address should be unix:/path or udp:host:port, "
+                  << address << std::endl;
+    } else if (!connectNoLock()) {
+        std::cout << "SocketLogAppender connect failed: " << address
+                  << " errno=" << errno << " " << strerror(errno) << std::endl;
+    }
+    AddTimer(this);
+}
+
+SocketLogAppender::~SocketLogAppender() {
+    DelTimer(this);
+    MutexType::Lock lock(m_mutex);
+    flushNoLock();
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool SocketLogAppender::connectNoLock() {
+    if (m_fd >= 0) {
+        return true;
+    }
+    uint64_t now = GetMonotonicMS();
+    if (m_lastConnect && now < m_lastConnect + m_flushInterval) {
+        return false;
+    }
+    m_lastConnect = now;
+
+    int fd = -1;
+    if (m_address.compare(0, 5, "unix:") == 0) {
+        std::string path = m_address.substr(5);
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+        memcpy(addr.sun_path, path.c_str(), path.size());
+        fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && ::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    } else if (m_address.compare(0, 4, "udp:") == 0) {
+        std::string host = m_address.substr(4);
+        size_t pos = host.rfind(':');
+        if (pos == std::string::npos) {
+            errno = EINVAL;
+            return false;
+        }
+        std::string port = host.substr(pos + 1);
+        host.resize(pos);
+        if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+            host = host.substr(1, host.size() - 2);
+        }
+
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        hints.ai_flags = AI_NUMERICSERV;
+        struct addrinfo* results = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &results) != 0) {
+            errno = EINVAL;
+            return false;
+        }
+        for (struct addrinfo* i = results; i && fd < 0; i = i->ai_next) {
+            fd = ::socket(i->ai_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd >= 0 && ::connect(fd, i->ai_addr, i->ai_addrlen) != 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(results);
+    } else {
+        errno = EINVAL;
+    }
+    m_fd = fd;
+    return fd >= 0;
+}
+
+int SocketLogAppender::ToSeverity(LogLevel::Level level) {
+    switch (level) {
+        case LogLevel::FATAL:
+            return 2;   // critical
+        case LogLevel::ERROR:
+            return 3;
+        case LogLevel::WARN:
+            return 4;
+        case LogLevel::INFO:
+            return 6;
+        default:
+            return 7;   // debug
+    }
+}
+
+void SocketLogAppender::appendNoLock(int severity, uint64_t time_ns, const std::string& msgid,
+        const char* msg, size_t len) {
+    time_t sec = time_ns / 1000000000ull;
+    struct tm tm;
+    gmtime_r(&sec, &tm);
+    char head[64];
+    int n = snprintf(head, sizeof(head), "<%u>1 %04d-%02d-%02dT%02d:%02d:%02d.%06uZ ",
+            m_facility * 8 + severity, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+            tm.tm_hour, tm.tm_min, tm.tm_sec, (uint32_t)(time_ns % 1000000000ull / 1000));
+
+    size_t offset = m_batchBuf.size();
+    m_batchBuf.append(head, n);
+    m_batchBuf.append(m_hostname).append(1, ' ');
+    m_batchBuf.append(m_appName).append(1, ' ');
+    m_batchBuf.append(m_pid).append(1, ' ');
+    m_batchBuf.append(msgid).append(" - ");
+    size_t used = m_batchBuf.size() - offset;
+    if (used + len > kMaxMessageSize) {
+        len = used < kMaxMessageSize ? kMaxMessageSize - used : 0;
+    }
+    m_batchBuf.append(msg, len);
+    m_records.emplace_back(offset, m_batchBuf.size() - offset);
+}
+
+void SocketLogAppender::log(LogEvent::ptr event) {
+    if (accept(*event)) {
+        MutexType::Lock lock(m_mutex);
+        const std::string& str = event->getFormatted(*m_formatter, m_buffer);
+        size_t len = str.size();
+        if (len && str[len - 1] == '\n') {
+            --len;
+        }
+        Logger* logger = event->getLogger();
+        appendNoLock(ToSeverity(event->getLevel()), event->getTimeNs(),
+                SyslogField(logger ? logger->getName() : "", 32), str.data(), len);
+
+        // ERROR及以上立即发出
+        if (m_records.size() >= m_batchSize
+                || event->getLevel() >= LogLevel::ERROR
+                || GetMonotonicMS() >= m_lastFlush + m_flushInterval) {
+            flushNoLock();
+        }
+    }
+}
+
+void SocketLogAppender::flush() {
+    MutexType::Lock lock(m_mutex);
+    flushNoLock();
+}
+
+void SocketLogAppender::flushNoLock() {
+    m_lastFlush = GetMonotonicMS();
+    size_t total = m_records.size();
+    if (!total) {
+        return;
+    }
+
+    // 有未报告的丢弃时把提示放在本批最前面，提示本身不计入发送和丢弃数
+    uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+    size_t notice = 0;
+    if (dropped != m_reported) {
+        std::string str = "dropped " + std::to_string(dropped - m_reported) + " log records";
+        appendNoLock(ToSeverity(LogLevel::WARN), GetCurrentNS(), "-", str.data(), str.size());
+        std::rotate(m_records.begin(), m_records.end() - 1, m_records.end());
+        notice = 1;
+        ++total;
+    }
+
+    static const size_t kChunk = 64;
+    struct mmsghdr msgs[kChunk];
+    struct iovec iovs[kChunk];
+    size_t done = 0;
+    if (connectNoLock()) {
+        while (done < total) {
+            size_t n = std::min(total - done, kChunk);
+            memset(msgs, 0, sizeof(msgs[0]) * n);
+            for (size_t i = 0; i < n; ++i) {
+                auto& r = m_records[done + i];
+                iovs[i].iov_base = &m_batchBuf[r.first];
+                iovs[i].iov_len = r.second;
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            int rt = ::sendmmsg(m_fd, msgs, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (rt < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                // 接收方不存在等错误时关闭，下次flush重新连接
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) {
+                    ::close(m_fd);
+                    m_fd = -1;
+                }
+                break;
+            }
+            done += rt;
+        }
+    }
+    if (notice && done) {
+        m_reported = dropped;
+        --done;
+    }
+    m_sent.fetch_add(done, std::memory_order_relaxed);
+    m_dropped.fetch_add(total - notice - done, std::memory_order_relaxed);
+    m_records.clear();
+    m_batchBuf.clear();
+}
+
+void SocketLogAppender::onTimer(uint64_t now_ms) {
+    MutexType::Lock lock(m_mutex);
+    if (!m_records.empty() && now_ms >= m_lastFlush + m_flushInterval) {
+        flushNoLock();
+    }
+}
+
+void SocketLogAppender::setBatchSize(size_t v) {
+    MutexType::Lock lock(m_mutex);
+    m_batchSize = v ? v : 1;
+    if (m_records.size() >= m_batchSize) {
+        flushNoLock();
+    }
+}
+
+void SocketLogAppender::setFlushInterval(uint64_t ms) {
+    MutexType::Lock lock(m_mutex);
+    m_flushInterval = ms;
+}
+
+std::string SocketLogAppender::toYamlString() const {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "SocketLogAppender";
+    if (m_level != LogLevel::Level::UNKNOW)
+        node["level"] = LogLevel::ToString(m_level);
+    node["address"] = m_address;
+    if (m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    node["app_name"] = m_appName;
+    if (m_facility != kDefaultFacility)
+        node["facility"] = m_facility;
+    if (m_batchSize != kDefaultBatchSize)
+        node["batch_size"] = m_batchSize;
+    if (m_flushInterval != kDefaultFlushInterval)
+        node["flush_interval"] = m_flushInterval;
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+}
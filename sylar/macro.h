@@ -10,6 +10,7 @@
         SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ASSERTION: " #x \
             << "\nbacktrace:\n" \
             << sylar::BacktraceToString(100, 2, " -- "); \
+        sylar::RingBufferLogAppender::DumpAll("assertion"); \
         assert(x); \
     }
 
@@ -19,6 +20,7 @@
             << "\ninfo: " << w \
             << "\nbacktrace:\n" \
             << sylar::BacktraceToString(100, 2, " -- "); \
+        sylar::RingBufferLogAppender::DumpAll("assertion"); \
         assert(x); \
     }
 
@@ -1,5 +1,10 @@
 #include "thread.h"
 
+#include <linux/membarrier.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 #include "log.h"
 
 namespace sylar
@@ -108,4 +113,138 @@ void Semaphore::notify()
     }
 }
 
+thread_local Epoch::Record* Epoch::t_record = nullptr;
+
+static int Membarrier(int cmd) {
+    return syscall(__NR_membarrier, cmd, 0, 0);
+}
+
+// 线程退出时归还Record，供新线程复用
+struct EpochRecordHolder {
+    ~EpochRecordHolder() {
+        if (record) {
+            release(record);
+        }
+    }
+    void* record = nullptr;
+    void (*release)(void*) = nullptr;
+};
+
+static thread_local EpochRecordHolder t_epoch_holder;
+
+Epoch* Epoch::GetInstance() {
+    static Epoch* s_epoch = new Epoch;
+    return s_epoch;
+}
+
+Epoch::Epoch() {
+    int cmds = Membarrier(MEMBARRIER_CMD_QUERY);
+    if (cmds > 0 && (cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED)) {
+        m_membarrier = Membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED) == 0;
+    }
+}
+
+Epoch::Record* Epoch::acquireRecord() {
+    Record* rec = nullptr;
+    for (Record* i = m_records.load(std::memory_order_acquire); i; i = i->next) {
+        bool expect = false;
+        if (!i->used.load(std::memory_order_relaxed)
+                && i->used.compare_exchange_strong(expect, true, std::memory_order_acquire)) {
+            rec = i;
+            break;
+        }
+    }
+
+    if (!rec) {
+        rec = new Record;
+        rec->used.store(true, std::memory_order_relaxed);
+        Record* head = m_records.load(std::memory_order_relaxed);
+        do {
+            rec->next = head;
+        } while (!m_records.compare_exchange_weak(head, rec, std::memory_order_release));
+    }
+
+    t_record = rec;
+    t_epoch_holder.record = rec;
+    t_epoch_holder.release = [](void* r) { ReleaseRecord(static_cast<Record*>(r)); };
+    return rec;
+}
+
+void Epoch::ReleaseRecord(Record* rec) {
+    rec->depth = 0;
+    rec->epoch.store(0, std::memory_order_relaxed);
+    rec->used.store(false, std::memory_order_release);
+    t_record = nullptr;
+}
+
+void Epoch::retire(std::function<void()> deleter) {
+    {
+        Mutex::Lock lock(m_mutex);
+        m_retired.push_back({m_epoch.load(std::memory_order_relaxed), std::move(deleter)});
+    }
+
+    // 自己在临界区内时等不到自己离开，留给下次回收
+    if (t_record && t_record->depth) {
+        collect();
+        return;
+    }
+    uint64_t deadline = GetMonotonicMS() + 10;
+    for (int i = 0; collect() && GetMonotonicMS() < deadline; ++i) {
+        if (i < 100) {
+            sched_yield();
+        } else {
+            usleep(100);
+        }
+    }
+}
+
+size_t Epoch::collect() {
+    std::vector<Retired> ready;
+    size_t left = 0;
+    {
+        Mutex::Lock lock(m_mutex);
+        if (m_retired.empty()) {
+            return 0;
+        }
+
+        // 让所有读者此前的epoch store对本线程可见
+        if (m_membarrier) {
+            Membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED);
+        } else {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        uint64_t cur = m_epoch.load(std::memory_order_relaxed);
+        uint64_t min = UINT64_MAX;
+        for (Record* i = m_records.load(std::memory_order_acquire); i; i = i->next) {
+            uint64_t e = i->epoch.load(std::memory_order_acquire);
+            if (e && e < min) {
+                min = e;
+            }
+        }
+
+        // 活跃读者都已在当前epoch，推进一代
+        if (min >= cur) {
+            m_epoch.store(cur + 1, std::memory_order_release);
+        }
+
+        // 退休时的epoch早于所有活跃读者，说明它们都是在替换之后进入的
+        for (auto it = m_retired.begin(); it != m_retired.end();) {
+            if (it->epoch < min) {
+                ready.push_back(std::move(*it));
+                it = m_retired.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        left = m_retired.size();
+    }
+
+    // 在锁外释放，deleter可能再次retire
+    for (auto& i : ready) {
+        i.deleter();
+    }
+    return left;
+}
+
 } // namespace sylar
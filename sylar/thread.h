@@ -8,6 +8,7 @@
 #include <semaphore.h>
 #include <stdint.h>
 #include <atomic>
+#include <vector>
 
 #include "singleton.h" // disable copy
 
@@ -265,6 +266,172 @@ private:
     SYLAR_DISABLE_COPY(RWMutex)
 };
 
+// 有界无锁队列(Dmitry Vyukov bounded MPMC)
+// 多生产者入队互不阻塞，容量向上取整为2的幂
+// 也允许多个消费者，AsyncLogAppender的drop_oldest策略依赖这一点
+template <typename T>
+class BoundedQueue {
+public:
+    BoundedQueue(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) {
+            n <<= 1;
+        }
+        m_mask = n - 1;
+        m_cells.reset(new Cell[n]);
+        for (size_t i = 0; i < n; ++i) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // 队列满时返回false，v保持不变
+    bool tryPush(T& v) {
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if (dif == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return false; // full
+            } else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(v);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 队列空时返回false
+    bool tryPop(T& v) {
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (dif == 0) {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return false; // empty
+            } else {
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        v = std::move(cell->data);
+        cell->data = T();
+        cell->seq.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 并发下只是近似值
+    bool empty() const {
+        return m_dequeuePos.load(std::memory_order_acquire)
+            >= m_enqueuePos.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+    // 已占用的入队位置总数(含尚未写完的)
+    size_t enqueued() const { return m_enqueuePos.load(std::memory_order_acquire); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<size_t> m_enqueuePos {0};
+    alignas(64) std::atomic<size_t> m_dequeuePos {0};
+
+private:
+    SYLAR_DISABLE_COPY(BoundedQueue)
+};
+
+// 基于epoch的延迟回收(EBR)，用于读多写少的共享指针
+// 读者用ReadGuard包住对共享对象的访问；写者原子替换指针后把旧对象交给retire()
+// 旧对象在所有进入过旧epoch的读者离开后才释放
+// 支持membarrier(2)时读者只需一次普通store，屏障代价由写者承担
+class Epoch {
+public:
+    class ReadGuard {
+    public:
+        ReadGuard() { Epoch::GetInstance()->enter(); }
+        ~ReadGuard() { Epoch::GetInstance()->leave(); }
+    private:
+        SYLAR_DISABLE_COPY(ReadGuard)
+    };
+
+    // 不析构，退出阶段仍可能有读者
+    static Epoch* GetInstance();
+
+    void enter() {
+        Record* rec = t_record;
+        if (!rec) {
+            rec = acquireRecord();
+        }
+        if (rec->depth++ == 0) {
+            rec->epoch.store(m_epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+            if (m_membarrier) {
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+            } else {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+    }
+
+    void leave() {
+        Record* rec = t_record;
+        if (--rec->depth == 0) {
+            rec->epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    // 登记待释放对象并尝试回收
+    // 不在读临界区内时最多等待约10ms让旧读者离开，调用返回后通常已释放
+    void retire(std::function<void()> deleter);
+    // 回收已无读者的对象，返回剩余数量
+    size_t collect();
+
+private:
+    struct Record {
+        std::atomic<uint64_t> epoch {0};    // 0表示不在临界区
+        uint32_t depth = 0;                 // 嵌套深度，仅所属线程访问
+        std::atomic<bool> used {false};
+        Record* next = nullptr;
+    };
+
+    struct Retired {
+        uint64_t epoch;
+        std::function<void()> deleter;
+    };
+
+    Epoch();
+    Record* acquireRecord();
+    static void ReleaseRecord(Record* rec);
+
+private:
+    static thread_local Record* t_record;
+
+    std::atomic<uint64_t> m_epoch {1};
+    std::atomic<Record*> m_records {nullptr};
+    bool m_membarrier = false;
+
+    Mutex m_mutex;
+    std::vector<Retired> m_retired;
+
+private:
+    SYLAR_DISABLE_COPY(Epoch)
+};
+
 class Thread {
 public:
     using ptr = std::shared_ptr<Thread>;
@@ -4,6 +4,7 @@
 #include <sys/types.h>
 #include <sys/syscall.h>
 #include <execinfo.h>
+#include <time.h>
 
 
 #include "fiber.h"
@@ -19,10 +20,20 @@ static ::sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
 namespace sylar {
 
+#if defined(__linux__)
+static thread_local pid_t t_tid = 0;
+
+// fork后子进程沿用了父进程线程的缓存，需要清掉
+[[maybe_unused]] static int s_tid_atfork = pthread_atfork(nullptr, nullptr, [](){ t_tid = 0; });
+#endif
+
 pid_t GetThreadId() {
 #if defined(__linux__)
-    // 返回linux系统的线程号
-    return syscall(SYS_gettid);
+    // 返回linux系统的线程号，每个线程只做一次系统调用
+    if (!t_tid) {
+        t_tid = syscall(SYS_gettid);
+    }
+    return t_tid;
 #elif defined(_WIN32)
     // do not support windows now
     static_assert(false);
@@ -33,6 +44,52 @@ uint32_t GetFiberId() {
     return sylar::Fiber::GetFiberId();
 }
 
+struct ClockCalibration {
+    int64_t offset = 0;     // realtime - monotonic
+    uint64_t nextSync = 0;  // 下次校准时的monotonic时间
+    uint64_t last = 0;
+};
+
+static thread_local ClockCalibration t_clock;
+
+static const uint64_t s_ns_per_sec = 1000000000ull;
+
+uint64_t GetCurrentNS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t mono = ts.tv_sec * s_ns_per_sec + ts.tv_nsec;
+
+    ClockCalibration& c = t_clock;
+    if (mono >= c.nextSync) {
+        struct timespec rt;
+        clock_gettime(CLOCK_REALTIME, &rt);
+        c.offset = (int64_t)(rt.tv_sec * s_ns_per_sec + rt.tv_nsec) - (int64_t)mono;
+        c.nextSync = mono + s_ns_per_sec;
+    }
+
+    uint64_t now = mono + c.offset;
+    if (now < c.last) {
+        // 墙上时钟被往回调时保持单调
+        now = c.last;
+    }
+    c.last = now;
+    return now;
+}
+
+uint64_t GetCurrentMS() {
+    return GetCurrentNS() / 1000000ull;
+}
+
+uint64_t GetMonotonicNS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * s_ns_per_sec + ts.tv_nsec;
+}
+
+uint64_t GetMonotonicMS() {
+    return GetMonotonicNS() / 1000000ull;
+}
+
 void Backtrace(std::vector<std::string> &bt, [[maybe_unused]] int size, int skip) {
 #ifdef BOOST_STACKTRACE_USE_BACKTRACE
     auto vec = boost::stacktrace::stacktrace().as_vector();
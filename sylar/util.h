@@ -11,6 +11,16 @@ namespace sylar {
 pid_t GetThreadId();
 uint32_t GetFiberId();
 
+// 自epoch起的纳秒数
+// 取CLOCK_MONOTONIC加上每秒校准一次的墙上时钟偏移，同一线程内单调不回退
+// 墙上时钟被往回调时会停住，只用作事件时间戳
+uint64_t GetCurrentNS();
+uint64_t GetCurrentMS();
+
+// CLOCK_MONOTONIC，不受墙上时钟调整影响，用于计算间隔和超时
+uint64_t GetMonotonicNS();
+uint64_t GetMonotonicMS();
+
 void Backtrace(std::vector<std::string>& bt, int size, int skip = 1);
 std::string BacktraceToString(int size, int skip = 2, const std::string& prefix = "    ");
 
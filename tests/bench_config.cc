@@ -0,0 +1,157 @@
+// ConfigVar读取吞吐：快照句柄、线程私有副本Cached vs 原来的ConfigRWMutex读锁
+// 每种 实现 x 值类型 x 线程数 输出一行CSV；-w指定写者间隔时另有一个线程持续setValue
+// usage: bench_config [-n count] [-t max_threads] [-w write_interval_us] [-o output]
+#include "sylar/sylar.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+
+// 原来的getValue: 读锁内返回引用
+template <class T>
+class RWMutexVar {
+public:
+    RWMutexVar(const T& v) : m_val(v) {}
+    const T& getValue() const {
+        sylar::ConfigRWMutex::ReadLock lock(m_mutex);
+        return m_val;
+    }
+    void setValue(const T& v) {
+        sylar::ConfigRWMutex::WriteLock lock(m_mutex);
+        m_val = v;
+    }
+private:
+    T m_val;
+    mutable sylar::ConfigRWMutex m_mutex;
+};
+
+static uint64_t use(uint32_t v) { return v; }
+static uint64_t use(const std::string& v) { return v.size(); }
+
+static uint32_t make_value(uint32_t*, uint64_t n) { return 128 * 1024 + n % 2; }
+static std::string make_value(std::string*, uint64_t n) { return std::string(32 + n % 2, 'v'); }
+
+template <class Var, class Read, class T>
+static double run(Var& var, Read read, T*, int threads, int count, int write_us) {
+    std::atomic<int> ready {0};
+    std::atomic<bool> go {false};
+    std::atomic<bool> stop {false};
+    std::atomic<uint64_t> sink {0};
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < threads; ++i) {
+        thrs.push_back(std::make_shared<sylar::Thread>([&](){
+            // 每个线程一份读取函数，Cached的副本为线程私有
+            Read reader = read;
+            ++ready;
+            while (!go.load(std::memory_order_acquire)) {
+            }
+            uint64_t sum = 0;
+            for (int n = 0; n < count; ++n) {
+                sum += reader(var);
+            }
+            sink += sum;
+        }, "bench_" + std::to_string(i)));
+    }
+    sylar::Thread::ptr writer;
+    if (write_us > 0) {
+        writer = std::make_shared<sylar::Thread>([&](){
+            for (uint64_t n = 0; !stop.load(std::memory_order_relaxed); ++n) {
+                var.setValue(make_value((T*)nullptr, n));
+                usleep(write_us);
+            }
+        }, "bench_writer");
+    }
+    while (ready < threads) {
+        usleep(100);
+    }
+
+    uint64_t start = sylar::GetCurrentNS();
+    go.store(true, std::memory_order_release);
+    for (auto& i : thrs) {
+        i->join();
+    }
+    uint64_t used = sylar::GetCurrentNS() - start;
+    stop = true;
+    if (writer) {
+        writer->join();
+    }
+    return (double)threads * count * 1e9 / (used ? used : 1);
+}
+
+template <class T>
+static void bench(FILE* fp, const char* type, int max_threads, int count, int write_us) {
+    auto snapshot = sylar::Config::Lookup<T>(std::string("bench.") + type,
+            make_value((T*)nullptr, 0), "bench config");
+    RWMutexVar<T> rwmutex(make_value((T*)nullptr, 0));
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double v = run(*snapshot, [](const sylar::ConfigVar<T>& var) {
+            return use(*var.getValue());
+        }, (T*)nullptr, threads, count, write_us);
+        fprintf(fp, "snapshot,%s,%d,%d,%d,%.0f,%.2f\n", type, threads, write_us,
+                count * threads, v, threads * 1e9 / v);
+        v = run(*snapshot, [cached = typename sylar::ConfigVar<T>::Cached(snapshot)]
+                (const sylar::ConfigVar<T>&) mutable {
+            return use(cached.get());
+        }, (T*)nullptr, threads, count, write_us);
+        fprintf(fp, "cached,%s,%d,%d,%d,%.0f,%.2f\n", type, threads, write_us,
+                count * threads, v, threads * 1e9 / v);
+        v = run(rwmutex, [](const RWMutexVar<T>& var) {
+            return use(var.getValue());
+        }, (T*)nullptr, threads, count, write_us);
+        fprintf(fp, "rwmutex,%s,%d,%d,%d,%.0f,%.2f\n", type, threads, write_us,
+                count * threads, v, threads * 1e9 / v);
+        fflush(fp);
+    }
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [-n count] [-t max_threads] [-w write_interval_us] [-o output]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    int count = 5000000;
+    int max_threads = 4;
+    int write_us = 0;
+    std::string output;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:w:o:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = atoi(optarg);
+                break;
+            case 't':
+                max_threads = atoi(optarg);
+                break;
+            case 'w':
+                write_us = atoi(optarg);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (count <= 0 || max_threads <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE* fp = stdout;
+    if (!output.empty()) {
+        fp = fopen(output.c_str(), "w");
+        if (!fp) {
+            fprintf(stderr, "open output failed: %s\n", output.c_str());
+            return 1;
+        }
+    }
+    // ns_per_read为单个线程看到的每次读取耗时
+    fprintf(fp, "impl,type,threads,write_us,reads,reads_per_sec,ns_per_read\n");
+    bench<uint32_t>(fp, "uint32", max_threads, count, write_us);
+    bench<std::string>(fp, "string", max_threads, count, write_us);
+    if (fp != stdout) {
+        fclose(fp);
+    }
+    return 0;
+}
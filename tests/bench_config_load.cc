@@ -0,0 +1,128 @@
+// 大配置的加载耗时：按节点转换 vs 原来的逐元素字符串往返
+// 生成n条路由的YAML(每条3个上游)，每种实现加载r次取平均，输出一行CSV
+// usage: bench_config_load [-n entries] [-r rounds] [-o output]
+#include "sylar/sylar.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+
+using Routes = std::map<std::string, std::vector<std::string> >;
+
+static auto g_routes = sylar::Config::Lookup("bench.routes", Routes(), "bench routes");
+
+// 原来的LexicalCast: 每个子节点输出成字符串后再YAML::Load
+static std::vector<std::string> legacy_vector(const std::string& v) {
+    YAML::Node node = YAML::Load(v);
+    std::vector<std::string> vec;
+    std::stringstream ss;
+    for (size_t i = 0; i < node.size(); ++i) {
+        ss.str("");
+        ss << node[i];
+        vec.push_back(ss.str());
+    }
+    return vec;
+}
+
+static Routes legacy_routes(const std::string& v) {
+    YAML::Node node = YAML::Load(v);
+    Routes routes;
+    std::stringstream ss;
+    for (auto it = node.begin(); it != node.end(); ++it) {
+        ss.str("");
+        ss << it->second;
+        routes.insert(std::make_pair(it->first.Scalar(), legacy_vector(ss.str())));
+    }
+    return routes;
+}
+
+static std::string generate(int n) {
+    std::stringstream ss;
+    ss << "bench:\n  routes:\n";
+    for (int i = 0; i < n; ++i) {
+        ss << "    route_" << i << ": [10.0." << i % 256 << ".1:80, 10.0." << i % 256
+           << ".2:80, 10.0." << i % 256 << ".3:80]\n";
+    }
+    return ss.str();
+}
+
+// 原来的LoadFromYaml对非标量先输出整棵子树
+static void load_legacy(const YAML::Node& root) {
+    std::stringstream ss;
+    ss << root["bench"]["routes"];
+    g_routes->setValue(legacy_routes(ss.str()));
+}
+
+static void load_node(const YAML::Node& root) {
+    sylar::Config::LoadFromYaml(root);
+}
+
+template <class Load>
+static double run(Load load, const YAML::Node& root, int rounds) {
+    uint64_t used = 0;
+    for (int i = 0; i < rounds; ++i) {
+        g_routes->setValue(Routes());
+        uint64_t start = sylar::GetCurrentNS();
+        load(root);
+        used += sylar::GetCurrentNS() - start;
+    }
+    return used / 1e6 / rounds;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [-n entries] [-r rounds] [-o output]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    int entries = 10000;
+    int rounds = 5;
+    std::string output;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:r:o:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                entries = atoi(optarg);
+                break;
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (entries <= 0 || rounds <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE* fp = stdout;
+    if (!output.empty()) {
+        fp = fopen(output.c_str(), "w");
+        if (!fp) {
+            fprintf(stderr, "open output failed: %s\n", output.c_str());
+            return 1;
+        }
+    }
+    std::string yaml = generate(entries);
+    uint64_t start = sylar::GetCurrentNS();
+    YAML::Node root = YAML::Load(yaml);
+    double parse_ms = (sylar::GetCurrentNS() - start) / 1e6;
+
+    double legacy_ms = run(load_legacy, root, rounds);
+    SYLAR_ASSERT(g_routes->getValue()->size() == (size_t)entries);
+    double node_ms = run(load_node, root, rounds);
+    SYLAR_ASSERT(g_routes->getValue()->size() == (size_t)entries);
+
+    // parse_ms为YAML::Load整个文件的耗时，两种实现相同，不计入load_ms
+    fprintf(fp, "impl,entries,yaml_bytes,parse_ms,load_ms\n");
+    fprintf(fp, "legacy,%d,%zu,%.2f,%.2f\n", entries, yaml.size(), parse_ms, legacy_ms);
+    fprintf(fp, "node,%d,%zu,%.2f,%.2f\n", entries, yaml.size(), parse_ms, node_ms);
+    if (fp != stdout) {
+        fclose(fp);
+    }
+    return 0;
+}
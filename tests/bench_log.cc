@@ -0,0 +1,171 @@
+// 日志吞吐与单次调用延迟
+// 按 appender x 格式 x 线程数 组合运行，每组输出一行CSV，便于不同提交之间diff
+// 以不同LogMutex编译的bench_log_<lock>输出相同的列，结果可以直接拼接对比
+// usage: bench_log [-n count] [-t max_threads] [-o output]
+#include "sylar/sylar.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+
+#if defined(SYLAR_LOG_MUTEX)
+static const char* s_lock = "mutex";
+#elif defined(SYLAR_LOG_SPINLOCK)
+static const char* s_lock = "spinlock";
+#elif defined(SYLAR_LOG_CASLOCK)
+static const char* s_lock = "caslock";
+#else
+static const char* s_lock = "unknown";
+#endif
+
+static const char* s_file = "bench_log.out";
+
+static const std::pair<const char*, const char*> s_patterns[] = {
+    {"simple", "%m%n"},
+    {"full", "%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n"},
+};
+
+static const char* s_appenders[] = {"stdout", "file", "mmap", "async"};
+
+static sylar::LogAppender::ptr create_appender(const std::string& type) {
+    ::unlink(s_file);
+    if (type == "stdout") {
+        return std::make_shared<sylar::StdoutLogAppender>();
+    } else if (type == "file") {
+        return std::make_shared<sylar::FileLogAppender>(s_file);
+    } else if (type == "mmap") {
+        return std::make_shared<sylar::MmapFileLogAppender>(s_file);
+    }
+    return std::make_shared<sylar::AsyncLogAppender>(
+            std::make_shared<sylar::FileLogAppender>(s_file));
+}
+
+struct Result {
+    double msgs_per_sec;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+};
+
+static uint64_t percentile(std::vector<uint32_t>& v, double p) {
+    size_t n = std::min(v.size() - 1, (size_t)(v.size() * p));
+    std::nth_element(v.begin(), v.begin() + n, v.end());
+    return v[n];
+}
+
+static Result run(const std::string& appender, const char* pattern, int threads, int count) {
+    auto logger = std::make_shared<sylar::Logger>("bench");
+    auto ap = create_appender(appender);
+    ap->setFormatter(std::make_shared<sylar::LogFormatter>(pattern));
+    logger->addAppender(ap);
+
+    std::vector<std::vector<uint32_t> > latency(threads);
+    std::atomic<int> ready {0};
+    std::atomic<bool> go {false};
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < threads; ++i) {
+        latency[i].resize(count);
+        thrs.push_back(std::make_shared<sylar::Thread>([&, i](){
+            uint32_t* out = latency[i].data();
+            ++ready;
+            while (!go.load(std::memory_order_acquire)) {
+            }
+            for (int n = 0; n < count; ++n) {
+                uint64_t start = sylar::GetCurrentNS();
+                SYLAR_LOG_INFO(logger) << "bench message " << n << " value " << 3.14;
+                out[n] = sylar::GetCurrentNS() - start;
+            }
+        }, "bench_" + std::to_string(i)));
+    }
+    while (ready < threads) {
+        usleep(100);
+    }
+
+    uint64_t start = sylar::GetCurrentNS();
+    go.store(true, std::memory_order_release);
+    for (auto& i : thrs) {
+        i->join();
+    }
+    // 计入异步队列和缓冲区写出的时间
+    logger->flush();
+    uint64_t used = sylar::GetCurrentNS() - start;
+
+    std::vector<uint32_t> all;
+    all.reserve((size_t)threads * count);
+    for (auto& i : latency) {
+        all.insert(all.end(), i.begin(), i.end());
+    }
+    Result r;
+    r.msgs_per_sec = all.size() * 1e9 / (used ? used : 1);
+    r.p50 = percentile(all, 0.5);
+    r.p99 = percentile(all, 0.99);
+    r.p999 = percentile(all, 0.999);
+    r.max = *std::max_element(all.begin(), all.end());
+    return r;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [-n count] [-t max_threads] [-o output]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    int count = 50000;
+    int max_threads = 4;
+    std::string output;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:o:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = atoi(optarg);
+                break;
+            case 't':
+                max_threads = atoi(optarg);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (count <= 0 || max_threads <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // stdout appender写到/dev/null，结果写到原来的stdout或-o指定的文件
+    std::cout.flush();
+    FILE* fp = nullptr;
+    if (output.empty()) {
+        fp = fdopen(dup(STDOUT_FILENO), "w");
+    } else {
+        fp = fopen(output.c_str(), "w");
+    }
+    if (!fp) {
+        fprintf(stderr, "open output failed: %s\n", output.c_str());
+        return 1;
+    }
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+
+    fprintf(fp, "lock,appender,pattern,threads,messages,msgs_per_sec,p50_ns,p99_ns,p999_ns,max_ns\n");
+    for (auto appender : s_appenders) {
+        for (auto& pattern : s_patterns) {
+            for (int threads = 1; threads <= max_threads; threads *= 2) {
+                Result r = run(appender, pattern.second, threads, count);
+                fprintf(fp, "%s,%s,%s,%d,%d,%.0f,%lu,%lu,%lu,%lu\n",
+                        s_lock, appender, pattern.first, threads, count * threads,
+                        r.msgs_per_sec, r.p50, r.p99, r.p999, r.max);
+                fflush(fp);
+            }
+        }
+    }
+    ::unlink(s_file);
+    fclose(fp);
+    return 0;
+}
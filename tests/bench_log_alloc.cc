@@ -0,0 +1,82 @@
+// 统计每次日志调用的堆分配次数
+// 通过替换全局operator new计数，libsylar中的分配同样会被统计
+#include "sylar/sylar.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> s_allocs {0};
+
+void* operator new(size_t size) {
+    s_allocs.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+// 只读取消息，不做格式化和IO，用于单独衡量事件构造路径
+class NullLogAppender : public sylar::LogAppender {
+public:
+    void log(sylar::LogEvent::ptr event) override {
+        if (event->getLevel() >= m_level) {
+            m_bytes += event->getContentSize();
+        }
+    }
+    std::string toYamlString() const override { return "type: NullLogAppender"; }
+    uint64_t getBytes() const { return m_bytes; }
+private:
+    uint64_t m_bytes = 0;
+};
+
+static const int s_warmup = 1000;
+static const int s_count = 100000;
+
+static void run(const std::string& name, sylar::Logger::ptr logger) {
+    for (int i = 0; i < s_warmup; ++i) {
+        SYLAR_LOG_INFO(logger) << "warmup " << i << " " << 3.14;
+    }
+
+    uint64_t before = s_allocs.load();
+    for (int i = 0; i < s_count; ++i) {
+        SYLAR_LOG_INFO(logger) << "bench message " << i << " " << 3.14;
+    }
+    uint64_t stream_allocs = s_allocs.load() - before;
+
+    before = s_allocs.load();
+    for (int i = 0; i < s_count; ++i) {
+        SYLAR_LOG_FMT_INFO(logger, "bench fmt %d %s", i, "abc");
+    }
+    uint64_t fmt_allocs = s_allocs.load() - before;
+
+    std::cout << name
+        << " stream_allocs_per_call=" << (double)stream_allocs / s_count
+        << " fmt_allocs_per_call=" << (double)fmt_allocs / s_count
+        << std::endl;
+}
+
+int main(int argc, char** argv) {
+    sylar::Thread::SetName("bench_alloc");
+
+    auto null_logger = std::make_shared<sylar::Logger>("bench_null");
+    null_logger->addAppender(std::make_shared<NullLogAppender>());
+    run("event_path", null_logger);
+
+    auto file_logger = std::make_shared<sylar::Logger>("bench_file");
+    auto file_appender = std::make_shared<sylar::FileLogAppender>("/dev/null");
+    file_appender->setFormatter(std::make_shared<sylar::LogFormatter>(
+                "%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n"));
+    file_logger->addAppender(file_appender);
+    run("format_path", file_logger);
+    return 0;
+}
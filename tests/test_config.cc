@@ -110,13 +110,13 @@ void test_config() {
     sylar::ConfigVar<std::unordered_map<std::string, int> >::ptr g_str_int_umap_value_config =
         sylar::Config::Lookup("system.str_int_umap", std::unordered_map<std::string, int>{{"uk", 11}, {"up", 22}}, "system int str int umap");
 
-    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "before:" << g_int_value_config->getValue();
-    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "before:" << g_float_value_config->getValue();
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "before:" << *g_int_value_config->getValue();
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "before:" << *g_float_value_config->getValue();
 
 #define XX(g_var, name, prefix) \
     { \
-        auto& v = g_var->getValue();\
-        for (auto &i : v) { \
+        auto v = g_var->getValue();\
+        for (auto &i : *v) { \
             SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << #prefix " " #name ": " << i; \
         } \
         SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << #prefix " " #name " yaml: " << g_var->toString(); \
@@ -124,8 +124,8 @@ void test_config() {
 
 #define XX_M(g_var, name, prefix) \
     { \
-        auto& v = g_var->getValue();\
-        for (auto &i : v) { \
+        auto v = g_var->getValue();\
+        for (auto &i : *v) { \
             SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << #prefix " " #name ": {" << i.first << " - " << i.second << "}"; \
         } \
         SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << #prefix " " #name " yaml: " << g_var->toString(); \
@@ -141,8 +141,8 @@ void test_config() {
     YAML::Node root = YAML::LoadFile("conf/test.yml");
     sylar::Config::LoadFromYaml(root);
 
-    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "after:" << g_int_value_config->getValue();
-    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "after:" << g_float_value_config->getValue();
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "after:" << *g_int_value_config->getValue();
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "after:" << *g_float_value_config->getValue();
 
     
     XX(g_int_vec_value_config, int_vec, after);
@@ -239,21 +239,21 @@ void test_class() {
 #define XX_PM(g_var, prefix) \
     {\
         auto m = g_var->getValue(); \
-        for (auto& i : m) { \
+        for (auto& i : *m) { \
             SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << prefix << ": " << i.first << " - " << i.second.toString(); \
         } \
     }
 
-    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "before: " << g_person->getValue().toString() << " - " << g_person->toString();
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "before: " << g_person->getValue()->toString() << " - " << g_person->toString();
     XX_PM(g_person_map, "class.map before")
-    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "before: " << g_person_vec_map->getValue().size() << '\n' << g_person_vec_map->toString();
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "before: " << g_person_vec_map->getValue()->size() << '\n' << g_person_vec_map->toString();
 
     YAML::Node root = YAML::LoadFile("conf/test.yml");
     sylar::Config::LoadFromYaml(root);
 
-    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "after : " << g_person->getValue().toString() << " - " << g_person->toString();
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "after : " << g_person->getValue()->toString() << " - " << g_person->toString();
     XX_PM(g_person_map, "class.map after")
-    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "after: " << g_person_vec_map->getValue().size() << '\n' << g_person_vec_map->toString();
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "after: " << g_person_vec_map->getValue()->size() << '\n' << g_person_vec_map->toString();
 
 #undef XX_PM
 }
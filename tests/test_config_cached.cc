@@ -0,0 +1,82 @@
+#include "sylar/sylar.h"
+
+#include <unistd.h>
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+static sylar::ConfigVar<int>::ptr g_cached_int
+    = sylar::Config::Lookup("cached.int", (int)1, "cached int");
+static sylar::ConfigVar<std::string>::ptr g_cached_str
+    = sylar::Config::Lookup("cached.str", std::string("a"), "cached string");
+
+static thread_local sylar::ConfigVar<int>::Cached t_cached_int(g_cached_int);
+
+// setValue和LoadFromYaml之后get()看到新值，值未变时代数不变
+static void test_update() {
+    sylar::ConfigVar<std::string>::Cached str(g_cached_str);
+    SYLAR_ASSERT(t_cached_int.get() == 1);
+    SYLAR_ASSERT(*str == "a" && str->size() == 1);
+
+    uint64_t gen = sylar::ConfigVarBase::GetGeneration();
+    g_cached_int->setValue(1);
+    SYLAR_ASSERT(sylar::ConfigVarBase::GetGeneration() == gen);
+
+    g_cached_int->setValue(2);
+    SYLAR_ASSERT(sylar::ConfigVarBase::GetGeneration() > gen);
+    SYLAR_ASSERT(*t_cached_int == 2);
+
+    gen = sylar::ConfigVarBase::GetGeneration();
+    YAML::Node root = YAML::Load("cached:\n  int: 3\n  str: bbb\n");
+    sylar::Config::LoadFromYaml(root);
+    SYLAR_ASSERT(sylar::ConfigVarBase::GetGeneration() > gen);
+    SYLAR_ASSERT(t_cached_int.get() == 3);
+    SYLAR_ASSERT(*str == "bbb");
+
+    // 无关配置项的改变只导致一次多余的刷新
+    sylar::Config::Lookup("cached.other", (int)0, "cached other")->setValue(1);
+    SYLAR_ASSERT(t_cached_int.get() == 3 && *str == "bbb");
+    SYLAR_LOG_INFO(g_logger) << "update ok gen=" << sylar::ConfigVarBase::GetGeneration();
+}
+
+// 每个线程各自一份副本，其它线程setValue后都能看到最终值
+static void test_threads() {
+    std::atomic<bool> stop {false};
+    std::atomic<bool> monotonic {true};
+    std::atomic<int> finished {0};
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < 3; ++i) {
+        thrs.push_back(std::make_shared<sylar::Thread>([&](){
+            int last = 0;
+            while (!stop.load(std::memory_order_acquire)) {
+                int v = t_cached_int.get();
+                if (v < last) {
+                    monotonic = false;
+                }
+                last = v;
+            }
+            if (t_cached_int.get() == 1000) {
+                ++finished;
+            }
+        }, "cached_" + std::to_string(i)));
+    }
+    for (int i = 4; i <= 1000; ++i) {
+        g_cached_int->setValue(i);
+        if (i % 100 == 0) {
+            usleep(1000);
+        }
+    }
+    stop.store(true, std::memory_order_release);
+    for (auto& i : thrs) {
+        i->join();
+    }
+    SYLAR_ASSERT(monotonic);
+    SYLAR_ASSERT(finished == 3);
+    SYLAR_ASSERT(t_cached_int.get() == 1000);
+    SYLAR_LOG_INFO(g_logger) << "threads ok";
+}
+
+int main(int argc, char** argv) {
+    test_update();
+    test_threads();
+    return 0;
+}
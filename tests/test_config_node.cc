@@ -0,0 +1,125 @@
+#include "sylar/sylar.h"
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+// 只特化了字符串版本的自定义类型，走默认的节点<->字符串转换
+struct Point {
+    int x = 0;
+    int y = 0;
+    bool operator==(const Point& rhs) const { return x == rhs.x && y == rhs.y; }
+};
+
+namespace sylar {
+
+template <>
+class LexicalCast<std::string, Point> {
+public:
+    Point operator()(const std::string& v) {
+        YAML::Node node = YAML::Load(v);
+        Point p;
+        p.x = node["x"].as<int>();
+        p.y = node["y"].as<int>();
+        return p;
+    }
+};
+
+template <>
+class LexicalCast<Point, std::string> {
+public:
+    std::string operator()(const Point& p) {
+        YAML::Node node;
+        node["x"] = p.x;
+        node["y"] = p.y;
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+};
+
+}
+
+// 节点与字符串两条路径的结果一致
+template <class T>
+static bool round_trip(const T& v) {
+    YAML::Node node = sylar::LexicalCast<T, YAML::Node>()(v);
+    std::string str = sylar::LexicalCast<T, std::string>()(v);
+    return sylar::LexicalCast<YAML::Node, T>()(node) == v
+        && sylar::LexicalCast<std::string, T>()(str) == v
+        && sylar::LexicalCast<YAML::Node, T>()(YAML::Load(str)) == v;
+}
+
+static void test_cast() {
+    SYLAR_ASSERT(round_trip(std::vector<int>{1, 2, 3}));
+    SYLAR_ASSERT(round_trip(std::list<double>{1.5, -2}));
+    SYLAR_ASSERT(round_trip(std::set<std::string>{"a", "b"}));
+    SYLAR_ASSERT(round_trip(std::unordered_set<int>{7, 8}));
+    SYLAR_ASSERT(round_trip(std::map<std::string, std::vector<int>>{{"a", {1}}, {"b", {2, 3}}}));
+    SYLAR_ASSERT(round_trip(std::unordered_map<std::string, std::map<std::string, int>>{{"a", {{"x", 1}}}}));
+    SYLAR_ASSERT(round_trip(std::map<std::string, Point>{{"p", {1, 2}}, {"q", {3, 4}}}));
+    SYLAR_ASSERT(round_trip(std::vector<Point>{{5, 6}}));
+
+    // 字符串元素按原样保存，不会被当作YAML再解析一次
+    std::vector<std::string> strs {"a: b", "[1, 2]", "#x", " y "};
+    SYLAR_ASSERT(round_trip(strs));
+    YAML::Node node = sylar::LexicalCast<std::vector<std::string>, YAML::Node>()(strs);
+    SYLAR_ASSERT(node[0].IsScalar());
+
+    std::vector<int> empty = sylar::LexicalCast<YAML::Node, std::vector<int> >()(YAML::Load("~"));
+    SYLAR_ASSERT(empty.empty());
+    SYLAR_LOG_INFO(g_logger) << "cast ok";
+}
+
+// LoadFromYaml直接按节点设置，toNode与toString一致
+static void test_load() {
+    auto routes = sylar::Config::Lookup("node.routes",
+            std::map<std::string, std::vector<std::string>>(), "node routes");
+    auto point = sylar::Config::Lookup("node.point", Point(), "node point");
+    auto name = sylar::Config::Lookup("node.name", std::string(), "node name");
+
+    YAML::Node root = YAML::Load(
+        "node:\n"
+        "  name: hello world\n"
+        "  point: {x: 3, y: 4}\n"
+        "  routes:\n"
+        "    a: [h1, 'h2: 80']\n"
+        "    b: []\n");
+    sylar::Config::LoadFromYaml(root);
+    SYLAR_ASSERT(*name->getValue() == "hello world");
+    SYLAR_ASSERT(*point->getValue() == (Point{3, 4}));
+    auto r = routes->getValue();
+    SYLAR_ASSERT(r->size() == 2 && r->at("a").size() == 2 && r->at("a")[1] == "h2: 80");
+    SYLAR_ASSERT(r->at("b").empty());
+
+    std::stringstream ss;
+    ss << routes->toNode();
+    SYLAR_ASSERT(ss.str() == routes->toString());
+    SYLAR_ASSERT(routes->fromNode(routes->toNode()));
+
+    // 类型不符时报错，值不变
+    SYLAR_ASSERT(!point->fromNode(YAML::Load("[1, 2]")));
+    SYLAR_ASSERT(*point->getValue() == (Point{3, 4}));
+    SYLAR_LOG_INFO(g_logger) << "load ok";
+}
+
+// logs按节点加载
+static void test_logs() {
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: node_logger\n"
+        "    level: warn\n"
+        "    appenders:\n"
+        "      - type: StdoutLogAppender\n");
+    sylar::Config::LoadFromYaml(root);
+    SYLAR_ASSERT(SYLAR_LOG_NAME("node_logger")->getLevel() == sylar::LogLevel::WARN);
+    auto logs = sylar::Config::LookupBase("logs");
+    SYLAR_ASSERT(logs && logs->toNode().IsSequence() && logs->toNode().size() == 1);
+    SYLAR_ASSERT(logs->toNode()[0]["name"].as<std::string>() == "node_logger");
+    SYLAR_LOG_INFO(g_logger) << "logs ok";
+}
+
+int main(int argc, char** argv) {
+    test_cast();
+    test_load();
+    test_logs();
+    return 0;
+}
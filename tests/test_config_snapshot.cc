@@ -0,0 +1,130 @@
+#include "sylar/sylar.h"
+
+#include <unistd.h>
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+static std::atomic<int> s_live {0};
+
+// 统计存活的值对象数
+struct Counted {
+    Counted(int v = 0) : value(v) { ++s_live; }
+    Counted(const Counted& rhs) : value(rhs.value) { ++s_live; }
+    ~Counted() { --s_live; }
+    bool operator==(const Counted& rhs) const { return value == rhs.value; }
+    int value;
+};
+
+namespace sylar {
+
+template <>
+class LexicalCast<std::string, Counted> {
+public:
+    Counted operator()(const std::string& v) {
+        return Counted(std::stoi(v));
+    }
+};
+
+template <>
+class LexicalCast<Counted, std::string> {
+public:
+    std::string operator()(const Counted& v) {
+        return std::to_string(v.value);
+    }
+};
+
+}
+
+// 句柄持有的旧值在setValue之后仍然有效，句柄释放后旧值被回收
+static void test_handle() {
+    auto var = sylar::Config::Lookup("snapshot.str", std::string(64, 'a'), "snapshot string");
+    {
+        auto old = var->getValue();
+        var->setValue(std::string(64, 'b'));
+        SYLAR_ASSERT(*old == std::string(64, 'a'));
+        SYLAR_ASSERT(old->size() == 64);
+        SYLAR_ASSERT(*var->getValue() == std::string(64, 'b'));
+    }
+    SYLAR_ASSERT(var->toString() == std::string(64, 'b'));
+
+    auto counted = sylar::Config::Lookup("snapshot.counted", Counted(1), "snapshot counted");
+    int base = s_live;
+    {
+        auto h = counted->getValue();
+        counted->setValue(Counted(2));
+        counted->setValue(Counted(3));
+        SYLAR_ASSERT(h->value == 1);
+        SYLAR_ASSERT(counted->getValue()->value == 3);
+    }
+    sylar::Epoch::GetInstance()->collect();
+    SYLAR_ASSERT(s_live == base);
+    SYLAR_ASSERT(counted->fromString("7") && counted->getValue()->value == 7);
+    SYLAR_LOG_INFO(g_logger) << "handle ok";
+}
+
+// 读者与写者并发，读到的每个值都完整，结束后没有泄漏
+static void test_concurrent() {
+    auto var = sylar::Config::Lookup("snapshot.concurrent", std::string(100, '0'), "snapshot concurrent");
+    auto counted = sylar::Config::Lookup("snapshot.concurrent_counted", Counted(0), "snapshot counted");
+    int base = s_live;
+    std::atomic<bool> stop {false};
+    std::atomic<uint64_t> reads {0};
+    std::atomic<bool> consistent {true};
+
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < 3; ++i) {
+        thrs.push_back(std::make_shared<sylar::Thread>([&](){
+            uint64_t n = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                auto v = var->getValue();
+                if (v->size() != 100 || v->find_first_not_of((*v)[0]) != std::string::npos) {
+                    consistent = false;
+                }
+                n += counted->getValue()->value >= 0;
+            }
+            reads += n;
+        }, "snapshot_" + std::to_string(i)));
+    }
+
+    for (int i = 1; i <= 2000; ++i) {
+        var->setValue(std::string(100, '0' + i % 10));
+        counted->setValue(Counted(i));
+        if (i % 100 == 0) {
+            usleep(1000);
+        }
+    }
+    stop = true;
+    for (auto& i : thrs) {
+        i->join();
+    }
+    sylar::Epoch::GetInstance()->collect();
+
+    SYLAR_LOG_INFO(g_logger) << "concurrent reads=" << reads << " live=" << s_live - base;
+    SYLAR_ASSERT(consistent);
+    SYLAR_ASSERT(s_live == base);
+    SYLAR_ASSERT(counted->getValue()->value == 2000);
+}
+
+// 监听者看到的仍是替换前后的值
+static void test_listener() {
+    auto var = sylar::Config::Lookup("snapshot.listener", (int)1, "snapshot listener");
+    int seen_old = 0;
+    int seen_new = 0;
+    int current = 0;
+    var->addListener([&](const int& old_value, const int& new_value) {
+        seen_old = old_value;
+        seen_new = new_value;
+        current = *var->getValue();
+    });
+    var->setValue(5);
+    SYLAR_ASSERT(seen_old == 1 && seen_new == 5 && current == 1);
+    SYLAR_ASSERT(*var->getValue() == 5);
+    SYLAR_LOG_INFO(g_logger) << "listener ok";
+}
+
+int main(int argc, char** argv) {
+    test_handle();
+    test_concurrent();
+    test_listener();
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include "sylar/sylar.h"
+
+#include <unistd.h>
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+static auto g_host = sylar::Config::Lookup("txn.host", std::string("a"), "txn host");
+static auto g_port = sylar::Config::Lookup("txn.port", (int)1, "txn port");
+static auto g_list = sylar::Config::Lookup("txn.list", std::vector<int>{1}, "txn list");
+
+// 提交前不可见，提交后全部可见，只递增一次代数
+static void test_commit() {
+    uint64_t gen = sylar::ConfigVarBase::GetGeneration();
+    sylar::Config::Transaction txn;
+    txn.set(g_host, std::string("b"));
+    txn.set(g_port, 2);
+    txn.set(g_list, std::vector<int>{1});
+    SYLAR_ASSERT(txn.set("txn.list", YAML::Load("[1, 2, 3]")));
+    SYLAR_ASSERT(!txn.set("txn.port", YAML::Load("abc")));
+    SYLAR_ASSERT(!txn.set("txn.none", YAML::Load("1")));
+    SYLAR_ASSERT(txn.size() == 3);
+    SYLAR_ASSERT(*g_host->getValue() == "a" && *g_port->getValue() == 1);
+
+    SYLAR_ASSERT(txn.commit() == 3);
+    SYLAR_ASSERT(sylar::ConfigVarBase::GetGeneration() == gen + 1);
+    SYLAR_ASSERT(*g_host->getValue() == "b" && *g_port->getValue() == 2);
+    SYLAR_ASSERT(g_list->getValue()->size() == 3);
+    SYLAR_ASSERT(txn.size() == 0);
+
+    // 值未变时不算改变，也不递增代数
+    txn.set(g_port, 2);
+    SYLAR_ASSERT(txn.commit() == 0);
+    SYLAR_ASSERT(sylar::ConfigVarBase::GetGeneration() == gen + 1);
+
+    // 未提交的事务被丢弃
+    {
+        sylar::Config::Transaction discard;
+        discard.set(g_port, 100);
+    }
+    SYLAR_ASSERT(*g_port->getValue() == 2);
+    SYLAR_LOG_INFO(g_logger) << "commit ok";
+}
+
+// 监听者在全部替换后调用，同一项只回调一次
+static void test_listener() {
+    int calls = 0;
+    int old_port = 0;
+    int new_port = 0;
+    std::string host_seen;
+    auto key = g_port->addListener([&](const int& old_value, const int& new_value) {
+        ++calls;
+        old_port = old_value;
+        new_port = new_value;
+        host_seen = *g_host->getValue();
+    });
+
+    sylar::Config::Transaction txn;
+    txn.set(g_port, 3);
+    txn.set(g_port, 4);
+    txn.set(g_host, std::string("c"));
+    txn.commit();
+    SYLAR_ASSERT(calls == 1 && old_port == 2 && new_port == 4);
+    SYLAR_ASSERT(host_seen == "c");
+
+    // LoadFromYaml同样先全部替换再回调
+    YAML::Node root = YAML::Load("txn: {host: d, port: 5}");
+    sylar::Config::LoadFromYaml(root);
+    SYLAR_ASSERT(calls == 2 && old_port == 4 && new_port == 5 && host_seen == "d");
+    g_port->delListener(key);
+    SYLAR_LOG_INFO(g_logger) << "listener ok";
+}
+
+// 监听者交给executor执行，执行时旧值仍然有效
+static void test_executor() {
+    std::vector<std::function<void()> > tasks;
+    std::vector<int> old_seen;
+    auto key = g_list->addListener([&](const std::vector<int>& old_value, const std::vector<int>& new_value) {
+        old_seen = old_value;
+    });
+
+    sylar::Config::Transaction txn([&](std::function<void()> cb) { tasks.push_back(cb); });
+    txn.set(g_list, std::vector<int>{7, 8});
+    txn.set(g_port, 6);
+    SYLAR_ASSERT(txn.commit() == 2);
+    SYLAR_ASSERT(tasks.size() == 2 && old_seen.empty());
+
+    g_list->setValue(std::vector<int>{9});
+    sylar::Epoch::GetInstance()->collect();
+    for (auto& i : tasks) {
+        i();
+    }
+    SYLAR_ASSERT(old_seen == (std::vector<int>{1, 2, 3}));
+    tasks.clear();
+    g_list->delListener(key);
+    SYLAR_LOG_INFO(g_logger) << "executor ok";
+}
+
+// 监听者按首次暂存的顺序调用，与配置项地址无关
+static void test_order() {
+    std::vector<std::string> order;
+    auto k1 = g_host->addListener([&](const std::string&, const std::string&) { order.push_back("host"); });
+    auto k2 = g_port->addListener([&](const int&, const int&) { order.push_back("port"); });
+    auto k3 = g_list->addListener([&](const std::vector<int>&, const std::vector<int>&) { order.push_back("list"); });
+
+    sylar::Config::Transaction txn;
+    txn.set(g_port, 10);
+    txn.set(g_list, std::vector<int>{10});
+    txn.set(g_host, std::string("order"));
+    txn.set(g_port, 11);
+    txn.commit();
+    SYLAR_ASSERT(order == (std::vector<std::string>{"port", "list", "host"}));
+
+    order.clear();
+    txn.set(g_host, std::string("order2"));
+    txn.set(g_list, std::vector<int>{11});
+    txn.set(g_port, 12);
+    txn.commit();
+    SYLAR_ASSERT(order == (std::vector<std::string>{"host", "list", "port"}));
+
+    g_host->delListener(k1);
+    g_port->delListener(k2);
+    g_list->delListener(k3);
+    SYLAR_LOG_INFO(g_logger) << "order ok";
+}
+
+// 读者用ReadConsistent不会看到一半的提交
+static void test_consistent() {
+    auto a = sylar::Config::Lookup("txn.pair.a", (int)0, "txn pair a");
+    auto b = sylar::Config::Lookup("txn.pair.b", (int)0, "txn pair b");
+    std::atomic<bool> stop {false};
+    std::atomic<uint64_t> torn {0};
+    std::atomic<uint64_t> reads {0};
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < 2; ++i) {
+        thrs.push_back(std::make_shared<sylar::Thread>([&](){
+            uint64_t n = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                int va = 0;
+                int vb = 0;
+                sylar::Config::ReadConsistent([&]() {
+                    va = *a->getValue();
+                    vb = *b->getValue();
+                });
+                if (va != vb) {
+                    ++torn;
+                }
+                ++n;
+            }
+            reads += n;
+        }, "txn_" + std::to_string(i)));
+    }
+    for (int i = 1; i <= 2000; ++i) {
+        sylar::Config::Transaction txn;
+        txn.set(a, i);
+        txn.set(b, i);
+        txn.commit();
+        if (i % 100 == 0) {
+            usleep(1000);
+        }
+    }
+    stop = true;
+    for (auto& i : thrs) {
+        i->join();
+    }
+    SYLAR_LOG_INFO(g_logger) << "consistent reads=" << reads << " torn=" << torn;
+    SYLAR_ASSERT(torn == 0);
+    SYLAR_ASSERT(*a->getValue() == 2000 && *b->getValue() == 2000);
+}
+
+int main(int argc, char** argv) {
+    test_commit();
+    test_listener();
+    test_executor();
+    test_order();
+    test_consistent();
+    return 0;
+}
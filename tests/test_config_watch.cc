@@ -0,0 +1,169 @@
+#include "sylar/sylar.h"
+
+#include <unistd.h>
+
+#include <fstream>
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+// 记录fromNode的转换次数
+struct Tracked {
+    int value = 0;
+    bool operator==(const Tracked& rhs) const { return value == rhs.value; }
+};
+
+static int s_converted = 0;
+
+namespace sylar {
+
+template <>
+class LexicalCast<YAML::Node, Tracked> {
+public:
+    Tracked operator()(const YAML::Node& node) {
+        ++s_converted;
+        Tracked t;
+        t.value = node.as<int>();
+        return t;
+    }
+};
+
+template <>
+class LexicalCast<std::string, Tracked> {
+public:
+    Tracked operator()(const std::string& v) {
+        return LexicalCast<YAML::Node, Tracked>()(YAML::Load(v));
+    }
+};
+
+template <>
+class LexicalCast<Tracked, std::string> {
+public:
+    std::string operator()(const Tracked& v) {
+        return std::to_string(v.value);
+    }
+};
+
+}
+
+static auto g_a = sylar::Config::Lookup("watch.a", Tracked(), "watch a");
+static auto g_b = sylar::Config::Lookup("watch.group.b", Tracked(), "watch b");
+static auto g_c = sylar::Config::Lookup("watch.group.c", Tracked(), "watch c");
+
+static void write_file(const std::string& path, const std::string& content) {
+    std::ofstream ofs(path, std::ios::trunc);
+    ofs << content;
+}
+
+// 编辑器的保存方式：写临时文件后rename覆盖
+static void replace_file(const std::string& path, const std::string& content) {
+    write_file(path + ".tmp", content);
+    SYLAR_ASSERT(rename((path + ".tmp").c_str(), path.c_str()) == 0);
+}
+
+static bool wait_reloads(sylar::ConfigWatcher& watcher, uint64_t n) {
+    for (int i = 0; i < 300 && watcher.getReloads() < n; ++i) {
+        usleep(10 * 1000);
+    }
+    return watcher.getReloads() >= n;
+}
+
+// 只有子树变化的配置项被转换
+static void test_diff() {
+    YAML::Node v1 = YAML::Load("watch: {a: 1, group: {b: 2, c: 3}}");
+    sylar::Config::LoadFromYaml(v1);
+    SYLAR_ASSERT(s_converted == 3);
+
+    s_converted = 0;
+    YAML::Node v2 = YAML::Load("watch: {a: 1, group: {b: 2, c: 4}}");
+    sylar::Config::LoadFromYaml(v2, v1);
+    SYLAR_ASSERT(s_converted == 1);
+    SYLAR_ASSERT(g_c->getValue()->value == 4 && g_b->getValue()->value == 2);
+
+    s_converted = 0;
+    sylar::Config::LoadFromYaml(v2, v2);
+    SYLAR_ASSERT(s_converted == 0);
+
+    // 删除的项保持当前值，新增的项被加载
+    s_converted = 0;
+    YAML::Node v3 = YAML::Load("watch: {group: {b: 5, c: 4}}");
+    sylar::Config::LoadFromYaml(v3, v2);
+    SYLAR_ASSERT(s_converted == 1);
+    SYLAR_ASSERT(g_a->getValue()->value == 1 && g_b->getValue()->value == 5);
+    SYLAR_LOG_INFO(g_logger) << "diff ok";
+}
+
+static const char* s_logs =
+    "logs:\n"
+    "  - name: watch_x\n"
+    "    level: info\n"
+    "    appenders:\n"
+    "      - type: FileLogAppender\n"
+    "        file: test_config_watch_x.log\n"
+    "  - name: watch_y\n"
+    "    level: %s\n"
+    "    appenders:\n"
+    "      - type: FileLogAppender\n"
+    "        file: test_config_watch_y.log\n";
+
+static std::string config_text(int a, int b, const char* level) {
+    char logs[1024];
+    snprintf(logs, sizeof(logs), s_logs, level);
+    return "watch:\n  a: " + std::to_string(a) + "\n  group:\n    b: " + std::to_string(b)
+        + "\n    c: 4\n" + logs;
+}
+
+// 文件改写后自动增量加载，未改变的日志器保留原来的appender
+static void test_watch() {
+    std::string path = "test_config_watch.yml";
+    write_file(path, config_text(10, 20, "info"));
+
+    sylar::ConfigWatcher watcher(20);
+    s_converted = 0;
+    SYLAR_ASSERT(watcher.watch(path));
+    SYLAR_ASSERT(g_a->getValue()->value == 10 && g_b->getValue()->value == 20);
+    auto x_appender = SYLAR_LOG_NAME("watch_x")->getAppenders().front();
+    auto y_appender = SYLAR_LOG_NAME("watch_y")->getAppenders().front();
+
+    int a_changed = 0;
+    int b_changed = 0;
+    g_a->addListener([&](const Tracked&, const Tracked&) { ++a_changed; });
+    g_b->addListener([&](const Tracked&, const Tracked&) { ++b_changed; });
+
+    s_converted = 0;
+    write_file(path, config_text(11, 20, "info"));
+    SYLAR_ASSERT(wait_reloads(watcher, 1));
+    SYLAR_ASSERT(g_a->getValue()->value == 11);
+    SYLAR_ASSERT(s_converted == 1 && a_changed == 1 && b_changed == 0);
+    SYLAR_ASSERT(SYLAR_LOG_NAME("watch_x")->getAppenders().front() == x_appender);
+
+    replace_file(path, config_text(11, 21, "error"));
+    SYLAR_ASSERT(wait_reloads(watcher, 2));
+    SYLAR_ASSERT(g_b->getValue()->value == 21 && a_changed == 1 && b_changed == 1);
+    SYLAR_ASSERT(SYLAR_LOG_NAME("watch_y")->getLevel() == sylar::LogLevel::ERROR);
+    SYLAR_ASSERT(SYLAR_LOG_NAME("watch_y")->getAppenders().front() != y_appender);
+    SYLAR_ASSERT(SYLAR_LOG_NAME("watch_x")->getAppenders().front() == x_appender);
+
+    // 写坏的文件不生效，修好后继续加载
+    write_file(path, "watch: {a: [1\n");
+    usleep(200 * 1000);
+    SYLAR_ASSERT(watcher.getReloads() == 2 && g_a->getValue()->value == 11);
+    write_file(path, config_text(12, 21, "error"));
+    SYLAR_ASSERT(wait_reloads(watcher, 3));
+    SYLAR_ASSERT(g_a->getValue()->value == 12);
+
+    watcher.stop();
+    write_file(path, config_text(13, 21, "error"));
+    usleep(100 * 1000);
+    SYLAR_ASSERT(g_a->getValue()->value == 12);
+
+    ::unlink(path.c_str());
+    ::unlink("test_config_watch_x.log");
+    ::unlink("test_config_watch_y.log");
+    SYLAR_LOG_INFO(g_logger) << "watch ok reloads=" << watcher.getReloads();
+}
+
+int main(int argc, char** argv) {
+    test_diff();
+    test_watch();
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "sylar/sylar.h"
+
+#include <unistd.h>
+
+#include <fstream>
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+static const int s_thread_num = 4;
+static const int s_count = 20000;
+
+static size_t count_lines(const std::string& filename) {
+    std::ifstream ifs(filename);
+    std::string line;
+    size_t n = 0;
+    while (std::getline(ifs, line)) {
+        ++n;
+    }
+    return n;
+}
+
+static void test_policy(sylar::AsyncLogAppender::OverflowPolicy policy) {
+    std::string filename = std::string("async_") 
+        + sylar::AsyncLogAppender::PolicyToString(policy) + ".log";
+    ::unlink(filename.c_str());
+
+    auto logger = std::make_shared<sylar::Logger>("async");
+    auto sink = std::make_shared<sylar::FileLogAppender>(filename);
+    auto appender = std::make_shared<sylar::AsyncLogAppender>(sink, 256, policy);
+    appender->setFormatter(std::make_shared<sylar::LogFormatter>("%t%T%N%T%m%n"));
+    logger->addAppender(appender);
+
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < s_thread_num; ++i) {
+        thrs.push_back(std::make_shared<sylar::Thread>([logger](){
+            for (int n = 0; n < s_count; ++n) {
+                SYLAR_LOG_INFO(logger) << "async message " << n;
+            }
+        }, "async_" + std::to_string(i)));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    appender->flush();
+
+    size_t lines = count_lines(filename);
+    SYLAR_LOG_INFO(g_logger) << "policy=" << sylar::AsyncLogAppender::PolicyToString(policy)
+        << " lines=" << lines << " dropped=" << appender->getDropped();
+    SYLAR_ASSERT(lines + appender->getDropped() == (size_t)s_thread_num * s_count);
+    if (policy == sylar::AsyncLogAppender::OverflowPolicy::BLOCK) {
+        SYLAR_ASSERT(appender->getDropped() == 0);
+    }
+}
+
+// 慢速输出，记录事件所属logger的名字
+class SlowLogAppender : public sylar::LogAppender {
+public:
+    void log(sylar::LogEvent::ptr event) override {
+        usleep(100);
+        MutexType::Lock lock(m_mutex);
+        m_names.push_back(event->getLogger()->getName());
+    }
+    std::string toYamlString() const override { return ""; }
+    std::vector<std::string> m_names;
+};
+
+// 移除异步appender时写完队列中的事件，之后logger析构不留下悬空指针
+static void test_remove() {
+    auto sink = std::make_shared<SlowLogAppender>();
+    for (int i = 0; i < 2; ++i) {
+        sink->m_names.clear();
+        auto logger = std::make_shared<sylar::Logger>("async_remove");
+        auto appender = std::make_shared<sylar::AsyncLogAppender>(sink, 1024);
+        logger->addAppender(appender);
+        for (int n = 0; n < 200; ++n) {
+            SYLAR_LOG_INFO(logger) << "remove " << n;
+        }
+        if (i == 0) {
+            logger->delAppender(appender);
+        } else {
+            logger->clearAppenders();
+        }
+        SYLAR_ASSERT2(sink->m_names.size() == 200, sink->m_names.size());
+        logger.reset();
+        appender->flush();
+        for (auto& name : sink->m_names) {
+            SYLAR_ASSERT(name == "async_remove");
+        }
+    }
+    SYLAR_LOG_INFO(g_logger) << "async remove ok";
+}
+
+int main(int argc, char** argv) {
+    test_remove();
+    test_policy(sylar::AsyncLogAppender::OverflowPolicy::BLOCK);
+    test_policy(sylar::AsyncLogAppender::OverflowPolicy::DROP_NEWEST);
+    test_policy(sylar::AsyncLogAppender::OverflowPolicy::DROP_OLDEST);
+
+    YAML::Node root = YAML::LoadFile(__ROOT_DIR__ "conf/log_async.yml");
+    sylar::Config::LoadFromYaml(root);
+    std::cout << sylar::LoggerMgr::GetInstance()->toYamlString() << std::endl;
+
+    SYLAR_LOG_INFO(g_logger) << "async root";
+    SYLAR_LOG_WARN(SYLAR_LOG_NAME("system")) << "async system";
+    sylar::LoggerMgr::GetInstance()->flush();
+    return 0;
+}
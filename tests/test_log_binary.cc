@@ -0,0 +1,216 @@
+#include "sylar/sylar.h"
+
+#include <unistd.h>
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+static const char* s_pattern = "%p%T%c%T%t%T%N%T%F%T%f{r}:%l%T%m%n";
+static const int s_thread_num = 4;
+static const int s_count = 50000;
+
+// 收集格式化后的文本
+class StringLogAppender : public sylar::LogAppender {
+public:
+    using ptr = std::shared_ptr<StringLogAppender>;
+    void log(sylar::LogEvent::ptr event) override {
+        MutexType::Lock lock(m_mutex);
+        m_text.append(event->getFormatted(*m_formatter, m_buffer));
+    }
+    std::string toYamlString() const override { return ""; }
+    std::string m_text;
+};
+
+static void log_all(sylar::Logger::ptr logger) {
+    const char* null_str = nullptr;
+    long double ld = 1.25;
+    SYLAR_LOG_FMT_INFO(logger, "int %d %i %u %x %o", -42, 7, -1, 255u, 8);
+    SYLAR_LOG_FMT_INFO(logger, "long %ld %lu %lld %llx %zu", -1L, 2UL, -3LL, 0xdeadbeefULL, (size_t)5);
+    SYLAR_LOG_FMT_WARN(logger, "char %c short %hd %hhd %hu", 'x', (short)-2, 300, 70000);
+    SYLAR_LOG_FMT_ERROR(logger, "float %f %.3f %e %g %10.2f %Lf", 3.14159, 2.5f, 1e10, 0.0001, -1.5, ld);
+    SYLAR_LOG_FMT_DEBUG(logger, "str [%s] [%10s] [%-5s] [%.2s] [%s]", "abc", "right", "l", "truncate", null_str);
+    SYLAR_LOG_FMT_INFO(logger, "star [%*d] [%-*d] [%.*s] [%*.*f]", 6, 42, 4, 7, 3, "abcdef", 8, 2, 3.14159);
+    SYLAR_LOG_FMT_INFO(logger, "misc %% %p %#x %+d %05d", (void*)0x1234, 255, 3, 42);
+    SYLAR_LOG_FMT_FATAL(logger, "bool %d enum %d", true, sylar::LogLevel::FATAL);
+}
+
+// 文本与二进制解码结果逐字相同
+static void test_same_text() {
+    auto logger = std::make_shared<sylar::Logger>("binary");
+    auto appender = std::make_shared<StringLogAppender>();
+    appender->setFormatter(std::make_shared<sylar::LogFormatter>(s_pattern));
+    logger->addAppender(appender);
+
+    log_all(logger);
+    std::string text = appender->m_text;
+
+    logger->setBinary(true);
+    log_all(logger);
+    logger->flush();
+    SYLAR_ASSERT(appender->m_text == text);
+
+    sylar::LogFormatter formatter(s_pattern);
+    sylar::BinaryLogReader reader(sylar::BinaryLog::GetInstance()->getFilename());
+    SYLAR_ASSERT(reader.isOpen());
+    std::string decoded;
+    while (reader.next(formatter, decoded)) {
+    }
+    std::cout << decoded;
+    SYLAR_ASSERT(decoded == text);
+    SYLAR_ASSERT(!reader.isTruncated());
+    logger->setBinary(false);
+    SYLAR_LOG_INFO(g_logger) << "binary same text ok";
+}
+
+// 可写缓冲复用时内容改变，必须走文本路径
+static void buffer_site(sylar::Logger::ptr logger, const char* text) {
+    char fmt[32];
+    snprintf(fmt, sizeof(fmt), "%s %%d", text);
+    SYLAR_LOG_FMT_INFO(logger, fmt, 1);
+}
+
+static void test_non_literal() {
+    auto logger = std::make_shared<sylar::Logger>("binary_buffer");
+    auto appender = std::make_shared<StringLogAppender>();
+    appender->setFormatter(std::make_shared<sylar::LogFormatter>("%m%n"));
+    logger->addAppender(appender);
+    logger->setBinary(true);
+    buffer_site(logger, "first");
+    buffer_site(logger, "second");
+    SYLAR_ASSERT2(appender->m_text == "first 1\nsecond 1\n", appender->m_text);
+    logger->setBinary(false);
+}
+
+// 被限速丢弃的条数与文本路径一样追加到下一条
+static void rate_all(sylar::Logger::ptr logger) {
+    for (int i = 0; i < 4; ++i) {
+        if (i == 3) {
+            usleep(150 * 1000);
+        }
+        SYLAR_LOG_FMT_INFO(logger, "rate %d", i);
+    }
+}
+
+static void test_suppressed() {
+    auto logger = std::make_shared<sylar::Logger>("binary_rate");
+    auto appender = std::make_shared<StringLogAppender>();
+    appender->setFormatter(std::make_shared<sylar::LogFormatter>("%m%n"));
+    logger->addAppender(appender);
+    logger->setRateLimit(10, 1);
+    rate_all(logger);
+    std::string text = appender->m_text;
+    SYLAR_ASSERT2(text == "rate 0\nrate 3 [suppressed 2]\n", text);
+
+    logger->setRateLimit(10, 1);
+    logger->setBinary(true);
+    rate_all(logger);
+    logger->flush();
+    SYLAR_ASSERT(appender->m_text == text);
+
+    sylar::LogFormatter formatter("%c %m%n");
+    sylar::BinaryLogReader reader(sylar::BinaryLog::GetInstance()->getFilename());
+    std::string decoded;
+    while (reader.next(formatter, decoded)) {
+    }
+    SYLAR_ASSERT(decoded.find("binary_rate rate 0\nbinary_rate rate 3 [suppressed 2]\n") != std::string::npos);
+    logger->setBinary(false);
+    SYLAR_LOG_INFO(g_logger) << "binary suppressed ok";
+}
+
+static void forced_site(sylar::Logger::ptr logger) {
+    SYLAR_LOG_FMT_DEBUG(logger, "forced %d", 1);
+}
+
+// 调用点开关放行的事件走文本路径，只有匹配本logger的规则时才输出
+static void test_forced() {
+    auto logger = std::make_shared<sylar::Logger>("binary_forced");
+    logger->setLevel(sylar::LogLevel::INFO);
+    auto appender = std::make_shared<StringLogAppender>();
+    appender->setFormatter(std::make_shared<sylar::LogFormatter>("%m%n"));
+    logger->addAppender(appender);
+    logger->setBinary(true);
+
+    sylar::LogSiteRule rule;
+    SYLAR_ASSERT(sylar::LogSiteRule::Parse("forced_site()", rule));
+    auto other = std::make_shared<sylar::Logger>("binary_forced_other");
+    other->setDebugSites({rule});
+    forced_site(logger);
+    SYLAR_ASSERT(appender->m_text.empty());
+
+    logger->setDebugSites({rule});
+    forced_site(logger);
+    SYLAR_ASSERT(appender->m_text == "forced 1\n");
+    logger->flush();
+
+    sylar::LogFormatter formatter("%m%n");
+    sylar::BinaryLogReader reader(sylar::BinaryLog::GetInstance()->getFilename());
+    std::string decoded;
+    while (reader.next(formatter, decoded)) {
+    }
+    SYLAR_ASSERT(decoded.find("forced") == std::string::npos);
+    logger->setBinary(false);
+    SYLAR_LOG_INFO(g_logger) << "binary forced ok";
+}
+
+// 多线程写入，暂存区多次回绕
+static void test_threads() {
+    auto logger = std::make_shared<sylar::Logger>("threads");
+    logger->setBinary(true);
+
+    uint64_t start = sylar::GetCurrentNS();
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < s_thread_num; ++i) {
+        thrs.push_back(std::make_shared<sylar::Thread>([logger](){
+            for (int n = 0; n < s_count; ++n) {
+                SYLAR_LOG_FMT_INFO(logger, "binary message %d %s %f", n, "payload", n * 0.5);
+            }
+        }, "binary_" + std::to_string(i)));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    uint64_t used = sylar::GetCurrentNS() - start;
+    logger->flush();
+
+    sylar::LogFormatter formatter("%N %m%n");
+    sylar::BinaryLogReader reader(sylar::BinaryLog::GetInstance()->getFilename());
+    std::string out;
+    std::map<std::string, int> next;
+    size_t total = 0;
+    while (reader.next(formatter, out)) {
+        // 只校验本测试的记录，每个线程内按顺序
+        if (out.compare(0, 7, "binary_") == 0) {
+            std::string thread = out.substr(0, out.find(' '));
+            int n = atoi(out.c_str() + out.find("message ") + 8);
+            SYLAR_ASSERT(next[thread] == n);
+            ++next[thread];
+            ++total;
+        }
+        out.clear();
+    }
+    SYLAR_ASSERT(total == (size_t)s_thread_num * s_count);
+    SYLAR_LOG_INFO(g_logger) << "binary threads ok, "
+        << used / (s_thread_num * s_count) << "ns/record";
+}
+
+int main(int argc, char** argv) {
+    ::unlink("binary.blog");
+    SYLAR_ASSERT(sylar::BinaryLog::GetInstance()->open("binary.blog"));
+    SYLAR_ASSERT(!sylar::BinaryLog::GetInstance()->open("other.blog"));
+
+    test_same_text();
+    test_forced();
+    test_non_literal();
+    test_suppressed();
+    test_threads();
+
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: binary_conf\n"
+        "    level: info\n"
+        "    binary: binary.blog\n");
+    sylar::Config::LoadFromYaml(root);
+    SYLAR_ASSERT(SYLAR_LOG_NAME("binary_conf")->isBinary());
+    std::cout << sylar::LoggerMgr::GetInstance()->toYamlString() << std::endl;
+    SYLAR_LOG_FMT_INFO(SYLAR_LOG_NAME("binary_conf"), "from config %d", 1);
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "sylar/sylar.h"
+
+#include <unistd.h>
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+static std::atomic<int> s_live {0};
+static std::atomic<uint64_t> s_logged {0};
+
+// 统计存活实例数和收到的事件数
+class CountLogAppender : public sylar::LogAppender {
+public:
+    CountLogAppender(uint32_t sleep_ms = 0) : m_sleep(sleep_ms) { ++s_live; }
+    ~CountLogAppender() { --s_live; }
+    void log(sylar::LogEvent::ptr event) override {
+        if (event->getLevel() >= m_level) {
+            if (m_sleep) {
+                usleep(m_sleep * 1000);
+            }
+            ++s_logged;
+        }
+    }
+    std::string toYamlString() const override { return ""; }
+private:
+    uint32_t m_sleep;
+};
+
+// 多线程持续写日志，同时另一线程反复增删appender和修改级别
+static void test_reconfigure() {
+    auto logger = std::make_shared<sylar::Logger>("cow");
+    std::atomic<bool> stop {false};
+
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < 3; ++i) {
+        thrs.push_back(std::make_shared<sylar::Thread>([logger, &stop](){
+            while (!stop) {
+                SYLAR_LOG_INFO(logger) << "cow message";
+            }
+        }, "cow_" + std::to_string(i)));
+    }
+
+    for (int i = 0; i < 2000; ++i) {
+        auto a = std::make_shared<CountLogAppender>();
+        logger->addAppender(a);
+        logger->addAppender(std::make_shared<CountLogAppender>());
+        logger->setLevel(i % 2 ? sylar::LogLevel::INFO : sylar::LogLevel::ERROR);
+        a->setLevel(i % 3 ? sylar::LogLevel::DEBUG : sylar::LogLevel::FATAL);
+        logger->delAppender(a);
+        if (i % 10 == 0) {
+            logger->clearAppenders();
+        }
+    }
+
+    stop = true;
+    for (auto& i : thrs) {
+        i->join();
+    }
+    logger->clearAppenders();
+    sylar::Epoch::GetInstance()->collect();
+
+    SYLAR_LOG_INFO(g_logger) << "reconfigure logged=" << s_logged << " live=" << s_live;
+    SYLAR_ASSERT(s_logged > 0);
+    SYLAR_ASSERT(s_live == 0);
+}
+
+// appender在做慢I/O时，修改配置和其它线程的日志都不被阻塞
+static void test_no_block() {
+    auto logger = std::make_shared<sylar::Logger>("slow");
+    logger->addAppender(std::make_shared<CountLogAppender>(300));
+
+    sylar::Thread slow([logger](){
+        SYLAR_LOG_INFO(logger) << "slow message";
+    }, "slow");
+    usleep(50 * 1000);
+
+    uint64_t start = sylar::GetCurrentMS();
+    logger->clearAppenders();
+    logger->addAppender(std::make_shared<CountLogAppender>());
+    SYLAR_LOG_INFO(logger) << "fast message";
+    uint64_t used = sylar::GetCurrentMS() - start;
+    slow.join();
+
+    SYLAR_LOG_INFO(g_logger) << "reconfigure during slow log took " << used << "ms";
+    SYLAR_ASSERT(used < 200);
+
+    logger->clearAppenders();
+    sylar::Epoch::GetInstance()->collect();
+    SYLAR_ASSERT(s_live == 0);
+}
+
+int main(int argc, char** argv) {
+    test_reconfigure();
+    test_no_block();
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include "sylar/sylar.h"
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+// 收集格式化后的文本
+class StringLogAppender : public sylar::LogAppender {
+public:
+    using ptr = std::shared_ptr<StringLogAppender>;
+    void log(sylar::LogEvent::ptr event) override {
+        if (accept(*event)) {
+            MutexType::Lock lock(m_mutex);
+            m_text.append(event->getFormatted(*m_formatter, m_buffer));
+        }
+    }
+    std::string toYamlString() const override { return ""; }
+    std::string take() {
+        MutexType::Lock lock(m_mutex);
+        std::string text;
+        text.swap(m_text);
+        return text;
+    }
+private:
+    std::string m_text;
+};
+
+static sylar::Logger::ptr s_logger;
+static StringLogAppender::ptr s_appender;
+
+static void site_a() {
+    SYLAR_LOG_DEBUG(s_logger) << "a";
+}
+
+static const int s_line_b = __LINE__ + 2;
+static void site_b() {
+    SYLAR_LOG_DEBUG(s_logger) << "b";
+    SYLAR_LOG_FMT_DEBUG(s_logger, "%s", "b2");
+}
+
+static void site_c() {
+    SYLAR_LOG_FORMAT_DEBUG(s_logger, "c{}", 3);
+}
+
+static std::string run_all() {
+    site_a();
+    site_b();
+    site_c();
+    return s_appender->take();
+}
+
+static std::vector<sylar::LogSiteRule> rules(std::initializer_list<std::string> strs) {
+    std::vector<sylar::LogSiteRule> v;
+    for (auto& i : strs) {
+        sylar::LogSiteRule rule;
+        SYLAR_ASSERT2(sylar::LogSiteRule::Parse(i, rule), i);
+        v.push_back(rule);
+    }
+    return v;
+}
+
+static void test_parse() {
+    sylar::LogSiteRule rule;
+    SYLAR_ASSERT(sylar::LogSiteRule::Parse("sylar/fiber.cc:100-200", rule));
+    SYLAR_ASSERT(rule.file == "sylar/fiber.cc" && rule.begin == 100 && rule.end == 200);
+    SYLAR_ASSERT(rule.toString() == "sylar/fiber.cc:100-200");
+    SYLAR_ASSERT(rule.match("/root/sylar/fiber.cc", 150, "run"));
+    SYLAR_ASSERT(!rule.match("/root/sylar/fiber.cc", 201, "run"));
+    SYLAR_ASSERT(!rule.match("/root/mysylar/fiber.cc", 150, "run"));
+
+    SYLAR_ASSERT(sylar::LogSiteRule::Parse("fiber.cc:120", rule));
+    SYLAR_ASSERT(rule.begin == 120 && rule.end == 120 && rule.toString() == "fiber.cc:120");
+    SYLAR_ASSERT(sylar::LogSiteRule::Parse("fiber.cc", rule));
+    SYLAR_ASSERT(rule.match("fiber.cc", 1, "f") && rule.toString() == "fiber.cc");
+    SYLAR_ASSERT(sylar::LogSiteRule::Parse("Scheduler::run()", rule));
+    SYLAR_ASSERT(rule.func == "run" && rule.match("a.cc", 1, "run") && !rule.match("a.cc", 1, "runx"));
+
+    SYLAR_ASSERT(!sylar::LogSiteRule::Parse("", rule));
+    SYLAR_ASSERT(!sylar::LogSiteRule::Parse("fiber.cc:", rule));
+    SYLAR_ASSERT(!sylar::LogSiteRule::Parse("fiber.cc:20-10", rule));
+    SYLAR_ASSERT(!sylar::LogSiteRule::Parse("fiber.cc:1x", rule));
+    SYLAR_ASSERT(!sylar::LogSiteRule::Parse("()", rule));
+    SYLAR_LOG_INFO(g_logger) << "parse ok";
+}
+
+static void test_rules() {
+    s_logger = std::make_shared<sylar::Logger>("sites");
+    s_logger->setLevel(sylar::LogLevel::INFO);
+    s_appender = std::make_shared<StringLogAppender>();
+    s_appender->setFormatter(std::make_shared<sylar::LogFormatter>("%p %m%n"));
+    s_appender->setLevel(sylar::LogLevel::INFO);
+    s_logger->addAppender(s_appender);
+
+    SYLAR_ASSERT(run_all().empty());
+
+    s_logger->setDebugSites(rules({"site_a()"}));
+    SYLAR_ASSERT(run_all() == "DEBUG a\n");
+    SYLAR_ASSERT(sylar::LogSiteSwitch::EnabledCount() == 1);
+
+    s_logger->setDebugSites(rules({"test_log_debug_sites.cc:" + std::to_string(s_line_b)}));
+    SYLAR_ASSERT(run_all() == "DEBUG b\n");
+
+    s_logger->setDebugSites(rules({"tests/test_log_debug_sites.cc:" + std::to_string(s_line_b)
+                + "-" + std::to_string(s_line_b + 1), "site_c()"}));
+    SYLAR_ASSERT(run_all() == "DEBUG b\nDEBUG b2\nDEBUG c3\n");
+
+    s_logger->setDebugSites(rules({"test_log_debug_sites.cc"}));
+    SYLAR_ASSERT(run_all() == "DEBUG a\nDEBUG b\nDEBUG b2\nDEBUG c3\n");
+
+    // 其它logger的规则打开了开关，但不输出到本logger
+    auto other = std::make_shared<sylar::Logger>("sites_other");
+    other->setDebugSites(rules({"site_a()"}));
+    s_logger->setDebugSites({});
+    SYLAR_ASSERT(sylar::LogSiteSwitch::EnabledCount() == 1);
+    SYLAR_ASSERT(run_all().empty());
+    other.reset();
+    SYLAR_ASSERT(sylar::LogSiteSwitch::EnabledCount() == 0);
+
+    // 级别本身通过时照常输出
+    s_logger->setLevel(sylar::LogLevel::DEBUG);
+    s_appender->setLevel(sylar::LogLevel::DEBUG);
+    SYLAR_ASSERT(run_all() == "DEBUG a\nDEBUG b\nDEBUG b2\nDEBUG c3\n");
+    s_logger->setLevel(sylar::LogLevel::INFO);
+    s_appender->setLevel(sylar::LogLevel::INFO);
+    SYLAR_LOG_INFO(g_logger) << "rules ok";
+}
+
+static void test_config() {
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: sites_conf\n"
+        "    level: info\n"
+        "    debug:\n"
+        "      - site_a()\n"
+        "      - test_log_debug_sites.cc:" + std::to_string(s_line_b) + "\n"
+        "    appenders:\n"
+        "      - type: StdoutLogAppender\n"
+        "        level: info\n");
+    sylar::Config::LoadFromYaml(root);
+    auto logger = SYLAR_LOG_NAME("sites_conf");
+    SYLAR_ASSERT(logger->getDebugSites().size() == 2);
+    std::string yaml = logger->toYamlString();
+    std::cout << yaml << std::endl;
+    SYLAR_ASSERT(yaml.find("site_a()") != std::string::npos);
+
+    auto appender = std::make_shared<StringLogAppender>();
+    appender->setFormatter(std::make_shared<sylar::LogFormatter>("%c %p %m%n"));
+    appender->setLevel(sylar::LogLevel::INFO);
+    logger->addAppender(appender);
+    auto saved = s_logger;
+    s_logger = logger;
+    run_all();
+    s_logger = saved;
+    SYLAR_ASSERT(appender->take() == "sites_conf DEBUG a\nsites_conf DEBUG b\n");
+
+    root = YAML::Load(
+        "logs:\n"
+        "  - name: sites_conf\n"
+        "    level: info\n");
+    sylar::Config::LoadFromYaml(root);
+    SYLAR_ASSERT(logger->getDebugSites().empty());
+    SYLAR_ASSERT(sylar::LogSiteSwitch::EnabledCount() == 0);
+    SYLAR_LOG_INFO(g_logger) << "config ok";
+}
+
+// 没有规则时被过滤的DEBUG调用的开销
+static void bench_disabled() {
+    const int n = 10000000;
+    uint64_t start = sylar::GetCurrentNS();
+    for (int i = 0; i < n; ++i) {
+        SYLAR_LOG_DEBUG(s_logger) << "filtered " << i;
+    }
+    uint64_t used = sylar::GetCurrentNS() - start;
+    SYLAR_LOG_INFO(g_logger) << "disabled debug call " << (double)used / n << "ns";
+}
+
+int main(int argc, char** argv) {
+    test_parse();
+    test_rules();
+    test_config();
+    bench_disabled();
+    return 0;
+}
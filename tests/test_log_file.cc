@@ -0,0 +1,132 @@
+#include "sylar/sylar.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <fstream>
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+static size_t count_lines(const std::string& filename) {
+    std::ifstream ifs(filename);
+    std::string line;
+    size_t n = 0;
+    while (std::getline(ifs, line)) {
+        ++n;
+    }
+    return n;
+}
+
+static bool exists(const std::string& filename) {
+    return ::access(filename.c_str(), F_OK) == 0;
+}
+
+static void remove_all(const std::string& filename) {
+    ::unlink(filename.c_str());
+    for (int i = 1; i < 10; ++i) {
+        ::unlink((filename + "." + std::to_string(i)).c_str());
+    }
+}
+
+static sylar::Logger::ptr make_logger(sylar::LogAppender::ptr appender) {
+    auto logger = std::make_shared<sylar::Logger>("file");
+    appender->setFormatter(std::make_shared<sylar::LogFormatter>("%m%n"));
+    logger->addAppender(appender);
+    return logger;
+}
+
+// 每行10字节，max_size=1000即每个文件100行
+static void test_size_rotate() {
+    std::string filename = "file_rotate.log";
+    remove_all(filename);
+
+    auto appender = std::make_shared<sylar::FileLogAppender>(filename);
+    appender->setMaxSize(1000);
+    appender->setMaxFiles(3);
+    auto logger = make_logger(appender);
+    for (int i = 0; i < 500; ++i) {
+        SYLAR_LOG_INFO(logger) << "line " << (1000 + i);
+    }
+    appender->flush();
+
+    SYLAR_ASSERT(count_lines(filename) == 100);
+    SYLAR_ASSERT(count_lines(filename + ".1") == 100);
+    SYLAR_ASSERT(count_lines(filename + ".3") == 100);
+    SYLAR_ASSERT(!exists(filename + ".4"));
+
+    std::ifstream ifs(filename + ".1");
+    std::string line;
+    std::getline(ifs, line);
+    SYLAR_ASSERT(line == "line 1300");
+    SYLAR_LOG_INFO(g_logger) << "size rotate ok";
+}
+
+// 未达到buffer_size时只靠后台定时器写出
+static void test_flush_interval() {
+    std::string filename = "file_flush.log";
+    remove_all(filename);
+
+    auto appender = std::make_shared<sylar::FileLogAppender>(filename);
+    appender->setFlushInterval(200);
+    auto logger = make_logger(appender);
+    SYLAR_LOG_INFO(logger) << "buffered";
+    SYLAR_ASSERT(count_lines(filename) == 0);
+    ::usleep(500 * 1000);
+    SYLAR_ASSERT(count_lines(filename) == 1);
+
+    SYLAR_LOG_ERROR(logger) << "error flushed immediately";
+    SYLAR_ASSERT(count_lines(filename) == 2);
+    SYLAR_LOG_INFO(g_logger) << "flush interval ok";
+}
+
+// 模拟logrotate：改名后发SIGHUP，之后的日志写入新文件
+static void test_sighup() {
+    std::string filename = "file_sighup.log";
+    remove_all(filename);
+    sylar::FileLogAppender::InstallSighupHandler();
+
+    auto appender = std::make_shared<sylar::FileLogAppender>(filename);
+    auto logger = make_logger(appender);
+    SYLAR_LOG_INFO(logger) << "before";
+    appender->flush();
+
+    ::rename(filename.c_str(), (filename + ".1").c_str());
+    ::raise(SIGHUP);
+    SYLAR_LOG_INFO(logger) << "after";
+    appender->flush();
+
+    SYLAR_ASSERT(count_lines(filename + ".1") == 1);
+    SYLAR_ASSERT(count_lines(filename) == 1);
+    SYLAR_LOG_INFO(g_logger) << "sighup reopen ok";
+}
+
+// 取值无法转换时打印错误并忽略该appender，不抛出异常
+static void test_bad_config() {
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: file_bad\n"
+        "    level: info\n"
+        "    appenders:\n"
+        "      - type: FileLogAppender\n"
+        "        file: file_bad.log\n"
+        "        flush_interval: abc\n"
+        "        max_files: -1\n"
+        "        reopen_on_sighup: maybe\n");
+    sylar::Config::LoadFromYaml(root);
+    std::string yaml = sylar::LoggerMgr::GetInstance()->toYamlString();
+    SYLAR_ASSERT(yaml.find("file_bad.log") == std::string::npos);
+    SYLAR_LOG_INFO(g_logger) << "bad config ok";
+}
+
+int main(int argc, char** argv) {
+    test_size_rotate();
+    test_flush_interval();
+    test_sighup();
+    test_bad_config();
+
+    YAML::Node root = YAML::LoadFile(__ROOT_DIR__ "conf/log_file.yml");
+    sylar::Config::LoadFromYaml(root);
+    std::cout << sylar::LoggerMgr::GetInstance()->toYamlString() << std::endl;
+    SYLAR_LOG_INFO(SYLAR_LOG_NAME("system")) << "file system";
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include "sylar/sylar.h"
+
+#include <iomanip>
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+using sylar::LogFormat;
+
+// 编译期检查
+static_assert(LogFormat::Check<>("plain {{}}"));
+static_assert(LogFormat::Check<int, const char*>("{} {}"));
+static_assert(LogFormat::Check<double, unsigned>("{:.3f} {:08x}"));
+static_assert(LogFormat::Check<std::string, void*>("{:>10s} {:p}"));
+static_assert(!LogFormat::Check<int>("{} {}"));
+static_assert(!LogFormat::Check<int, int>("{}"));
+static_assert(!LogFormat::Check<int>("{:.2f}"));
+static_assert(!LogFormat::Check<const char*>("{:d}"));
+static_assert(!LogFormat::Check<int>("{0}"));
+static_assert(!LogFormat::Check<int>("{"));
+static_assert(!LogFormat::Check<int>("} {}"));
+static_assert(!LogFormat::Check<std::vector<int> >("{}"));
+
+// 收集消息内容
+class MessageLogAppender : public sylar::LogAppender {
+public:
+    void log(sylar::LogEvent::ptr event) override {
+        m_message = event->getContent();
+    }
+    std::string toYamlString() const override { return ""; }
+    std::string m_message;
+};
+
+enum Color { RED = 1, GREEN = 2 };
+
+struct Point {
+    int x;
+    int y;
+};
+
+static std::ostream& operator<<(std::ostream& os, const Point& p) {
+    return os << "(" << p.x << "," << p.y << ")";
+}
+
+static void test_format() {
+    auto logger = std::make_shared<sylar::Logger>("format");
+    auto appender = std::make_shared<MessageLogAppender>();
+    logger->addAppender(appender);
+    auto& msg = appender->m_message;
+
+#define CHECK(expect, ...) \
+    SYLAR_LOG_FORMAT_INFO(logger, __VA_ARGS__); \
+    SYLAR_ASSERT2(msg == expect, msg)
+
+    CHECK("no args", "no args");
+    CHECK("{braces}", "{{braces}}");
+    CHECK("int 42 -7 18446744073709551615", "int {} {} {}", 42, -7, (uint64_t)-1);
+    CHECK("min -9223372036854775808", "min {}", INT64_MIN);
+    CHECK("hex ff FF 0x00ff 377 101", "hex {:x} {:X} 0x{:04x} {:o} {:b}", 255, 255, 255, 255, 5);
+    CHECK("pad [   42] [42   ] [-0042]", "pad [{:5}] [{:<5}] [{:05}]", 42, 42, -42);
+    CHECK("char x 120 A", "char {} {:d} {:c}", 'x', 'x', 65);
+    CHECK("bool true false 1", "bool {} {} {:d}", true, false, true);
+    CHECK("float 3.14159 0.1 2.500 1.000000e+10 1e-05", "float {} {} {:.3f} {:e} {:g}",
+            3.14159, 0.1, 2.5, 1e10, 0.00001);
+    CHECK("float pad [  1.50] [-01.5] [1.5   ]", "float pad [{:6.2f}] [{:05}] [{:<6}]", 1.5, -1.5, 1.5f);
+    std::string str = "string";
+    std::string_view view = "view";
+    const char* null_str = nullptr;
+    CHECK("str string view lit (null) [ab   ] [   ab] [str]", "str {} {} {} {} [{:5}] [{:>5}] [{:.3}]",
+            str, view, "lit", null_str, "ab", "ab", str);
+    CHECK("ptr 0x1234", "ptr {}", (void*)0x1234);
+    CHECK("enum 2 stream (1,2)", "enum {} stream {}", GREEN, Point{1, 2});
+#undef CHECK
+
+    // 长于内联缓冲的消息
+    std::string big(2000, 'z');
+    SYLAR_LOG_FORMAT_INFO(logger, "{}{}", big, 1);
+    SYLAR_ASSERT(msg == big + "1");
+    SYLAR_LOG_INFO(g_logger) << "format ok";
+}
+
+// 日志宏用在不带花括号的if/else里时，else属于调用方的if
+static void test_else() {
+    auto logger = std::make_shared<sylar::Logger>("format_else");
+    auto appender = std::make_shared<MessageLogAppender>();
+    logger->addAppender(appender);
+    for (int i = 0; i < 2; ++i) {
+        bool c = i == 0;
+        int r = 0;
+        if (c) SYLAR_LOG_INFO(logger) << "a"; else r |= 1;
+        if (c) SYLAR_LOG_INFO_EVERY_N(logger, 1) << "b"; else r |= 2;
+        if (c) SYLAR_LOG_FMT_INFO(logger, "%s", "c"); else r |= 4;
+        if (c) SYLAR_LOG_FORMAT_INFO(logger, "{}", "d"); else r |= 8;
+        SYLAR_ASSERT2(r == (c ? 0 : 15), r);
+    }
+}
+
+static void bench() {
+    auto logger = std::make_shared<sylar::Logger>("format_bench");
+    logger->addAppender(std::make_shared<MessageLogAppender>());
+    const int count = 1000000;
+
+    uint64_t start = sylar::GetCurrentNS();
+    for (int i = 0; i < count; ++i) {
+        SYLAR_LOG_FORMAT_INFO(logger, "request {} from {} took {:.3f}ms", i, "127.0.0.1", i * 0.001);
+    }
+    uint64_t brace = sylar::GetCurrentNS() - start;
+
+    start = sylar::GetCurrentNS();
+    for (int i = 0; i < count; ++i) {
+        SYLAR_LOG_FMT_INFO(logger, "request %d from %s took %.3fms", i, "127.0.0.1", i * 0.001);
+    }
+    uint64_t printf = sylar::GetCurrentNS() - start;
+
+    start = sylar::GetCurrentNS();
+    for (int i = 0; i < count; ++i) {
+        SYLAR_LOG_INFO(logger) << "request " << i << " from " << "127.0.0.1" << " took "
+            << std::fixed << std::setprecision(3) << i * 0.001 << "ms";
+    }
+    uint64_t stream = sylar::GetCurrentNS() - start;
+
+    SYLAR_LOG_FORMAT_INFO(g_logger, "per call: format {}ns printf {}ns stream {}ns",
+            brace / count, printf / count, stream / count);
+}
+
+int main(int argc, char** argv) {
+    test_format();
+    test_else();
+    bench();
+    return 0;
+}
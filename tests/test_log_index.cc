@@ -0,0 +1,231 @@
+#include "sylar/sylar.h"
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fstream>
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+static const char* s_pattern = "%d{%Y-%m-%d %H:%M:%S}%T%m%n";
+static const uint64_t s_start = 1700000000;
+
+static void remove_files(const std::string& filename) {
+    ::unlink(filename.c_str());
+    ::unlink(sylar::FileLogIndex::IndexFile(filename).c_str());
+}
+
+static uint64_t file_size(const std::string& filename) {
+    struct stat st;
+    return stat(filename.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+static std::string message(int i) {
+    return "record " + std::to_string(i) + " " + std::string(60 + i % 40, 'x');
+}
+
+// 每秒一条，第i条的时间为s_start + i
+static void write_records(sylar::FileLogAppender::ptr appender, int begin, int end) {
+    sylar::Logger logger("index");
+    for (int i = begin; i < end; ++i) {
+        auto event = std::make_shared<sylar::LogEvent>(&logger, sylar::LogLevel::INFO,
+                __FILE__, __LINE__, 0, 0, 0, s_start + i, "main");
+        event->getSS() << message(i);
+        appender->log(event);
+    }
+}
+
+static sylar::FileLogAppender::ptr create_appender(const std::string& filename, uint64_t interval) {
+    auto appender = std::make_shared<sylar::FileLogAppender>(filename);
+    appender->setFormatter(std::make_shared<sylar::LogFormatter>(s_pattern));
+    appender->setIndexInterval(interval);
+    return appender;
+}
+
+static std::string local_time(uint64_t sec) {
+    time_t t = sec;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    char buf[64];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    return buf;
+}
+
+static std::string run_logcat(const std::string& filename, const std::string& from, const std::string& to) {
+    std::string output = filename + ".out";
+    ::unlink(output.c_str());
+    pid_t pid = fork();
+    if (pid == 0) {
+        execl(__ROOT_DIR__ "bin/sylar_logcat", "sylar_logcat", "--from", from.c_str(),
+                "--to", to.c_str(), "-o", output.c_str(), filename.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    SYLAR_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    std::ifstream ifs(output);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    ::unlink(output.c_str());
+    return ss.str();
+}
+
+static std::string expect_lines(int begin, int end) {
+    std::string str;
+    for (int i = begin; i < end; ++i) {
+        str += local_time(s_start + i) + "\t" + message(i) + "\n";
+    }
+    return str;
+}
+
+// 条目指向行首且时间与该行一致，按时间范围取出的内容与逐行过滤相同
+static void test_query() {
+    std::string filename = "test_log_index.log";
+    remove_files(filename);
+    auto appender = create_appender(filename, 4096);
+    write_records(appender, 0, 3600);
+    appender.reset();
+
+    std::vector<sylar::FileLogIndex::Entry> entries;
+    SYLAR_ASSERT(sylar::FileLogIndex::Load(filename, entries));
+    uint64_t size = file_size(filename);
+    SYLAR_ASSERT(entries.size() >= size / 4096 && entries.size() <= size / 4096 + 1);
+    std::ifstream ifs(filename);
+    std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    bool aligned = true;
+    for (auto& e : entries) {
+        aligned = aligned && (e.offset == 0 || content[e.offset - 1] == '\n')
+            && content.compare(e.offset, 19, local_time(e.time_ms / 1000)) == 0;
+    }
+    SYLAR_ASSERT(aligned);
+    SYLAR_ASSERT(entries[0].offset == 0 && entries[0].time_ms == s_start * 1000);
+
+    std::string got = run_logcat(filename, local_time(s_start + 1000), local_time(s_start + 1999));
+    SYLAR_ASSERT(got == expect_lines(1000, 2000));
+    got = run_logcat(filename, std::to_string((s_start + 5) * 1000 + 500),
+            std::to_string((s_start + 7) * 1000));
+    SYLAR_ASSERT(got == expect_lines(5, 8));
+    got = run_logcat(filename, local_time(s_start + 3500), local_time(s_start + 9999));
+    SYLAR_ASSERT(got == expect_lines(3500, 3600));
+    got = run_logcat(filename, local_time(s_start - 100), local_time(s_start - 1));
+    SYLAR_ASSERT(got.empty());
+    SYLAR_LOG_INFO(g_logger) << "query ok entries=" << entries.size() << " size=" << size;
+}
+
+// 写了一半的末尾条目和超出日志长度的条目被丢弃，重新打开后继续追加
+static void test_crash() {
+    std::string filename = "test_log_index.log";
+    std::string index = sylar::FileLogIndex::IndexFile(filename);
+    remove_files(filename);
+    auto appender = create_appender(filename, 1024);
+    write_records(appender, 0, 100);
+    appender.reset();
+
+    std::vector<sylar::FileLogIndex::Entry> entries;
+    SYLAR_ASSERT(sylar::FileLogIndex::Load(filename, entries));
+    size_t count = entries.size();
+    {
+        std::ofstream ofs(index, std::ios::app | std::ios::binary);
+        ofs.write("\x01\x02\x03\x04\x05\x06\x07", 7);
+    }
+    SYLAR_ASSERT(sylar::FileLogIndex::Load(filename, entries) && entries.size() == count);
+
+    appender = create_appender(filename, 1024);
+    SYLAR_ASSERT((file_size(index) - 16) % sylar::FileLogIndex::kEntrySize == 0);
+    write_records(appender, 100, 200);
+    appender.reset();
+    SYLAR_ASSERT(sylar::FileLogIndex::Load(filename, entries) && entries.size() > count);
+    SYLAR_ASSERT(run_logcat(filename, local_time(s_start + 95), local_time(s_start + 104))
+            == expect_lines(95, 105));
+
+    // 日志被截断后超出长度的条目无效
+    uint64_t half = entries[entries.size() / 2].offset;
+    SYLAR_ASSERT(truncate(filename.c_str(), half) == 0);
+    SYLAR_ASSERT(sylar::FileLogIndex::Load(filename, entries));
+    SYLAR_ASSERT(!entries.empty() && entries.back().offset <= half);
+
+    // 日志文件被重建，重新打开时丢弃旧条目
+    ::unlink(filename.c_str());
+    appender = create_appender(filename, 1024);
+    write_records(appender, 500, 510);
+    appender.reset();
+    SYLAR_ASSERT(sylar::FileLogIndex::Load(filename, entries));
+    SYLAR_ASSERT(!entries.empty() && entries[0].offset == 0
+            && entries[0].time_ms == (s_start + 500) * 1000);
+    remove_files(filename);
+    SYLAR_LOG_INFO(g_logger) << "crash ok";
+}
+
+// 索引随日志一起轮转
+static void test_rotate() {
+    std::string filename = "test_log_index_rotate.log";
+    remove_files(filename);
+    remove_files(filename + ".1");
+    auto appender = create_appender(filename, 1024);
+    appender->setMaxSize(8192);
+    appender->setMaxFiles(1);
+    write_records(appender, 0, 150);
+    appender.reset();
+
+    std::vector<sylar::FileLogIndex::Entry> rotated;
+    std::vector<sylar::FileLogIndex::Entry> current;
+    SYLAR_ASSERT(sylar::FileLogIndex::Load(filename + ".1", rotated));
+    SYLAR_ASSERT(sylar::FileLogIndex::Load(filename, current));
+    SYLAR_ASSERT(!rotated.empty() && !current.empty());
+    SYLAR_ASSERT(rotated[0].offset == 0 && current[0].offset == 0);
+    SYLAR_ASSERT(current[0].time_ms > rotated.back().time_ms);
+    remove_files(filename);
+    remove_files(filename + ".1");
+    SYLAR_LOG_INFO(g_logger) << "rotate ok";
+}
+
+static void test_config() {
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: index_conf\n"
+        "    level: info\n"
+        "    appenders:\n"
+        "      - type: FileLogAppender\n"
+        "        file: test_log_index_conf.log\n"
+        "        index_interval: 8K\n");
+    sylar::Config::LoadFromYaml(root);
+    std::string yaml = sylar::LoggerMgr::GetInstance()->toYamlString();
+    SYLAR_ASSERT(yaml.find("index_interval: 8192") != std::string::npos);
+    SYLAR_ASSERT(access("test_log_index_conf.log.idx", F_OK) == 0);
+    SYLAR_LOG_INFO(g_logger) << "config ok";
+}
+
+// 写入过程中磁盘上的条目不指向尚未写出的数据；max_size之后的条目被丢弃
+static void test_live() {
+    std::string filename = "test_log_index_live.log";
+    remove_files(filename);
+    auto appender = create_appender(filename, 256);
+    appender->setBufferSize(1024);
+    bool ok = true;
+    std::vector<sylar::FileLogIndex::Entry> entries;
+    for (int i = 0; i < 500; ++i) {
+        write_records(appender, i, i + 1);
+        uint64_t size = file_size(filename);
+        sylar::FileLogIndex::Load(filename, entries);
+        for (auto& e : entries) {
+            ok = ok && e.offset < size;
+        }
+    }
+    SYLAR_ASSERT(ok);
+    appender->flush();
+    SYLAR_ASSERT(sylar::FileLogIndex::Load(filename, entries) && entries.size() > 2);
+    uint64_t bound = entries[1].offset;
+    SYLAR_ASSERT(sylar::FileLogIndex::Load(filename, entries, bound) && entries.size() == 2);
+    appender.reset();
+    remove_files(filename);
+}
+
+int main(int argc, char** argv) {
+    test_live();
+    test_query();
+    test_crash();
+    test_rotate();
+    test_config();
+    return 0;
+}
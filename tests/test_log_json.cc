@@ -0,0 +1,106 @@
+#include "sylar/sylar.h"
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+// 收集格式化后的文本
+class StringLogAppender : public sylar::LogAppender {
+public:
+    using ptr = std::shared_ptr<StringLogAppender>;
+    void log(sylar::LogEvent::ptr event) override {
+        MutexType::Lock lock(m_mutex);
+        m_text.append(event->getFormatted(*m_formatter, m_buffer));
+    }
+    std::string toYamlString() const override { return ""; }
+    std::string m_text;
+};
+
+static std::string escape(const std::string& str) {
+    std::string out;
+    sylar::JsonLogFormatter::AppendEscaped(out, str.data(), str.size());
+    return out;
+}
+
+static void test_escape() {
+    SYLAR_ASSERT(escape("") == "");
+    SYLAR_ASSERT(escape("plain") == "plain");
+    SYLAR_ASSERT(escape("a\"b\\c") == "a\\\"b\\\\c");
+    SYLAR_ASSERT(escape("\n\r\t\b\f") == "\\n\\r\\t\\b\\f");
+    SYLAR_ASSERT(escape(std::string("\x01\x1f\x7f", 3)) == "\\u0001\\u001f\x7f");
+    SYLAR_ASSERT(escape("中文") == "中文");
+
+    // 需要转义的字符落在16字节块的各个位置，与逐字节结果一致
+    for (size_t len = 1; len < 70; ++len) {
+        for (size_t pos = 0; pos < len; ++pos) {
+            std::string str(len, 'x');
+            str[pos] = '"';
+            std::string expect = std::string(pos, 'x') + "\\\"" + std::string(len - pos - 1, 'x');
+            SYLAR_ASSERT(escape(str) == expect);
+        }
+    }
+    SYLAR_LOG_INFO(g_logger) << "json escape ok";
+}
+
+static void test_fields() {
+    auto logger = std::make_shared<sylar::Logger>("json");
+    auto appender = std::make_shared<StringLogAppender>();
+    appender->setFormatter(std::make_shared<sylar::LogFormatter>("%m%K%n"));
+    logger->addAppender(appender);
+
+    std::string name = "bob \"b\"";
+    SYLAR_LOG_INFO(logger).kv("user", 42).kv("ms", 1.5).kv("ok", true)
+        .kv("name", name).kv("id", (uint64_t)-1) << "login";
+    SYLAR_ASSERT(appender->m_text == "login user=42 ms=1.5 ok=true name=bob \"b\" id=18446744073709551615\n");
+
+    appender->m_text.clear();
+    appender->setFormatter(sylar::LogFormatter::Create("json"));
+    SYLAR_LOG_WARN(logger).kv("user", 42).kv("ms", 1.5).kv("ok", false)
+        .kv("name", name).kv("neg", -7).kv("nan", 0.0 / 0.0) << "say \"hi\"\n";
+    std::cout << appender->m_text;
+    const std::string& text = appender->m_text;
+    SYLAR_ASSERT(text.compare(0, 9, "{\"time\":\"") == 0);
+    SYLAR_ASSERT(text.find("\"level\":\"WARN\",\"logger\":\"json\"") != std::string::npos);
+    SYLAR_ASSERT(text.find("tests/test_log_json.cc\",\"line\":") != std::string::npos);
+    SYLAR_ASSERT(text.find(",\"msg\":\"say \\\"hi\\\"\\n\",\"user\":42,\"ms\":1.5,\"ok\":false,"
+                "\"name\":\"bob \\\"b\\\"\",\"neg\":-7,\"nan\":null}\n") != std::string::npos);
+
+    // 超过内联数量的字段
+    appender->m_text.clear();
+    appender->setFormatter(std::make_shared<sylar::LogFormatter>("%K%n"));
+    const char* keys[] = {"a", "b", "c", "d", "e", "f", "g", "h", "i", "j"};
+    {
+        sylar::LogEventWrap wrap(sylar::LogEvent::Create(logger.get(), sylar::LogLevel::INFO, __FILE__, __LINE__));
+        for (int i = 0; i < 10; ++i) {
+            wrap.getSS().kv(keys[i], i);
+        }
+    }
+    SYLAR_ASSERT(appender->m_text == " a=0 b=1 c=2 d=3 e=4 f=5 g=6 h=7 i=8 j=9\n");
+
+    // 事件复用时字段被清空
+    appender->m_text.clear();
+    SYLAR_LOG_INFO(logger) << "no fields";
+    SYLAR_ASSERT(appender->m_text == "\n");
+    SYLAR_LOG_INFO(g_logger) << "json fields ok";
+}
+
+static void test_config() {
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: json_conf\n"
+        "    level: info\n"
+        "    appenders:\n"
+        "      - type: StdoutLogAppender\n"
+        "        formatter: json\n");
+    sylar::Config::LoadFromYaml(root);
+    auto logger = SYLAR_LOG_NAME("json_conf");
+    auto appenders = logger->getAppenders();
+    SYLAR_ASSERT(appenders.size() == 1);
+    SYLAR_ASSERT(std::dynamic_pointer_cast<sylar::JsonLogFormatter>(appenders.front()->getFormatter()));
+    SYLAR_LOG_INFO(logger).kv("from", "config") << "json from config";
+}
+
+int main(int argc, char** argv) {
+    test_escape();
+    test_fields();
+    test_config();
+    return 0;
+}
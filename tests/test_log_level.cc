@@ -0,0 +1,140 @@
+#include "sylar/sylar.h"
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+static int s_evaluated = 0;
+
+// 日志被过滤时不会求值
+static int touch() {
+    return ++s_evaluated;
+}
+
+static bool emitted(sylar::Logger::ptr logger, sylar::LogLevel::Level level) {
+    int before = s_evaluated;
+    SYLAR_LOG_LEVEL(logger, level) << touch();
+    return s_evaluated != before;
+}
+
+// 生效级别随appender的增删和级别修改更新
+static void test_appenders() {
+    auto logger = std::make_shared<sylar::Logger>("effective");
+    // 没有appender也没有root，不会输出
+    SYLAR_ASSERT(!emitted(logger, sylar::LogLevel::FATAL));
+
+    auto warn = std::make_shared<sylar::StdoutLogAppender>();
+    warn->setLevel(sylar::LogLevel::WARN);
+    logger->addAppender(warn);
+    SYLAR_ASSERT(logger->getLevel() == sylar::LogLevel::DEBUG);
+    SYLAR_ASSERT(logger->getEffectiveLevel() == sylar::LogLevel::WARN);
+    SYLAR_ASSERT(!emitted(logger, sylar::LogLevel::INFO));
+    SYLAR_ASSERT(emitted(logger, sylar::LogLevel::WARN));
+
+    auto info = std::make_shared<sylar::StdoutLogAppender>();
+    info->setLevel(sylar::LogLevel::ERROR);
+    logger->addAppender(info);
+    SYLAR_ASSERT(logger->getEffectiveLevel() == sylar::LogLevel::WARN);
+    info->setLevel(sylar::LogLevel::INFO);
+    SYLAR_ASSERT(logger->getEffectiveLevel() == sylar::LogLevel::INFO);
+    SYLAR_ASSERT(emitted(logger, sylar::LogLevel::INFO));
+
+    logger->setLevel(sylar::LogLevel::ERROR);
+    SYLAR_ASSERT(logger->getEffectiveLevel() == sylar::LogLevel::ERROR);
+    logger->setLevel(sylar::LogLevel::DEBUG);
+
+    logger->delAppender(info);
+    SYLAR_ASSERT(logger->getEffectiveLevel() == sylar::LogLevel::WARN);
+    // 已移除的appender不再影响logger
+    info->setLevel(sylar::LogLevel::DEBUG);
+    SYLAR_ASSERT(logger->getEffectiveLevel() == sylar::LogLevel::WARN);
+
+    // 同一appender被多个logger使用
+    auto other = std::make_shared<sylar::Logger>("effective_other");
+    other->addAppender(warn);
+    warn->setLevel(sylar::LogLevel::ERROR);
+    SYLAR_ASSERT(logger->getEffectiveLevel() == sylar::LogLevel::ERROR);
+    SYLAR_ASSERT(other->getEffectiveLevel() == sylar::LogLevel::ERROR);
+    other.reset();
+    warn->setLevel(sylar::LogLevel::WARN);
+    SYLAR_ASSERT(logger->getEffectiveLevel() == sylar::LogLevel::WARN);
+
+    logger->clearAppenders();
+    SYLAR_ASSERT(!emitted(logger, sylar::LogLevel::FATAL));
+    SYLAR_LOG_INFO(g_logger) << "appenders ok";
+}
+
+// 没有appender的logger跟随root的appender
+static void test_root_fallback() {
+    auto logger = SYLAR_LOG_NAME("effective.child");
+    auto root_appenders = g_logger->getAppenders();
+    SYLAR_ASSERT(logger->getEffectiveLevel() == sylar::LogLevel::DEBUG);
+
+    for (auto& i : root_appenders) {
+        i->setLevel(sylar::LogLevel::ERROR);
+    }
+    SYLAR_ASSERT(g_logger->getEffectiveLevel() == sylar::LogLevel::ERROR);
+    SYLAR_ASSERT(logger->getEffectiveLevel() == sylar::LogLevel::ERROR);
+    SYLAR_ASSERT(SYLAR_LOG_NAME("effective")->getEffectiveLevel() == sylar::LogLevel::ERROR);
+    SYLAR_ASSERT(!emitted(logger, sylar::LogLevel::WARN));
+
+    // 自身有appender时不再跟随root
+    auto appender = std::make_shared<sylar::StdoutLogAppender>();
+    logger->addAppender(appender);
+    SYLAR_ASSERT(logger->getEffectiveLevel() == sylar::LogLevel::DEBUG);
+    logger->clearAppenders();
+    SYLAR_ASSERT(logger->getEffectiveLevel() == sylar::LogLevel::ERROR);
+
+    for (auto& i : root_appenders) {
+        i->setLevel(sylar::LogLevel::DEBUG);
+    }
+    SYLAR_ASSERT(logger->getEffectiveLevel() == sylar::LogLevel::DEBUG);
+    SYLAR_LOG_INFO(g_logger) << "root fallback ok";
+}
+
+static void test_config() {
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: effective_conf\n"
+        "    level: debug\n"
+        "    appenders:\n"
+        "      - type: StdoutLogAppender\n"
+        "        level: error\n");
+    sylar::Config::LoadFromYaml(root);
+    auto logger = SYLAR_LOG_NAME("effective_conf");
+    SYLAR_ASSERT(logger->getEffectiveLevel() == sylar::LogLevel::ERROR);
+    SYLAR_ASSERT(!emitted(logger, sylar::LogLevel::INFO));
+
+    root = YAML::Load(
+        "logs:\n"
+        "  - name: effective_conf\n"
+        "    level: info\n"
+        "    appenders:\n"
+        "      - type: StdoutLogAppender\n"
+        "        level: debug\n");
+    sylar::Config::LoadFromYaml(root);
+    SYLAR_ASSERT(logger->getEffectiveLevel() == sylar::LogLevel::INFO);
+    SYLAR_LOG_INFO(g_logger) << "config ok";
+}
+
+// appender级别高于logger时被过滤的调用的开销
+static void bench_filtered() {
+    auto logger = std::make_shared<sylar::Logger>("effective_bench");
+    auto appender = std::make_shared<sylar::StdoutLogAppender>();
+    appender->setLevel(sylar::LogLevel::ERROR);
+    logger->addAppender(appender);
+
+    const int n = 1000000;
+    uint64_t start = sylar::GetCurrentNS();
+    for (int i = 0; i < n; ++i) {
+        SYLAR_LOG_DEBUG(logger) << "filtered " << i << " " << 3.14;
+    }
+    uint64_t used = sylar::GetCurrentNS() - start;
+    SYLAR_LOG_INFO(g_logger) << "filtered debug call " << (double)used / n << "ns";
+}
+
+int main(int argc, char** argv) {
+    test_appenders();
+    test_root_fallback();
+    test_config();
+    bench_filtered();
+    return 0;
+}
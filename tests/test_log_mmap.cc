@@ -0,0 +1,137 @@
+#include "sylar/sylar.h"
+
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fstream>
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+static const int s_count = 10000;
+
+static size_t count_lines(const std::string& filename) {
+    std::ifstream ifs(filename);
+    std::string line;
+    size_t n = 0;
+    while (std::getline(ifs, line)) {
+        ++n;
+    }
+    return n;
+}
+
+static uint64_t file_size(const std::string& filename) {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        return 0;
+    }
+    return st.st_size;
+}
+
+static void write_lines(sylar::MmapFileLogAppender::ptr appender, int count) {
+    auto logger = std::make_shared<sylar::Logger>("mmap");
+    appender->setFormatter(std::make_shared<sylar::LogFormatter>("%t%T%m%n"));
+    logger->addAppender(appender);
+    for (int i = 0; i < count; ++i) {
+        SYLAR_LOG_INFO(logger) << "mmap message " << i;
+    }
+}
+
+// 段很小，写入过程中多次扩展和重新映射
+static void test_normal() {
+    std::string filename = "mmap_normal.log";
+    ::unlink(filename.c_str());
+
+    uint64_t committed = 0;
+    {
+        auto appender = std::make_shared<sylar::MmapFileLogAppender>(filename, 4096);
+        write_lines(appender, s_count);
+        committed = appender->getCommitted();
+        // 运行中文件含预分配部分和trailer
+        SYLAR_ASSERT(file_size(filename) > committed);
+    }
+    SYLAR_ASSERT(file_size(filename) == committed);
+    SYLAR_ASSERT(count_lines(filename) == (size_t)s_count);
+
+    // 再次打开时在末尾追加
+    {
+        auto appender = std::make_shared<sylar::MmapFileLogAppender>(filename, 4096);
+        write_lines(appender, s_count);
+    }
+    SYLAR_ASSERT(count_lines(filename) == (size_t)s_count * 2);
+    SYLAR_LOG_INFO(g_logger) << "mmap normal ok, size=" << file_size(filename);
+}
+
+// 子进程写完不析构直接退出，模拟崩溃
+static void test_crash() {
+    std::string filename = "mmap_crash.log";
+    ::unlink(filename.c_str());
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        auto appender = new sylar::MmapFileLogAppender(filename, 4096);
+        write_lines(sylar::MmapFileLogAppender::ptr(appender, [](sylar::MmapFileLogAppender*){}), s_count);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    uint64_t size = file_size(filename);
+    int64_t len = sylar::MmapFileLogAppender::Recover(filename);
+    SYLAR_LOG_INFO(g_logger) << "mmap crash size=" << size << " recovered=" << len;
+    SYLAR_ASSERT(len > 0 && (uint64_t)len < size);
+    SYLAR_ASSERT(file_size(filename) == (uint64_t)len);
+    SYLAR_ASSERT(count_lines(filename) == (size_t)s_count);
+
+    // 已恢复的文件是普通文本，再次Recover不变
+    SYLAR_ASSERT(sylar::MmapFileLogAppender::Recover(filename) == len);
+}
+
+// 文件大小受限，扩展失败后崩溃，末尾仍有有效trailer，恢复出的内容不含空洞
+static void test_grow_fail() {
+    std::string filename = "mmap_grow_fail.log";
+    ::unlink(filename.c_str());
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        signal(SIGXFSZ, SIG_IGN);
+        struct rlimit rl;
+        rl.rlim_cur = rl.rlim_max = 4096 * 4 - 8;
+        setrlimit(RLIMIT_FSIZE, &rl);
+        auto appender = new sylar::MmapFileLogAppender(filename, 4096);
+        write_lines(sylar::MmapFileLogAppender::ptr(appender, [](sylar::MmapFileLogAppender*){}), s_count);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    int64_t len = sylar::MmapFileLogAppender::Recover(filename);
+    SYLAR_LOG_INFO(g_logger) << "mmap grow fail recovered=" << len;
+    SYLAR_ASSERT(len > 0 && len < 4096 * 4);
+    std::ifstream ifs(filename);
+    std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    SYLAR_ASSERT(data.size() == (size_t)len);
+    SYLAR_ASSERT(data.find('\0') == std::string::npos);
+    SYLAR_ASSERT(data.back() == '\n');
+}
+
+int main(int argc, char** argv) {
+    test_normal();
+    test_crash();
+    test_grow_fail();
+
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: mmap\n"
+        "    level: info\n"
+        "    appenders:\n"
+        "      - type: MmapFileLogAppender\n"
+        "        file: mmap_conf.log\n"
+        "        segment_size: 1M\n");
+    sylar::Config::LoadFromYaml(root);
+    std::cout << sylar::LoggerMgr::GetInstance()->toYamlString() << std::endl;
+    SYLAR_LOG_INFO(SYLAR_LOG_NAME("mmap")) << "mmap from config";
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "sylar/sylar.h"
+
+#include <unistd.h>
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+// 收集消息内容
+class MessageLogAppender : public sylar::LogAppender {
+public:
+    using ptr = std::shared_ptr<MessageLogAppender>;
+    void log(sylar::LogEvent::ptr event) override {
+        MutexType::Lock lock(m_mutex);
+        m_messages.push_back(event->getContent());
+    }
+    std::string toYamlString() const override { return ""; }
+    std::vector<std::string> m_messages;
+};
+
+static std::pair<sylar::Logger::ptr, MessageLogAppender::ptr> make_logger(const std::string& name) {
+    auto logger = std::make_shared<sylar::Logger>(name);
+    auto appender = std::make_shared<MessageLogAppender>();
+    logger->addAppender(appender);
+    return std::make_pair(logger, appender);
+}
+
+static void test_sampling() {
+    auto [logger, appender] = make_logger("sample");
+    for (int i = 0; i < 25; ++i) {
+        SYLAR_LOG_INFO_EVERY_N(logger, 10) << "every " << i;
+    }
+    SYLAR_ASSERT(appender->m_messages.size() == 3);
+    SYLAR_ASSERT(appender->m_messages[0] == "every 0");
+    SYLAR_ASSERT(appender->m_messages[1] == "every 10 [suppressed 9]");
+    SYLAR_ASSERT(appender->m_messages[2] == "every 20 [suppressed 9]");
+    appender->m_messages.clear();
+
+    for (int i = 0; i < 10; ++i) {
+        SYLAR_LOG_WARN_FIRST_N(logger, 3) << "first " << i;
+    }
+    SYLAR_ASSERT(appender->m_messages.size() == 3);
+    SYLAR_ASSERT(appender->m_messages[2] == "first 2");
+    appender->m_messages.clear();
+
+    uint64_t start = sylar::GetCurrentMS();
+    while (sylar::GetCurrentMS() - start < 250) {
+        SYLAR_LOG_ERROR_EVERY_MS(logger, 100) << "ms";
+        usleep(1000);
+    }
+    SYLAR_ASSERT(appender->m_messages.size() >= 2 && appender->m_messages.size() <= 3);
+    SYLAR_ASSERT(appender->m_messages[1].find("ms [suppressed ") == 0);
+    appender->m_messages.clear();
+
+    // 级别不满足时不计数
+    logger->setLevel(sylar::LogLevel::ERROR);
+    for (int i = 0; i < 5; ++i) {
+        SYLAR_LOG_DEBUG_EVERY_N(logger, 2) << "debug";
+    }
+    SYLAR_ASSERT(appender->m_messages.empty());
+    SYLAR_LOG_INFO(g_logger) << "sampling ok";
+}
+
+static void test_token_bucket() {
+    auto [logger, appender] = make_logger("bucket");
+    logger->setRateLimit(10, 5);
+
+    // 先放行burst条
+    for (int i = 0; i < 100; ++i) {
+        SYLAR_LOG_ERROR(logger) << "hot " << i;
+    }
+    SYLAR_ASSERT(appender->m_messages.size() == 5);
+
+    // 之后每100ms补一个令牌，下一条带上丢弃数
+    usleep(120 * 1000);
+    SYLAR_LOG_ERROR(logger) << "later";
+    SYLAR_ASSERT(appender->m_messages.size() == 6);
+    SYLAR_ASSERT(appender->m_messages[5] == "later [suppressed 95]");
+
+    // 多线程下放行总数不超过 burst + rate * 时间
+    appender->m_messages.clear();
+    logger->setRateLimit(1000, 100);
+    std::vector<sylar::Thread::ptr> thrs;
+    uint64_t start = sylar::GetCurrentMS();
+    for (int i = 0; i < 4; ++i) {
+        thrs.push_back(std::make_shared<sylar::Thread>([logger = logger](){
+            for (int n = 0; n < 100000; ++n) {
+                SYLAR_LOG_INFO(logger) << "thread " << n;
+            }
+        }, "bucket_" + std::to_string(i)));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    uint64_t used = sylar::GetCurrentMS() - start;
+    size_t limit = 100 + used + 1;
+    SYLAR_LOG_INFO(g_logger) << "token bucket passed " << appender->m_messages.size()
+        << " in " << used << "ms, limit " << limit;
+    SYLAR_ASSERT(appender->m_messages.size() >= 100 && appender->m_messages.size() <= limit);
+
+    logger->setRateLimit(0);
+    appender->m_messages.clear();
+    for (int i = 0; i < 1000; ++i) {
+        SYLAR_LOG_INFO(logger) << "unlimited";
+    }
+    SYLAR_ASSERT(appender->m_messages.size() == 1000);
+}
+
+static void test_config() {
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: ratelimit_conf\n"
+        "    level: info\n"
+        "    rate_limit: 100\n"
+        "    burst: 20\n");
+    sylar::Config::LoadFromYaml(root);
+    auto logger = SYLAR_LOG_NAME("ratelimit_conf");
+    SYLAR_ASSERT(logger->getRateLimit() == 100);
+    SYLAR_ASSERT(logger->getBurst() == 20);
+    std::cout << logger->toYamlString() << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_sampling();
+    test_token_bucket();
+    test_config();
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include "sylar/sylar.h"
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+static const int s_thread_num = 4;
+static const int s_count = 200000;
+
+// 带'.'的名字继承父logger的级别，修改父级别后子logger跟着变
+static void test_hierarchy() {
+    auto child = SYLAR_LOG_NAME("registry.fiber.io");
+    auto mid = SYLAR_LOG_NAME("registry.fiber");
+    auto top = SYLAR_LOG_NAME("registry");
+    SYLAR_ASSERT(child->getLevel() == sylar::LogLevel::DEBUG);
+
+    top->setLevel(sylar::LogLevel::WARN);
+    SYLAR_ASSERT(mid->getLevel() == sylar::LogLevel::WARN);
+    SYLAR_ASSERT(child->getLevel() == sylar::LogLevel::WARN);
+
+    // 显式设置后不再跟随父logger
+    mid->setLevel(sylar::LogLevel::ERROR);
+    top->setLevel(sylar::LogLevel::INFO);
+    SYLAR_ASSERT(mid->getLevel() == sylar::LogLevel::ERROR);
+    SYLAR_ASSERT(child->getLevel() == sylar::LogLevel::ERROR);
+
+    // 设回UNKNOW恢复继承
+    mid->setLevel(sylar::LogLevel::UNKNOW);
+    SYLAR_ASSERT(mid->getLevel() == sylar::LogLevel::INFO);
+    SYLAR_ASSERT(child->getLevel() == sylar::LogLevel::INFO);
+
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: registry\n"
+        "    level: fatal\n");
+    sylar::Config::LoadFromYaml(root);
+    SYLAR_ASSERT(child->getLevel() == sylar::LogLevel::FATAL);
+    SYLAR_LOG_INFO(g_logger) << "hierarchy ok";
+}
+
+// 多线程同时查找和新建，同名必须拿到同一个logger
+static void test_concurrent() {
+    std::vector<sylar::Thread::ptr> thrs;
+    std::vector<sylar::Logger*> first(s_thread_num * 64);
+    uint64_t start = sylar::GetCurrentNS();
+    for (int i = 0; i < s_thread_num; ++i) {
+        thrs.push_back(std::make_shared<sylar::Thread>([i, &first](){
+            for (int n = 0; n < s_count; ++n) {
+                int id = n % 64;
+                auto logger = SYLAR_LOG_NAME("registry.module" + std::to_string(id));
+                if (n < 64) {
+                    first[i * 64 + id] = logger.get();
+                }
+            }
+        }, "registry_" + std::to_string(i)));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    uint64_t used = sylar::GetCurrentNS() - start;
+    for (int i = 1; i < s_thread_num; ++i) {
+        for (int n = 0; n < 64; ++n) {
+            SYLAR_ASSERT(first[i * 64 + n] == first[n]);
+        }
+    }
+    SYLAR_LOG_INFO(g_logger) << "concurrent lookup "
+        << used / (s_thread_num * s_count) << "ns/op";
+}
+
+int main(int argc, char** argv) {
+    test_hierarchy();
+    test_concurrent();
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include "sylar/sylar.h"
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+static std::string read_file(const std::string& path) {
+    std::ifstream ifs(path);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    return ss.str();
+}
+
+static size_t count_of(const std::string& str, const std::string& sub) {
+    size_t n = 0;
+    for (size_t pos = str.find(sub); pos != std::string::npos; pos = str.find(sub, pos + 1)) {
+        ++n;
+    }
+    return n;
+}
+
+// 正常输出只有INFO以上，FATAL时转储环中的DEBUG上下文
+static void test_fatal_dump() {
+    ::unlink("ring_fatal.dump");
+    auto logger = std::make_shared<sylar::Logger>("ring");
+    auto ring = std::make_shared<sylar::RingBufferLogAppender>("ring_fatal.dump", 4096);
+    logger->addAppender(ring);
+    auto out = std::make_shared<sylar::StdoutLogAppender>();
+    out->setLevel(sylar::LogLevel::INFO);
+    logger->addAppender(out);
+
+    // 超过环大小，只保留最近的记录
+    for (int i = 0; i < 1000; ++i) {
+        SYLAR_LOG_DEBUG(logger) << "debug context " << i;
+    }
+    SYLAR_LOG_FATAL(logger) << "fatal happened";
+
+    std::string dump = read_file("ring_fatal.dump");
+    SYLAR_ASSERT(dump.find("==== sylar flight recorder: fatal log ====") == 0);
+    SYLAR_ASSERT(dump.find("debug context 999") != std::string::npos);
+    SYLAR_ASSERT(dump.find("debug context 0\n") == std::string::npos);
+    SYLAR_ASSERT(dump.find("fatal happened") != std::string::npos);
+    SYLAR_ASSERT(ring->getRingSize() == 4096);
+    // 回绕后丢弃不完整的首行，每行都是完整记录
+    std::string body = dump.substr(dump.find(" ----\n") + 6);
+    std::istringstream lines(body);
+    std::string line;
+    while (std::getline(lines, line)) {
+        SYLAR_ASSERT2(line.find("debug context") != std::string::npos
+                || line.find("fatal happened") != std::string::npos, line);
+    }
+    SYLAR_LOG_INFO(g_logger) << "fatal dump ok, " << dump.size() << " bytes";
+}
+
+// 每个线程一个环，转储按线程分段
+static void test_threads() {
+    ::unlink("ring_threads.dump");
+    auto logger = std::make_shared<sylar::Logger>("ring_threads");
+    auto ring = std::make_shared<sylar::RingBufferLogAppender>("ring_threads.dump");
+    ring->setFormatter(std::make_shared<sylar::LogFormatter>("%N %m%n"));
+    logger->addAppender(ring);
+
+    // 全部写完再退出，保证4个线程同时持有环
+    std::atomic<int> done {0};
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < 4; ++i) {
+        thrs.push_back(std::make_shared<sylar::Thread>([logger, &done](){
+            for (int n = 0; n < 10000; ++n) {
+                SYLAR_LOG_DEBUG(logger) << "message " << n;
+            }
+            ++done;
+            while (done < 4) {
+                usleep(1000);
+            }
+        }, "ring_" + std::to_string(i)));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    SYLAR_ASSERT(ring->dump("manual") > 0);
+
+    std::string dump = read_file("ring_threads.dump");
+    SYLAR_ASSERT(count_of(dump, "---- thread ") == 4);
+    for (int i = 0; i < 4; ++i) {
+        std::string name = "ring_" + std::to_string(i);
+        SYLAR_ASSERT(dump.find(" " + name + " ----\n") != std::string::npos);
+        SYLAR_ASSERT(dump.find(name + " message 9999\n") != std::string::npos);
+    }
+
+    // 线程退出后环被新线程复用
+    sylar::Thread t([logger](){
+        SYLAR_LOG_DEBUG(logger) << "reuse";
+    }, "ring_reuse");
+    t.join();
+    ring->dump("reuse");
+    dump = read_file("ring_threads.dump");
+    SYLAR_ASSERT(count_of(dump, "---- thread ") == 4);
+    SYLAR_ASSERT(dump.find("ring_reuse reuse\n") != std::string::npos);
+    SYLAR_LOG_INFO(g_logger) << "threads dump ok";
+}
+
+// 子进程崩溃时由信号处理函数转储，之后仍按默认方式终止
+static void test_signal() {
+    ::unlink("ring_signal.dump");
+    pid_t pid = fork();
+    if (pid == 0) {
+        auto logger = std::make_shared<sylar::Logger>("ring_signal");
+        logger->addAppender(std::make_shared<sylar::RingBufferLogAppender>("ring_signal.dump"));
+        sylar::RingBufferLogAppender::InstallSignalHandlers();
+        SYLAR_LOG_DEBUG(logger) << "before crash";
+        raise(SIGSEGV);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    SYLAR_ASSERT(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+
+    std::string dump = read_file("ring_signal.dump");
+    SYLAR_ASSERT(dump.find("==== sylar flight recorder: signal " + std::to_string(SIGSEGV)) == 0);
+    SYLAR_ASSERT(dump.find("before crash") != std::string::npos);
+    SYLAR_LOG_INFO(g_logger) << "signal dump ok";
+}
+
+static void test_config() {
+    ::unlink("ring_conf.dump");
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: ring_conf\n"
+        "    level: debug\n"
+        "    appenders:\n"
+        "      - type: RingBufferLogAppender\n"
+        "        file: ring_conf.dump\n"
+        "        ring_size: 16K\n"
+        "        dump_on_signal: false\n"
+        "        formatter: \"%p %m%n\"\n");
+    sylar::Config::LoadFromYaml(root);
+    std::string yaml = sylar::LoggerMgr::GetInstance()->toYamlString();
+    std::cout << yaml << std::endl;
+    SYLAR_ASSERT(yaml.find("RingBufferLogAppender") != std::string::npos);
+    SYLAR_ASSERT(yaml.find("ring_size: 16384") != std::string::npos);
+
+    auto logger = SYLAR_LOG_NAME("ring_conf");
+    SYLAR_LOG_DEBUG(logger) << "configured";
+    sylar::RingBufferLogAppender::DumpAll("config");
+    SYLAR_ASSERT(read_file("ring_conf.dump").find("DEBUG configured\n") != std::string::npos);
+    SYLAR_LOG_INFO(g_logger) << "config ok";
+}
+
+int main(int argc, char** argv) {
+    test_fatal_dump();
+    test_threads();
+    test_signal();
+    test_config();
+    return 0;
+}
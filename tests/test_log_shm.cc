@@ -0,0 +1,363 @@
+#include "sylar/sylar.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fstream>
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+static std::string shm_name(const char* tag) {
+    return std::string("sylar_test_") + tag + "_" + std::to_string(getpid());
+}
+
+// 回绕、环满丢弃和超长截断
+static void test_ring() {
+    std::string name = shm_name("ring");
+    auto ring = sylar::ShmLogRing::Open(name, 64 * 1024);
+    SYLAR_ASSERT(ring);
+    SYLAR_ASSERT(ring->getCapacity() == 64 * 1024);
+
+    std::vector<std::string> got;
+    auto collect = [&got](const char* data, size_t len) {
+        got.emplace_back(data, len);
+    };
+    uint64_t written = 0;
+    for (int i = 0; i < 1000; ++i) {
+        std::string str = "record " + std::to_string(i) + std::string(i % 700, 'x');
+        SYLAR_ASSERT(ring->write(str.data(), str.size()));
+        ++written;
+        if (i % 20 == 19) {
+            ring->read(collect);
+        }
+    }
+    ring->read(collect);
+    SYLAR_ASSERT(got.size() == written);
+    for (size_t i = 0; i < got.size(); ++i) {
+        SYLAR_ASSERT(got[i] == "record " + std::to_string(i) + std::string(i % 700, 'x'));
+    }
+    SYLAR_ASSERT(ring->empty());
+
+    // 不读时写满后丢弃
+    std::string big(1000, 'b');
+    size_t ok = 0;
+    for (int i = 0; i < 100; ++i) {
+        ok += ring->write(big.data(), big.size());
+    }
+    SYLAR_ASSERT(ok > 0 && ok < 100);
+    SYLAR_ASSERT(ring->getDropped() == 100 - ok);
+    got.clear();
+    SYLAR_ASSERT(ring->read(collect) == ok);
+
+    std::string huge(ring->getMaxRecord() * 2, 'h');
+    SYLAR_ASSERT(ring->write(huge.data(), huge.size()));
+    got.clear();
+    ring->read(collect);
+    SYLAR_ASSERT(got.size() == 1 && got[0].size() == ring->getMaxRecord());
+
+    // 再次打开沿用已有的大小
+    auto again = sylar::ShmLogRing::Open(name, 1024 * 1024);
+    SYLAR_ASSERT(again && again->getCapacity() == 64 * 1024);
+    SYLAR_ASSERT(sylar::ShmLogRing::Unlink(name));
+    SYLAR_LOG_INFO(g_logger) << "ring ok dropped=" << ring->getDropped();
+}
+
+// 多个线程同时写，一个线程读，每个线程的记录保持顺序
+static void test_mpsc() {
+    std::string name = shm_name("mpsc");
+    auto ring = sylar::ShmLogRing::Open(name, 256 * 1024);
+    SYLAR_ASSERT(ring);
+    sylar::ShmLogRing::Unlink(name);
+
+    const int threads = 4;
+    const int count = 50000;
+    std::atomic<int> running {threads};
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int t = 0; t < threads; ++t) {
+        thrs.push_back(std::make_shared<sylar::Thread>([ring, t, &running](){
+            for (int i = 0; i < count; ++i) {
+                std::string str = std::to_string(t) + " " + std::to_string(i);
+                ring->write(str.data(), str.size());
+            }
+            --running;
+        }, "shm_" + std::to_string(t)));
+    }
+
+    std::vector<int> last(threads, -1);
+    uint64_t received = 0;
+    bool ordered = true;
+    auto check = [&](const char* data, size_t len) {
+        int t = 0;
+        int i = 0;
+        sscanf(std::string(data, len).c_str(), "%d %d", &t, &i);
+        ordered = ordered && t >= 0 && t < threads && i > last[t];
+        last[t] = i;
+        ++received;
+    };
+    while (running || !ring->empty()) {
+        if (!ring->read(check)) {
+            usleep(100);
+        }
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    SYLAR_LOG_INFO(g_logger) << "mpsc received=" << received << " dropped=" << ring->getDropped();
+    SYLAR_ASSERT(ordered);
+    SYLAR_ASSERT(received + ring->getDropped() == (uint64_t)threads * count);
+}
+
+// 小环上多次回绕，记录长短混合；消费者像sylar_logd一样在读不到时调用skipDead
+// 写者都活着，skipDead不应跳过任何记录，记录内容和顺序不受影响
+static void test_wrap_skip() {
+    std::string name = shm_name("wrap");
+    auto ring = sylar::ShmLogRing::Open(name, 64 * 1024);
+    SYLAR_ASSERT(ring);
+    sylar::ShmLogRing::Unlink(name);
+    ring->setOwner(getpid());
+
+    const int threads = 3;
+    const int count = 20000;
+    std::atomic<int> running {threads};
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int t = 0; t < threads; ++t) {
+        thrs.push_back(std::make_shared<sylar::Thread>([ring, t, &running](){
+            for (int i = 0; i < count; ++i) {
+                // 正文为数字和'-'，回绕后容易被误读为进程id
+                std::string str = std::to_string(t) + " " + std::to_string(i) + " "
+                    + std::string((i * 7 + t * 131) % 3000, '-');
+                // 消费者出错时环会一直满，最多等2秒
+                for (int n = 0; !ring->write(str.data(), str.size()) && n < 40000; ++n) {
+                    usleep(50);
+                }
+            }
+            --running;
+        }, "shm_wrap_" + std::to_string(t)));
+    }
+
+    std::vector<int> last(threads, -1);
+    uint64_t received = 0;
+    uint64_t skipped = 0;
+    bool valid = true;
+    auto check = [&](const char* data, size_t len) {
+        int t = -1;
+        int i = -1;
+        sscanf(std::string(data, len).c_str(), "%d %d", &t, &i);
+        if (t < 0 || t >= threads || i != last[t] + 1) {
+            valid = false;
+            return;
+        }
+        std::string expect = std::to_string(t) + " " + std::to_string(i) + " "
+            + std::string((i * 7 + t * 131) % 3000, '-');
+        valid = valid && std::string(data, len) == expect;
+        last[t] = i;
+        ++received;
+    };
+    // 写者结束后2秒内读不完视为出错
+    uint64_t idle_since = sylar::GetCurrentMS();
+    while (running || !ring->empty()) {
+        if (ring->read(check)) {
+            idle_since = sylar::GetCurrentMS();
+        } else if (!ring->empty()) {
+            skipped += ring->skipDead();
+        }
+        if (!running && sylar::GetCurrentMS() - idle_since > 2000) {
+            break;
+        }
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    SYLAR_LOG_INFO(g_logger) << "wrap received=" << received << " dropped=" << ring->getDropped()
+        << " skipped=" << skipped;
+    SYLAR_ASSERT(valid);
+    SYLAR_ASSERT(skipped == 0);
+    SYLAR_ASSERT(received == (uint64_t)threads * count);
+    SYLAR_ASSERT(ring->write("end", 3));
+}
+
+// 回绕后生产者刚预留、还没写头时，消费者看到的头必须是0而不是旧记录的正文
+// 直接映射共享内存模拟预留：reserve位于头部偏移64处，数据区从ShmLogRing::kHeaderSize开始
+static void test_reserved_slot() {
+    std::string name = shm_name("slot");
+    auto ring = sylar::ShmLogRing::Open(name, 64 * 1024);
+    SYLAR_ASSERT(ring);
+    ring->setOwner(getpid());
+    int fd = shm_open(("/" + name).c_str(), O_RDWR, 0);
+    SYLAR_ASSERT(fd >= 0);
+    size_t map_size = sylar::ShmLogRing::kHeaderSize + ring->getCapacity();
+    char* base = (char*)mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    SYLAR_ASSERT(base != MAP_FAILED);
+    ::close(fd);
+    sylar::ShmLogRing::Unlink(name);
+    auto reserve = (std::atomic<uint64_t>*)(base + 64);
+    char* data = base + sylar::ShmLogRing::kHeaderSize;
+    uint64_t mask = ring->getCapacity() - 1;
+
+    auto ignore = [](const char*, size_t) {};
+    // 第一圈写长记录，第二圈写短记录，短记录的头落在长记录的正文上
+    std::string big(1000, '-');
+    while (reserve->load() < ring->getCapacity()) {
+        SYLAR_ASSERT(ring->write(big.data(), big.size()));
+        ring->read(ignore);
+    }
+    std::string small(500, '-');
+    for (int i = 0; i < 3; ++i) {
+        SYLAR_ASSERT(ring->write(small.data(), small.size()));
+        ring->read(ignore);
+    }
+    uint64_t pos = reserve->load();
+    SYLAR_ASSERT(ring->empty());
+    bool zero = true;
+    for (uint64_t i = 0; i < 512; ++i) {
+        zero = zero && data[(pos + i) & mask] == 0;
+    }
+    SYLAR_ASSERT(zero);
+
+    reserve->fetch_add(512);
+    SYLAR_ASSERT(!ring->skipDead());
+    SYLAR_ASSERT(ring->read(ignore) == 0 && !ring->empty());
+    munmap(base, map_size);
+    SYLAR_LOG_INFO(g_logger) << "reserved slot ok";
+}
+
+// 写日志的进程被SIGKILL后，sylar_logd仍写出全部已提交的记录
+static void test_crash() {
+    std::string name = shm_name("crash");
+    std::string output = "test_log_shm.out";
+    ::unlink(output.c_str());
+
+    pid_t daemon = fork();
+    if (daemon == 0) {
+        execl(__ROOT_DIR__ "bin/sylar_logd", "sylar_logd", "-e", "-i", "5",
+                name.c_str(), output.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+    SYLAR_ASSERT(daemon > 0);
+    // 等守护进程创建并映射好共享内存
+    std::string path = "/dev/shm/" + name;
+    for (int i = 0; i < 500 && access(path.c_str(), F_OK) != 0; ++i) {
+        usleep(10 * 1000);
+    }
+
+    const int count = 1000;
+    pid_t child = fork();
+    if (child == 0) {
+        auto logger = std::make_shared<sylar::Logger>("crash");
+        auto appender = std::make_shared<sylar::ShmLogAppender>(name);
+        appender->setFormatter(std::make_shared<sylar::LogFormatter>("%p %m%n"));
+        logger->addAppender(appender);
+        for (int i = 0; i < count; ++i) {
+            SYLAR_LOG_INFO(logger) << "crash " << i;
+        }
+        raise(SIGKILL);
+        _exit(0);
+    }
+    SYLAR_ASSERT(child > 0);
+    int status = 0;
+    waitpid(child, &status, 0);
+    SYLAR_ASSERT(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL);
+    // 名字已删除，守护进程靠自己的映射读到剩余记录
+    sylar::ShmLogRing::Unlink(name);
+
+    bool exited = false;
+    for (int i = 0; i < 500 && !exited; ++i) {
+        exited = waitpid(daemon, &status, WNOHANG) == daemon;
+        if (!exited) {
+            usleep(10 * 1000);
+        }
+    }
+    if (!exited) {
+        kill(daemon, SIGKILL);
+        waitpid(daemon, &status, 0);
+    }
+    SYLAR_ASSERT(exited && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    std::ifstream ifs(output);
+    std::string line;
+    int n = 0;
+    bool ordered = true;
+    while (std::getline(ifs, line)) {
+        ordered = ordered && line == "INFO crash " + std::to_string(n);
+        ++n;
+    }
+    SYLAR_LOG_INFO(g_logger) << "crash lines=" << n;
+    SYLAR_ASSERT(ordered);
+    SYLAR_ASSERT(n == count);
+    ::unlink(output.c_str());
+}
+
+// 只允许一个存活的生产者进程，owner退出后其它进程可以接管
+static void test_owner() {
+    std::string name = shm_name("owner");
+    auto ring = sylar::ShmLogRing::Open(name, 64 * 1024);
+    SYLAR_ASSERT(ring && ring->setOwner(getpid()));
+
+    pid_t child = fork();
+    if (child == 0) {
+        auto appender = std::make_shared<sylar::ShmLogAppender>(name);
+        _exit(appender->getRing() ? 1 : 0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    SYLAR_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // owner退出后可以接管
+    std::string name2 = shm_name("owner2");
+    auto ring2 = sylar::ShmLogRing::Open(name2, 64 * 1024);
+    SYLAR_ASSERT(ring2);
+    child = fork();
+    if (child == 0) {
+        _exit(ring2->setOwner(getpid()) ? 0 : 1);
+    }
+    waitpid(child, &status, 0);
+    SYLAR_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    SYLAR_ASSERT(ring2->getOwner() == child);
+    SYLAR_ASSERT(ring2->setOwner(getpid()) && ring2->getOwner() == getpid());
+    SYLAR_ASSERT(sylar::ShmLogRing::Unlink(name2));
+    SYLAR_ASSERT(sylar::ShmLogRing::Unlink(name));
+    SYLAR_LOG_INFO(g_logger) << "owner ok";
+}
+
+static void test_config() {
+    std::string name = shm_name("conf");
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: shm_conf\n"
+        "    level: info\n"
+        "    appenders:\n"
+        "      - type: ShmLogAppender\n"
+        "        shm: " + name + "\n"
+        "        shm_size: 128K\n"
+        "        formatter: \"%p %m%n\"\n");
+    sylar::Config::LoadFromYaml(root);
+    std::string yaml = sylar::LoggerMgr::GetInstance()->toYamlString();
+    SYLAR_ASSERT(yaml.find("shm: " + name) != std::string::npos);
+    SYLAR_ASSERT(yaml.find("shm_size: 131072") != std::string::npos);
+
+    auto logger = SYLAR_LOG_NAME("shm_conf");
+    SYLAR_LOG_INFO(logger) << "shm conf";
+    auto ring = sylar::ShmLogRing::Open(name);
+    SYLAR_ASSERT(ring && ring->getCapacity() == 128 * 1024);
+    std::string got;
+    ring->read([&got](const char* data, size_t len) {
+        got.append(data, len);
+    });
+    SYLAR_ASSERT(got == "INFO shm conf\n");
+    SYLAR_ASSERT(sylar::ShmLogRing::Unlink(name));
+    SYLAR_LOG_INFO(g_logger) << "config ok";
+}
+
+int main(int argc, char** argv) {
+    test_ring();
+    test_mpsc();
+    test_wrap_skip();
+    test_reserved_slot();
+    test_crash();
+    test_owner();
+    test_config();
+    return 0;
+}
@@ -0,0 +1,190 @@
+#include "sylar/sylar.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static auto g_logger = SYLAR_LOG_ROOT();
+
+static const char* s_path = "/tmp/sylar_test_log_socket.sock";
+
+// 本地接收端
+static int bind_unix(const char* path, int rcvbuf = 0) {
+    ::unlink(path);
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (rcvbuf) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    SYLAR_ASSERT(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    return fd;
+}
+
+static std::vector<std::string> recv_all(int fd) {
+    std::vector<std::string> v;
+    char buf[16 * 1024];
+    while (true) {
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n < 0) {
+            break;
+        }
+        v.emplace_back(buf, n);
+    }
+    return v;
+}
+
+// 按空格切出RFC5424头部的各字段
+static std::vector<std::string> split_header(const std::string& msg, int fields = 7) {
+    std::vector<std::string> v;
+    size_t pos = 0;
+    for (int i = 0; i < fields - 1; ++i) {
+        size_t next = msg.find(' ', pos);
+        v.push_back(msg.substr(pos, next - pos));
+        pos = next + 1;
+    }
+    v.push_back(msg.substr(pos));
+    return v;
+}
+
+static void test_framing() {
+    int fd = bind_unix(s_path);
+    auto logger = std::make_shared<sylar::Logger>("socket test");
+    auto appender = std::make_shared<sylar::SocketLogAppender>(
+            std::string("unix:") + s_path, "test_app", 16);
+    appender->setFormatter(std::make_shared<sylar::LogFormatter>("%m%n"));
+    appender->setBatchSize(8);
+    logger->addAppender(appender);
+
+    for (int i = 0; i < 5; ++i) {
+        SYLAR_LOG_INFO(logger) << "info " << i;
+    }
+    // 未满一批，尚未发送
+    SYLAR_ASSERT(recv_all(fd).empty());
+    SYLAR_LOG_ERROR(logger) << "error now";
+    auto msgs = recv_all(fd);
+    SYLAR_ASSERT(msgs.size() == 6);
+    for (auto& i : msgs) {
+        std::cout << i << std::endl;
+    }
+
+    // <PRI>VERSION TIMESTAMP HOSTNAME APP-NAME PROCID MSGID SD MSG
+    auto f = split_header(msgs[0], 8);
+    SYLAR_ASSERT(f[0] == "<134>1");     // local0(16) * 8 + info(6)
+    SYLAR_ASSERT(f[1].size() == 27 && f[1][10] == 'T' && f[1].back() == 'Z');
+    SYLAR_ASSERT(f[3] == "test_app");
+    SYLAR_ASSERT(f[4] == std::to_string(getpid()));
+    SYLAR_ASSERT(f[5] == "socket_test");
+    SYLAR_ASSERT(f[6] == "-");
+    SYLAR_ASSERT(f[7] == "info 0");
+    SYLAR_ASSERT(split_header(msgs[5], 8)[0] == "<131>1");
+    SYLAR_ASSERT(split_header(msgs[5], 8)[7] == "error now");
+
+    // 超长记录被截断
+    SYLAR_LOG_WARN(logger) << std::string(20000, 'x');
+    appender->flush();
+    msgs = recv_all(fd);
+    SYLAR_ASSERT(msgs.size() == 1 && msgs[0].size() == sylar::SocketLogAppender::kMaxMessageSize);
+    SYLAR_ASSERT(appender->getSent() == 7 && appender->getDropped() == 0);
+
+    logger->clearAppenders();
+    close(fd);
+    SYLAR_LOG_INFO(g_logger) << "framing ok";
+}
+
+// 接收方不读时丢弃并计数，不阻塞日志调用
+static void test_drop() {
+    int fd = bind_unix(s_path, 4096);
+    auto logger = std::make_shared<sylar::Logger>("socket_drop");
+    auto appender = std::make_shared<sylar::SocketLogAppender>(std::string("unix:") + s_path);
+    appender->setFormatter(std::make_shared<sylar::LogFormatter>("%m%n"));
+    logger->addAppender(appender);
+
+    const int n = 10000;
+    uint64_t start = sylar::GetCurrentNS();
+    for (int i = 0; i < n; ++i) {
+        SYLAR_LOG_INFO(logger) << "drop message " << i;
+    }
+    appender->flush();
+    uint64_t used = sylar::GetCurrentNS() - start;
+    SYLAR_LOG_INFO(g_logger) << "sent=" << appender->getSent() << " dropped=" << appender->getDropped()
+        << " " << used / n << "ns/record";
+    SYLAR_ASSERT(appender->getSent() + appender->getDropped() == (uint64_t)n);
+    SYLAR_ASSERT(appender->getDropped() > 0);
+    SYLAR_ASSERT(recv_all(fd).size() == appender->getSent());
+
+    // 恢复后先补发丢弃数
+    uint64_t dropped = appender->getDropped();
+    SYLAR_LOG_INFO(logger) << "recovered";
+    appender->flush();
+    auto msgs = recv_all(fd);
+    SYLAR_ASSERT(msgs.size() == 2);
+    SYLAR_ASSERT(msgs[0].find("dropped " + std::to_string(dropped) + " log records") != std::string::npos);
+    SYLAR_ASSERT(msgs[1].find("recovered") != std::string::npos);
+
+    // 接收方消失后丢弃，重新出现后恢复发送
+    close(fd);
+    ::unlink(s_path);
+    SYLAR_LOG_ERROR(logger) << "nobody listening";
+    SYLAR_ASSERT(appender->getDropped() == dropped + 1);
+    fd = bind_unix(s_path);
+    usleep(1100 * 1000);
+    SYLAR_LOG_ERROR(logger) << "listening again";
+    msgs = recv_all(fd);
+    SYLAR_ASSERT(msgs.size() == 2);
+    SYLAR_ASSERT(msgs[1].find("listening again") != std::string::npos);
+
+    logger->clearAppenders();
+    close(fd);
+    ::unlink(s_path);
+    SYLAR_LOG_INFO(g_logger) << "drop ok";
+}
+
+static void test_udp() {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    SYLAR_ASSERT(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr*)&addr, &len);
+    std::string address = "udp:127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "  - name: socket_conf\n"
+        "    level: debug\n"
+        "    appenders:\n"
+        "      - type: SocketLogAppender\n"
+        "        address: " + address + "\n"
+        "        app_name: conf_app\n"
+        "        batch_size: 2\n"
+        "        formatter: \"%p %m%n\"\n");
+    sylar::Config::LoadFromYaml(root);
+    std::string yaml = sylar::LoggerMgr::GetInstance()->toYamlString();
+    SYLAR_ASSERT(yaml.find("address: " + address) != std::string::npos);
+    SYLAR_ASSERT(yaml.find("batch_size: 2") != std::string::npos);
+
+    auto logger = SYLAR_LOG_NAME("socket_conf");
+    SYLAR_LOG_DEBUG(logger) << "udp 1";
+    SYLAR_LOG_DEBUG(logger) << "udp 2";
+    auto msgs = recv_all(fd);
+    SYLAR_ASSERT(msgs.size() == 2);
+    auto f = split_header(msgs[1], 8);
+    SYLAR_ASSERT(f[0] == "<15>1" && f[3] == "conf_app" && f[5] == "socket_conf");
+    SYLAR_ASSERT(f[7] == "DEBUG udp 2");
+    close(fd);
+    SYLAR_LOG_INFO(g_logger) << "udp ok";
+}
+
+int main(int argc, char** argv) {
+    test_framing();
+    test_drop();
+    test_udp();
+    return 0;
+}
@@ -0,0 +1,225 @@
+// 按时间范围从FileLogAppender写出的日志中取出记录
+// 用<file>.idx定位起止偏移后mmap文件，只解析两端索引块内的行，中间整块输出
+// 没有索引时退化为扫描整个文件
+// usage: sylar_logcat --from time --to time [-t time_format] [-o output] file
+//   time为毫秒时间戳或本地时间"%Y-%m-%d %H:%M:%S[.mmm]"
+//   time_format为行首时间的strptime格式，默认与Logger的默认格式一致；行首不是时间的行跟随上一行
+#include "sylar/log.h"
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <ctime>
+
+static const char* s_default_time_format = "%Y-%m-%d %H:%M:%S";
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s --from time --to time [-t time_format] [-o output] file\n", prog);
+}
+
+static bool parse_time(const char* str, uint64_t& ms) {
+    const char* p = str;
+    while (*p >= '0' && *p <= '9') {
+        ++p;
+    }
+    if (p != str && !*p) {
+        ms = strtoull(str, nullptr, 10);
+        return true;
+    }
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    p = strptime(str, "%Y-%m-%d %H:%M:%S", &tm);
+    if (!p) {
+        return false;
+    }
+    uint64_t milli = 0;
+    if (*p == '.') {
+        char* end = nullptr;
+        milli = strtoul(p + 1, &end, 10);
+        if (end - (p + 1) != 3) {
+            return false;
+        }
+        p = end;
+    }
+    if (*p) {
+        return false;
+    }
+    tm.tm_isdst = -1;
+    time_t t = mktime(&tm);
+    if (t == (time_t)-1) {
+        return false;
+    }
+    ms = (uint64_t)t * 1000 + milli;
+    return true;
+}
+
+struct Filter {
+    const char* time_format;
+    uint64_t from;
+    uint64_t to;
+    FILE* fp;
+    // 无法解析时间的行跟随上一行，开头的无法判断时保留
+    bool keep = true;
+
+    // 行首时间精度为秒，与范围有交集即保留
+    bool lineTime(const char* line, size_t len, bool& in_range) const {
+        char buf[128];
+        len = std::min(len, sizeof(buf) - 1);
+        memcpy(buf, line, len);
+        buf[len] = '\0';
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        if (!strptime(buf, time_format, &tm)) {
+            return false;
+        }
+        tm.tm_isdst = -1;
+        time_t t = mktime(&tm);
+        if (t == (time_t)-1) {
+            return false;
+        }
+        uint64_t ms = (uint64_t)t * 1000;
+        in_range = ms + 999 >= from && ms <= to;
+        return true;
+    }
+
+    void filter(const char* data, size_t len) {
+        const char* end = data + len;
+        while (data < end) {
+            const char* nl = (const char*)memchr(data, '\n', end - data);
+            const char* next = nl ? nl + 1 : end;
+            bool in_range = false;
+            if (lineTime(data, next - data, in_range)) {
+                keep = in_range;
+            }
+            if (keep) {
+                fwrite(data, 1, next - data, fp);
+            }
+            data = next;
+        }
+    }
+
+    void copy(const char* data, size_t len) {
+        fwrite(data, 1, len, fp);
+        keep = true;
+    }
+};
+
+int main(int argc, char** argv) {
+    static struct option long_options[] = {
+        {"from", required_argument, nullptr, 'f'},
+        {"to", required_argument, nullptr, 'T'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+    uint64_t from = 0;
+    uint64_t to = UINT64_MAX;
+    const char* time_format = s_default_time_format;
+    std::string output;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "f:T:t:o:h", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 'f':
+                if (!parse_time(optarg, from)) {
+                    fprintf(stderr, "invalid time: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'T':
+                if (!parse_time(optarg, to)) {
+                    fprintf(stderr, "invalid time: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 't':
+                time_format = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind + 1 != argc || from > to) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char* file = argv[optind];
+
+    int fd = ::open(file, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "open failed: %s\n", file);
+        return 1;
+    }
+    uint64_t size = st.st_size;
+    const char* data = nullptr;
+    if (size) {
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            fprintf(stderr, "mmap failed: %s\n", file);
+            return 1;
+        }
+        data = (const char*)addr;
+    }
+    ::close(fd);
+
+    std::vector<sylar::FileLogIndex::Entry> entries;
+    if (!sylar::FileLogIndex::Load(file, entries, size)) {
+        fprintf(stderr, "warning: no index for %s, scanning whole file\n", file);
+    }
+
+    // [begin, end)之外的记录都不在范围内，[inner_begin, inner_end)内的都在范围内
+    // 条目时间取自该偏移处的记录，多线程写入时相邻记录可能有几毫秒的乱序
+    uint64_t begin = 0;
+    uint64_t end = size;
+    uint64_t inner_begin = size;
+    uint64_t inner_end = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        auto& e = entries[i];
+        if (e.time_ms < from) {
+            begin = e.offset;
+        } else if (e.time_ms > to) {
+            end = e.offset;
+            break;
+        } else {
+            inner_begin = std::min(inner_begin, e.offset);
+            inner_end = e.offset;
+        }
+    }
+    if (inner_begin >= inner_end) {
+        inner_begin = inner_end = end;
+    }
+
+    FILE* fp = stdout;
+    if (!output.empty()) {
+        fp = fopen(output.c_str(), "w");
+        if (!fp) {
+            fprintf(stderr, "open output failed: %s\n", output.c_str());
+            return 1;
+        }
+    }
+    Filter filter;
+    filter.time_format = time_format;
+    filter.from = from;
+    filter.to = to;
+    filter.fp = fp;
+    if (begin < end) {
+        filter.filter(data + begin, inner_begin - begin);
+        filter.copy(data + inner_begin, inner_end - inner_begin);
+        filter.filter(data + inner_end, end - inner_end);
+    }
+    if (fp != stdout) {
+        fclose(fp);
+    }
+    if (data) {
+        munmap((void*)data, size);
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+// 把ShmLogAppender写入共享内存环的日志写到文件
+// 生产者崩溃后本进程仍持有映射，已提交的记录照常写出
+// usage: sylar_logd [-s size] [-i idle_ms] [-e] [-u] shm_name output
+//   -e 生产者进程退出且环已取空后退出
+//   -u 退出时删除共享内存
+// SIGHUP重新打开输出文件，SIGINT/SIGTERM取空后退出
+#include "sylar/log.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <cstdio>
+
+static volatile sig_atomic_t s_stop = 0;
+static volatile sig_atomic_t s_reopen = 0;
+
+static void on_signal(int sig) {
+    if (sig == SIGHUP) {
+        s_reopen = 1;
+    } else {
+        s_stop = 1;
+    }
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [-s size] [-i idle_ms] [-e] [-u] shm_name output\n", prog);
+}
+
+static int open_output(const char* path) {
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "open output failed: %s %s\n", path, strerror(errno));
+    }
+    return fd;
+}
+
+static bool write_all(int fd, const std::string& str) {
+    const char* p = str.data();
+    size_t left = str.size();
+    while (left) {
+        ssize_t n = ::write(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        left -= n;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    uint64_t size = sylar::ShmLogRing::kDefaultSize;
+    int idle_ms = 10;
+    bool exit_with_owner = false;
+    bool unlink_on_exit = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:i:euh")) != -1) {
+        switch (opt) {
+            case 's':
+                size = strtoull(optarg, nullptr, 10);
+                break;
+            case 'i':
+                idle_ms = atoi(optarg);
+                break;
+            case 'e':
+                exit_with_owner = true;
+                break;
+            case 'u':
+                unlink_on_exit = true;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind + 2 != argc || idle_ms <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char* name = argv[optind];
+    const char* output = argv[optind + 1];
+
+    auto ring = sylar::ShmLogRing::Open(name, size);
+    if (!ring) {
+        fprintf(stderr, "open shm failed: %s %s\n", name, strerror(errno));
+        return 1;
+    }
+    int fd = open_output(output);
+    if (fd < 0) {
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGHUP, &sa, nullptr);
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    std::string buf;
+    uint64_t reported = ring->getDropped();
+    auto append = [&buf](const char* data, size_t len) {
+        buf.append(data, len);
+    };
+    while (true) {
+        bool stop = s_stop;
+        size_t n = ring->read(append);
+        if (!n && !ring->empty() && ring->skipDead()) {
+            n = ring->read(append);
+        }
+
+        uint64_t dropped = ring->getDropped();
+        if (dropped != reported) {
+            buf.append("sylar_logd: dropped " + std::to_string(dropped - reported) + " log records\n");
+            reported = dropped;
+        }
+        if (s_reopen) {
+            s_reopen = 0;
+            int new_fd = open_output(output);
+            if (new_fd >= 0) {
+                ::close(fd);
+                fd = new_fd;
+            }
+        }
+        if (!buf.empty()) {
+            if (!write_all(fd, buf)) {
+                fprintf(stderr, "write output failed: %s %s\n", output, strerror(errno));
+            }
+            buf.clear();
+        }
+
+        if (stop) {
+            break;
+        }
+        if (!n) {
+            // 先看环是否为空再看生产者，避免漏掉退出前最后提交的记录
+            bool empty = ring->empty();
+            pid_t owner = ring->getOwner();
+            if (exit_with_owner && empty && owner
+                    && kill(owner, 0) != 0 && errno == ESRCH) {
+                break;
+            }
+            usleep(idle_ms * 1000);
+        }
+    }
+
+    ::close(fd);
+    if (unlink_on_exit) {
+        sylar::ShmLogRing::Unlink(name);
+    }
+    return 0;
+}
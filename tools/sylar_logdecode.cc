@@ -0,0 +1,77 @@
+// 把BinaryLog写出的二进制日志还原为文本
+// usage: sylar_logdecode [-p pattern] [-o output] file
+#include "sylar/log.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+
+// 与Logger的默认格式一致
+static const char* s_default_pattern = "%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n";
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [-p pattern] [-o output] file\n", prog);
+}
+
+int main(int argc, char** argv) {
+    std::string pattern = s_default_pattern;
+    std::string output;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:o:h")) != -1) {
+        switch (opt) {
+            case 'p':
+                pattern = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    sylar::LogFormatter formatter(pattern);
+    if (formatter.isError()) {
+        fprintf(stderr, "invalid pattern: %s\n", pattern.c_str());
+        return 1;
+    }
+
+    sylar::BinaryLogReader reader(argv[optind]);
+    if (!reader.isOpen()) {
+        fprintf(stderr, "not a binary log file: %s\n", argv[optind]);
+        return 1;
+    }
+
+    FILE* fp = stdout;
+    if (!output.empty()) {
+        fp = fopen(output.c_str(), "w");
+        if (!fp) {
+            fprintf(stderr, "open output failed: %s\n", output.c_str());
+            return 1;
+        }
+    }
+
+    std::string out;
+    size_t count = 0;
+    while (reader.next(formatter, out)) {
+        ++count;
+        if (out.size() >= 64 * 1024) {
+            fwrite(out.data(), 1, out.size(), fp);
+            out.clear();
+        }
+    }
+    fwrite(out.data(), 1, out.size(), fp);
+    if (fp != stdout) {
+        fclose(fp);
+    }
+
+    if (reader.isTruncated()) {
+        fprintf(stderr, "warning: file truncated, %zu records decoded\n", count);
+    }
+    return 0;
+}